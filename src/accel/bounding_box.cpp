@@ -24,7 +24,20 @@ bool BoundingBox::contains_bb(BoundingBox bb) const {
     return contains_point(bb.max) && contains_point(bb.min);
 }
 
-BoundingBox BoundingBox::transform(Transform transformation) const {
+double BoundingBox::surface_area() const {
+    if (min.x > max.x || min.y > max.y || min.z > max.z) {
+        return 0;
+    }
+    double dx = max.x - min.x;
+    double dy = max.y - min.y;
+    double dz = max.z - min.z;
+    if (std::isinf(dx) || std::isinf(dy) || std::isinf(dz)) {
+        return INFINITY; // avoid inf * 0 for flat unbounded shapes
+    }
+    return 2 * (dx * dy + dy * dz + dz * dx);
+}
+
+BoundingBox BoundingBox::transform(const Matrix4& transformation) const {
     BoundingBox bb;
     bb.add_point(transformation * min);
     bb.add_point(transformation * max);
@@ -37,46 +50,35 @@ BoundingBox BoundingBox::transform(Transform transformation) const {
     return bb;
 }
 
-// Identify where ray intersects planes offset by 1 from axis
-std::pair<double, double> check_axis(double origin, double direction, double min, double max) {
-    double tmin_numerator = min - origin;
-    double tmax_numerator = max - origin;
+bool BoundingBox::intersects(const Ray& local_r) const {
+    return slab(local_r).has_value();
+}
 
-    double tmin, tmax;
-    if (abs(direction) >= EPSILON) {
-        tmin = tmin_numerator / direction;
-        tmax = tmax_numerator / direction;
+std::optional<std::pair<real, real>> BoundingBox::slab(const Ray& r) const {
+    const real o[3] = { r.origin.x, r.origin.y, r.origin.z };
+    const real inv[3] = { r.inv_dir.x, r.inv_dir.y, r.inv_dir.z };
+    const real planes[2][3] = { { min.x, min.y, min.z }, { max.x, max.y, max.z } };
+    real tmin = r.tmin;
+    real tmax = r.tmax;
+    for (int axis = 0; axis < 3; axis++) {
+        real t_near = (planes[r.sign[axis]][axis] - o[axis]) * inv[axis];
+        real t_far = (planes[1 - r.sign[axis]][axis] - o[axis]) * inv[axis];
+        // NaN (origin on a slab plane of a parallel ray) leaves the bound as is
+        tmin = t_near > tmin ? t_near : tmin;
+        tmax = t_far < tmax ? t_far : tmax;
     }
-    else {
-        tmin = tmin_numerator * INFINITY;
-        tmax = tmax_numerator * INFINITY;
-    }
-
     if (tmin > tmax) {
-        double temp = tmin;
-        tmin = tmax;
-        tmax = temp;
+        return std::nullopt;
     }
     return std::make_pair(tmin, tmax);
 }
 
-bool BoundingBox::intersects(Ray local_r) const {
-    auto const [xtmin, xtmax] = check_axis(local_r.origin.x, local_r.dir.x, min.x, max.x);
-    auto const [ytmin, ytmax] = check_axis(local_r.origin.y, local_r.dir.y, min.y, max.y);
-    auto const [ztmin, ztmax] = check_axis(local_r.origin.z, local_r.dir.z, min.z, max.z);
-
-    double tmin = std::max({ xtmin, ytmin, ztmin });
-    double tmax = std::min({ xtmax, ytmax, ztmax });
-
-    return tmin <= tmax;
-}
-
 std::pair<BoundingBox, BoundingBox> BoundingBox::split_bounds() const {
     double dx = max.x - min.x;
     double dy = max.y - min.y;
     double dz = max.z - min.z;
 
-    double longest_axis = std::max(std::max(dx, dy), dz);
+    real longest_axis = std::max(std::max(dx, dy), dz);
 
     auto mid_min = min;
     auto mid_max = max;
@@ -1,5 +1,6 @@
 #pragma once
 #include <algorithm>
+#include <optional>
 #include "../geometry/ray.hpp"
 
 struct BoundingBox {
@@ -19,10 +20,23 @@ struct BoundingBox {
     bool contains_point(Point p) const;
     bool contains_bb(BoundingBox bb) const;
 
-    // TODO: why do I not automatically create a transformed bounding box?
-    BoundingBox transform(Transform transformation) const;
+    // Halved before adding so MIN_DOUBLE/MAX_DOUBLE bounds don't overflow
+    Point centroid() const {
+        return Point(min.x * .5 + max.x * .5, min.y * .5 + max.y * .5, min.z * .5 + max.z * .5);
+    }
+    // 0 for an empty box, infinite for unbounded shapes (planes, etc.)
+    double surface_area() const;
 
-    bool intersects(Ray local_r) const;
+    // TODO: why do I not automatically create a transformed bounding box?
+    BoundingBox transform(const Matrix4& transformation) const;
+
+    // Within the ray's [tmin, tmax]
+    bool intersects(const Ray& local_r) const;
+    // Entry and exit t of the ray, clipped to its [tmin, tmax]; nullopt on a
+    // miss. Picks the near and far planes by the ray's sign bits and
+    // multiplies by its inverse direction, so there are no branches or
+    // divisions
+    std::optional<std::pair<real, real>> slab(const Ray& r) const;
 
     std::pair<BoundingBox, BoundingBox> split_bounds() const;
 };
\ No newline at end of file
@@ -0,0 +1,683 @@
+#include "bvh.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+
+#include "../rendering/thread_pool.hpp"
+
+namespace {
+    // Below this a pool costs more than it saves
+    constexpr size_t PARALLEL_MIN_PRIMITIVES = 1 << 14;
+
+    struct Bin {
+        BoundingBox bounds;
+        size_t count = 0;
+    };
+
+    double axis_value(const Point& p, int axis) {
+        return axis == 0 ? p.x : axis == 1 ? p.y : p.z;
+    }
+
+    int bin_index(double value, double min, double extent, int bin_count) {
+        int b = static_cast<int>(bin_count * ((value - min) / extent));
+        return std::clamp(b, 0, bin_count - 1);
+    }
+
+    // Conservative double -> float conversion (out of range casts are UB)
+    float round_down(double d) {
+        if (d < -FLT_MAX) {
+            return -INFINITY;
+        }
+        if (d > FLT_MAX) {
+            return FLT_MAX;
+        }
+        float f = static_cast<float>(d);
+        return f > d ? std::nextafter(f, -INFINITY) : f;
+    }
+
+    float round_up(double d) {
+        if (d > FLT_MAX) {
+            return INFINITY;
+        }
+        if (d < -FLT_MAX) {
+            return -FLT_MAX;
+        }
+        float f = static_cast<float>(d);
+        return f < d ? std::nextafter(f, INFINITY) : f;
+    }
+
+    size_t subtree_depth(const std::vector<LinearBVHNode>& nodes, uint32_t i) {
+        if (nodes[i].is_leaf()) {
+            return 1;
+        }
+        return 1 + std::max(subtree_depth(nodes, i + 1), subtree_depth(nodes, nodes[i].offset));
+    }
+
+    // Bounds of a range of primitives and of their centroids
+    struct RangeBounds {
+        BoundingBox node;
+        BoundingBox centroids;
+    };
+
+    RangeBounds range_bounds(const std::vector<BVHPrimitive>& prims, size_t begin, size_t end) {
+        RangeBounds range;
+        for (size_t i = begin; i < end; i++) {
+            range.node.add_BB(prims[i].bounds);
+            range.centroids.add_point(prims[i].centroid);
+        }
+        return range;
+    }
+
+    // Maps centroids to bins along each axis the centroids spread over
+    struct BinGrid {
+        int bin_count;
+        double min[3];
+        double extent[3];
+        bool usable[3];
+
+        BinGrid(const BoundingBox& centroids, int bin_count) : bin_count(std::max(bin_count, 2)) {
+            for (int axis = 0; axis < 3; axis++) {
+                min[axis] = axis_value(centroids.min, axis);
+                extent[axis] = axis_value(centroids.max, axis) - min[axis];
+                // Not when all centroids coincide on the axis
+                usable[axis] = extent[axis] > 0 && std::isfinite(extent[axis]);
+            }
+        }
+
+        int bin(const Point& centroid, int axis) const {
+            return bin_index(axis_value(centroid, axis), min[axis], extent[axis], bin_count);
+        }
+    };
+
+    // Adds prims[begin, end) to bins, bin_count per axis
+    void bin_range(const std::vector<BVHPrimitive>& prims, size_t begin, size_t end,
+        const BinGrid& grid, std::vector<Bin>& bins) {
+        for (size_t i = begin; i < end; i++) {
+            for (int axis = 0; axis < 3; axis++) {
+                if (grid.usable[axis]) {
+                    Bin& bin = bins[axis * grid.bin_count + grid.bin(prims[i].centroid, axis)];
+                    bin.bounds.add_BB(prims[i].bounds);
+                    bin.count++;
+                }
+            }
+        }
+    }
+
+    struct Split {
+        int axis = -1; // -1 if there's no usable plane
+        int bin = 0;   // the left side ends with this bin
+        double cost = INFINITY;
+    };
+
+    Split best_split(const std::vector<Bin>& bins, const BinGrid& grid, double node_area,
+        const SAHOptions& options) {
+        int bin_count = grid.bin_count;
+        std::vector<double> right_area(bin_count);
+        std::vector<size_t> right_count(bin_count);
+        Split best;
+        for (int axis = 0; axis < 3; axis++) {
+            if (!grid.usable[axis]) {
+                continue;
+            }
+            const Bin* axis_bins = &bins[axis * bin_count];
+
+            // Sweep right-to-left for the right side of every split plane...
+            // (empty bins are skipped, add_BB would grow to their inverted extremes)
+            BoundingBox right;
+            size_t n_right = 0;
+            for (int b = bin_count - 1; b > 0; b--) {
+                if (axis_bins[b].count > 0) {
+                    right.add_BB(axis_bins[b].bounds);
+                }
+                n_right += axis_bins[b].count;
+                right_area[b] = right.surface_area();
+                right_count[b] = n_right;
+            }
+
+            // ...then left-to-right, costing the split after bin b
+            BoundingBox left;
+            size_t n_left = 0;
+            for (int b = 0; b < bin_count - 1; b++) {
+                if (axis_bins[b].count > 0) {
+                    left.add_BB(axis_bins[b].bounds);
+                }
+                n_left += axis_bins[b].count;
+                if (n_left == 0 || right_count[b + 1] == 0) {
+                    continue;
+                }
+                double weighted = left.surface_area() * n_left + right_area[b + 1] * right_count[b + 1];
+                double cost = options.traversal_cost +
+                    options.intersection_cost * weighted / node_area;
+                if (cost < best.cost) {
+                    best = { axis, b, cost };
+                }
+            }
+        }
+        return best;
+    }
+
+    // Partitions prims[begin, end) at split and returns the middle, or
+    // nullopt if a leaf is cheaper
+    std::optional<size_t> split_range(std::vector<BVHPrimitive>& prims, size_t begin, size_t end,
+        const Split& split, const BinGrid& grid, const SAHOptions& options) {
+        size_t count = end - begin;
+        double leaf_cost = options.intersection_cost * count;
+        bool must_split = count > options.max_leaf_size;
+
+        if (split.axis >= 0 && (split.cost < leaf_cost || must_split)) {
+            auto mid = std::partition(prims.begin() + begin, prims.begin() + end,
+                [&](const BVHPrimitive& p) { return grid.bin(p.centroid, split.axis) <= split.bin; });
+            return mid - prims.begin();
+        }
+
+        if (must_split) {
+            // No usable plane (coincident centroids or unbounded shapes): an even
+            // split still keeps every primitive out of oversized leaves
+            return begin + count / 2;
+        }
+        return std::nullopt;
+    }
+
+    // sah_partition with the bounds and bins gathered in chunks on the pool.
+    // Merging chunks only takes minimums, maximums and sums, so the split
+    // (and the serial partition after it) match sah_partition exactly
+    std::optional<size_t> parallel_sah_partition(std::vector<BVHPrimitive>& prims, size_t begin,
+        size_t end, const SAHOptions& options, ThreadPool* pool, size_t chunk_count,
+        BoundingBox& node_bounds) {
+        size_t count = end - begin;
+        chunk_count = std::clamp<size_t>(chunk_count, 1, count);
+        auto chunk_begin = [&](size_t chunk) { return begin + count * chunk / chunk_count; };
+
+        std::vector<RangeBounds> chunk_bounds(chunk_count);
+        for_each_chunk(pool, chunk_count, [&](size_t chunk) {
+            chunk_bounds[chunk] = range_bounds(prims, chunk_begin(chunk), chunk_begin(chunk + 1));
+            });
+        RangeBounds range = chunk_bounds[0];
+        for (size_t chunk = 1; chunk < chunk_count; chunk++) {
+            range.node.add_BB(chunk_bounds[chunk].node);
+            range.centroids.add_BB(chunk_bounds[chunk].centroids);
+        }
+        node_bounds = range.node;
+        if (count <= 1) {
+            return std::nullopt;
+        }
+
+        BinGrid grid(range.centroids, options.bin_count);
+        std::vector<std::vector<Bin>> chunk_bins(chunk_count, std::vector<Bin>(3 * grid.bin_count));
+        for_each_chunk(pool, chunk_count, [&](size_t chunk) {
+            bin_range(prims, chunk_begin(chunk), chunk_begin(chunk + 1), grid, chunk_bins[chunk]);
+            });
+        std::vector<Bin> bins = std::move(chunk_bins[0]);
+        for (size_t chunk = 1; chunk < chunk_count; chunk++) {
+            for (size_t b = 0; b < bins.size(); b++) {
+                if (chunk_bins[chunk][b].count > 0) {
+                    bins[b].bounds.add_BB(chunk_bins[chunk][b].bounds);
+                    bins[b].count += chunk_bins[chunk][b].count;
+                }
+            }
+        }
+        Split split = best_split(bins, grid, range.node.surface_area(), options);
+        return split_range(prims, begin, end, split, grid, options);
+    }
+
+    // A node above the subtrees of a parallel build, in depth-first order
+    struct TopNode {
+        size_t begin;
+        size_t end;
+        size_t depth;
+        BoundingBox bounds;
+        bool subtree;       // prims[begin, end) is built by its own task
+        size_t second = 0;  // interior nodes: the second child (the first is next)
+    };
+
+    double ms_since(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void set_bounds(LinearBVHNode& node, const BoundingBox& bounds) {
+        node.min[0] = round_down(bounds.min.x);
+        node.min[1] = round_down(bounds.min.y);
+        node.min[2] = round_down(bounds.min.z);
+        node.max[0] = round_up(bounds.max.x);
+        node.max[1] = round_up(bounds.max.y);
+        node.max[2] = round_up(bounds.max.z);
+    }
+
+    // Spreads the low bits of v three apart, for interleaving x, y and z
+    uint32_t expand_bits(uint32_t v) {
+        v &= 0x3ff;
+        v = (v | v << 16) & 0x030000ff;
+        v = (v | v << 8) & 0x0300f00f;
+        v = (v | v << 4) & 0x030c30c3;
+        v = (v | v << 2) & 0x09249249;
+        return v;
+    }
+
+    uint64_t expand_bits(uint64_t v) {
+        v &= 0x1fffff;
+        v = (v | v << 32) & 0x001f00000000ffff;
+        v = (v | v << 16) & 0x001f0000ff0000ff;
+        v = (v | v << 8) & 0x100f00f00f00f00f;
+        v = (v | v << 4) & 0x10c30c30c30c30c3;
+        v = (v | v << 2) & 0x1249249249249249;
+        return v;
+    }
+
+    template <typename Code>
+    struct MortonKey {
+        Code code;
+        uint32_t index;
+    };
+
+    // 10 bits per axis for 32-bit codes, 21 for 64-bit
+    template <typename Code>
+    struct MortonGrid {
+        static constexpr int BITS = sizeof(Code) == 4 ? 10 : 21;
+        double min[3];
+        double scale[3];
+
+        explicit MortonGrid(const BoundingBox& centroids) {
+            for (int axis = 0; axis < 3; axis++) {
+                min[axis] = axis_value(centroids.min, axis);
+                double extent = axis_value(centroids.max, axis) - min[axis];
+                // A flat axis puts every centroid in cell 0
+                scale[axis] = extent > 0 && std::isfinite(extent) ? (1 << BITS) / extent : 0;
+            }
+        }
+
+        Code code(const Point& centroid) const {
+            Code result = 0;
+            for (int axis = 0; axis < 3; axis++) {
+                double cell = (axis_value(centroid, axis) - min[axis]) * scale[axis];
+                // NaN (unbounded primitives) lands in cell 0 too
+                Code c = cell > 0 ? static_cast<Code>(std::min(cell, (1 << BITS) - 1.0)) : 0;
+                result |= expand_bits(c) << (2 - axis);
+            }
+            return result;
+        }
+    };
+
+    // Stable LSD radix sort by code, a byte per pass. Each chunk counts its
+    // digits, then scatters to where the counts of the chunks before it end.
+    // Passes where every key has the same digit are skipped
+    template <typename Code>
+    void radix_sort(std::vector<MortonKey<Code>>& keys, ThreadPool* pool, size_t chunk_count) {
+        size_t count = keys.size();
+        chunk_count = std::clamp<size_t>(chunk_count, 1, count);
+        auto chunk_begin = [&](size_t chunk) { return count * chunk / chunk_count; };
+        std::vector<MortonKey<Code>> sorted(count);
+        std::vector<std::array<size_t, 256>> offsets(chunk_count);
+
+        for (int shift = 0; shift < 8 * static_cast<int>(sizeof(Code)); shift += 8) {
+            for_each_chunk(pool, chunk_count, [&](size_t chunk) {
+                offsets[chunk].fill(0);
+                for (size_t i = chunk_begin(chunk); i < chunk_begin(chunk + 1); i++) {
+                    offsets[chunk][(keys[i].code >> shift) & 0xff]++;
+                }
+                });
+            size_t total = 0;
+            bool one_digit = false;
+            for (int digit = 0; digit < 256; digit++) {
+                size_t digit_count = 0;
+                for (size_t chunk = 0; chunk < chunk_count; chunk++) {
+                    size_t n = offsets[chunk][digit];
+                    offsets[chunk][digit] = total;
+                    total += n;
+                    digit_count += n;
+                }
+                one_digit = one_digit || digit_count == count;
+            }
+            if (one_digit) {
+                continue;
+            }
+            for_each_chunk(pool, chunk_count, [&](size_t chunk) {
+                for (size_t i = chunk_begin(chunk); i < chunk_begin(chunk + 1); i++) {
+                    sorted[offsets[chunk][(keys[i].code >> shift) & 0xff]++] = keys[i];
+                }
+                });
+            keys.swap(sorted);
+        }
+    }
+
+    // Emits keys[begin, end) depth-first into bvh and returns its bounds.
+    // Splits where the range's highest differing bit flips, or in half when
+    // every code is equal
+    template <typename Code>
+    BoundingBox emit_morton(LinearBVH& bvh, const std::vector<MortonKey<Code>>& keys,
+        const std::vector<BoundingBox>& bounds, size_t begin, size_t end, size_t depth,
+        size_t max_depth, size_t max_leaf_size) {
+        uint32_t index = bvh.nodes.size();
+        bvh.nodes.emplace_back();
+        BoundingBox node_bounds;
+
+        if (end - begin <= max_leaf_size || depth >= max_depth) {
+            bvh.nodes[index].offset = bvh.indices.size();
+            bvh.nodes[index].count = end - begin;
+            for (size_t i = begin; i < end; i++) {
+                bvh.indices.push_back(keys[i].index);
+                node_bounds.add_BB(bounds[keys[i].index]);
+            }
+            set_bounds(bvh.nodes[index], node_bounds);
+            return node_bounds;
+        }
+
+        size_t mid = begin + (end - begin) / 2;
+        Code first = keys[begin].code;
+        Code last = keys[end - 1].code;
+        if (first != last) {
+            // The range shares every bit above this one, so its codes with
+            // the bit set are a suffix
+            Code bit = Code(1) << (std::bit_width(first ^ last) - 1);
+            size_t lo = begin;
+            size_t hi = end - 1;
+            while (lo < hi) {
+                size_t m = lo + (hi - lo) / 2;
+                if (keys[m].code & bit) {
+                    hi = m;
+                }
+                else {
+                    lo = m + 1;
+                }
+            }
+            mid = lo;
+        }
+        node_bounds = emit_morton(bvh, keys, bounds, begin, mid, depth + 1, max_depth, max_leaf_size);
+        uint32_t second = bvh.nodes.size();
+        node_bounds.add_BB(emit_morton(bvh, keys, bounds, mid, end, depth + 1, max_depth, max_leaf_size));
+        bvh.nodes[index].offset = second;
+        bvh.nodes[index].count = 0;
+        set_bounds(bvh.nodes[index], node_bounds);
+        return node_bounds;
+    }
+
+    template <typename Code>
+    void build_morton_keys(LinearBVH& bvh, const std::vector<BoundingBox>& bounds, ThreadPool* pool,
+        size_t chunk_count, size_t max_depth, size_t max_leaf_size) {
+        size_t count = bounds.size();
+        chunk_count = std::clamp<size_t>(chunk_count, 1, count);
+        auto chunk_begin = [&](size_t chunk) { return count * chunk / chunk_count; };
+
+        std::vector<BoundingBox> chunk_centroids(chunk_count);
+        for_each_chunk(pool, chunk_count, [&](size_t chunk) {
+            for (size_t i = chunk_begin(chunk); i < chunk_begin(chunk + 1); i++) {
+                chunk_centroids[chunk].add_point(bounds[i].centroid());
+            }
+            });
+        BoundingBox centroids = chunk_centroids[0];
+        for (size_t chunk = 1; chunk < chunk_count; chunk++) {
+            centroids.add_BB(chunk_centroids[chunk]);
+        }
+
+        MortonGrid<Code> grid(centroids);
+        std::vector<MortonKey<Code>> keys(count);
+        for_each_chunk(pool, chunk_count, [&](size_t chunk) {
+            for (size_t i = chunk_begin(chunk); i < chunk_begin(chunk + 1); i++) {
+                keys[i] = { grid.code(bounds[i].centroid()), static_cast<uint32_t>(i) };
+            }
+            });
+        radix_sort(keys, pool, chunk_count);
+
+        bvh.nodes.reserve(2 * count);
+        bvh.indices.reserve(count);
+        emit_morton(bvh, keys, bounds, 0, count, 1, max_depth, max_leaf_size);
+    }
+}
+
+std::optional<size_t> sah_partition(std::vector<BVHPrimitive>& prims,
+    size_t begin, size_t end, const SAHOptions& options) {
+    if (end - begin <= 1) {
+        return std::nullopt;
+    }
+    RangeBounds range = range_bounds(prims, begin, end);
+    BinGrid grid(range.centroids, options.bin_count);
+    std::vector<Bin> bins(3 * grid.bin_count);
+    bin_range(prims, begin, end, grid, bins);
+    Split split = best_split(bins, grid, range.node.surface_area(), options);
+    return split_range(prims, begin, end, split, grid, options);
+}
+
+LinearBVH LinearBVH::build(const std::vector<BoundingBox>& bounds, const SAHOptions& options) {
+    if (options.method == BVHMethod::Morton) {
+        return build_morton(bounds, 1, options);
+    }
+    LinearBVH bvh;
+    if (bounds.empty()) {
+        return bvh;
+    }
+    std::vector<BVHPrimitive> prims;
+    prims.reserve(bounds.size());
+    for (size_t i = 0; i < bounds.size(); i++) {
+        prims.emplace_back(bounds[i], i);
+    }
+    bvh.nodes.reserve(2 * bounds.size());
+    bvh.indices.reserve(bounds.size());
+    bvh.build_recursive(prims, 0, prims.size(), options, 1);
+    return bvh;
+}
+
+uint32_t LinearBVH::build_recursive(std::vector<BVHPrimitive>& prims, size_t begin,
+    size_t end, const SAHOptions& options, size_t depth) {
+    uint32_t index = nodes.size();
+    nodes.emplace_back();
+
+    BoundingBox bounds;
+    for (size_t i = begin; i < end; i++) {
+        bounds.add_BB(prims[i].bounds);
+    }
+    LinearBVHNode& node = nodes[index];
+    set_bounds(node, bounds);
+
+    std::optional<size_t> mid;
+    if (depth < STACK_SIZE) {
+        mid = sah_partition(prims, begin, end, options);
+    }
+    if (!mid) {
+        // Leaf; at the depth limit all remaining primitives share one
+        node.offset = indices.size();
+        node.count = end - begin;
+        for (size_t i = begin; i < end; i++) {
+            indices.push_back(prims[i].index);
+        }
+        return index;
+    }
+
+    build_recursive(prims, begin, *mid, options, depth + 1);
+    uint32_t second = build_recursive(prims, *mid, end, options, depth + 1);
+    nodes[index].offset = second; // node may have moved
+    nodes[index].count = 0;
+    return index;
+}
+
+LinearBVH LinearBVH::build_parallel(const std::vector<BoundingBox>& bounds, size_t num_threads,
+    const SAHOptions& options, BVHBuildTimings* timings) {
+    // Smallest subtree worth a task of its own
+    constexpr size_t MIN_SUBTREE = 1 << 12;
+
+    BVHBuildTimings local_timings;
+    BVHBuildTimings& phases = timings ? *timings : local_timings;
+    phases = BVHBuildTimings();
+    if (options.method == BVHMethod::Morton) {
+        return build_morton(bounds, num_threads, options);
+    }
+    LinearBVH bvh;
+    if (bounds.empty()) {
+        return bvh;
+    }
+    if (num_threads == 0) {
+        num_threads = ThreadPool::default_thread_count();
+    }
+    if (bounds.size() < PARALLEL_MIN_PRIMITIVES) {
+        num_threads = 1;
+    }
+    std::optional<ThreadPool> pool;
+    if (num_threads > 1) {
+        pool.emplace(num_threads);
+    }
+    ThreadPool* workers = pool ? &*pool : nullptr;
+    // A few chunks and subtrees per thread for balance
+    size_t chunk_count = 4 * num_threads;
+    size_t grain = std::max(MIN_SUBTREE, bounds.size() / (8 * num_threads));
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<BVHPrimitive> prims(bounds.size());
+    for_each_chunk(workers, chunk_count, [&](size_t chunk) {
+        size_t end = bounds.size() * (chunk + 1) / chunk_count;
+        for (size_t i = bounds.size() * chunk / chunk_count; i < end; i++) {
+            prims[i] = BVHPrimitive(bounds[i], i);
+        }
+        });
+    phases.references_ms = ms_since(start);
+
+    // Split until the ranges are small enough to hand out
+    start = std::chrono::steady_clock::now();
+    std::vector<TopNode> top;
+    auto split_top = [&](auto& self, size_t begin, size_t end, size_t depth) -> size_t {
+        size_t index = top.size();
+        top.push_back({ begin, end, depth, BoundingBox(), true });
+        if (end - begin <= grain || depth >= STACK_SIZE) {
+            return index;
+        }
+        BoundingBox node_bounds;
+        auto mid = parallel_sah_partition(prims, begin, end, options, workers, chunk_count, node_bounds);
+        if (!mid) {
+            return index; // the subtree task comes to the same conclusion
+        }
+        top[index].bounds = node_bounds;
+        top[index].subtree = false;
+        self(self, begin, *mid, depth + 1);
+        size_t second = self(self, *mid, end, depth + 1);
+        top[index].second = second;
+        return index;
+        };
+    split_top(split_top, 0, prims.size(), 1);
+    phases.top_ms = ms_since(start);
+
+    start = std::chrono::steady_clock::now();
+    std::vector<size_t> roots;
+    for (size_t i = 0; i < top.size(); i++) {
+        if (top[i].subtree) {
+            roots.push_back(i);
+        }
+    }
+    std::vector<LinearBVH> subtrees(roots.size());
+    for_each_chunk(workers, roots.size(), [&](size_t i) {
+        const TopNode& root = top[roots[i]];
+        subtrees[i].nodes.reserve(2 * (root.end - root.begin));
+        subtrees[i].build_recursive(prims, root.begin, root.end, options, root.depth);
+        });
+    phases.subtrees = subtrees.size();
+    phases.subtrees_ms = ms_since(start);
+
+    // Walking the top nodes in order lays everything out as build() would;
+    // the walk only places each subtree, the copies run in parallel
+    start = std::chrono::steady_clock::now();
+    size_t node_count = top.size() - roots.size();
+    for (const auto& subtree : subtrees) {
+        node_count += subtree.nodes.size();
+    }
+    bvh.nodes.resize(node_count);
+    bvh.indices.resize(bounds.size());
+    std::vector<uint32_t> node_bases;
+    std::vector<uint32_t> index_bases;
+    uint32_t next_node = 0;
+    uint32_t next_index = 0;
+    auto place = [&](auto& self, size_t i) -> uint32_t {
+        uint32_t index = next_node;
+        if (top[i].subtree) {
+            const LinearBVH& subtree = subtrees[node_bases.size()];
+            node_bases.push_back(index);
+            index_bases.push_back(next_index);
+            next_node += subtree.nodes.size();
+            next_index += subtree.indices.size();
+            return index;
+        }
+        next_node++;
+        LinearBVHNode& node = bvh.nodes[index];
+        set_bounds(node, top[i].bounds);
+        self(self, i + 1);
+        node.offset = self(self, top[i].second);
+        node.count = 0;
+        return index;
+        };
+    place(place, 0);
+    for_each_chunk(workers, subtrees.size(), [&](size_t i) {
+        const LinearBVH& subtree = subtrees[i];
+        LinearBVHNode* out = &bvh.nodes[node_bases[i]];
+        for (LinearBVHNode node : subtree.nodes) {
+            node.offset += node.is_leaf() ? index_bases[i] : node_bases[i];
+            *out++ = node;
+        }
+        std::copy(subtree.indices.begin(), subtree.indices.end(), bvh.indices.begin() + index_bases[i]);
+        });
+    phases.flatten_ms = ms_since(start);
+    return bvh;
+}
+
+LinearBVH LinearBVH::build_morton(const std::vector<BoundingBox>& bounds, size_t num_threads,
+    const SAHOptions& options) {
+    // 30-bit codes put ~1K cells along each axis, too coarse past this
+    constexpr size_t MAX_30_BIT_PRIMITIVES = 1 << 20;
+
+    LinearBVH bvh;
+    if (bounds.empty()) {
+        return bvh;
+    }
+    if (num_threads == 0) {
+        num_threads = ThreadPool::default_thread_count();
+    }
+    if (bounds.size() < PARALLEL_MIN_PRIMITIVES) {
+        num_threads = 1;
+    }
+    std::optional<ThreadPool> pool;
+    if (num_threads > 1) {
+        pool.emplace(num_threads);
+    }
+    ThreadPool* workers = pool ? &*pool : nullptr;
+    size_t max_leaf_size = std::max<size_t>(options.max_leaf_size, 1);
+    if (bounds.size() <= MAX_30_BIT_PRIMITIVES) {
+        build_morton_keys<uint32_t>(bvh, bounds, workers, 4 * num_threads, STACK_SIZE, max_leaf_size);
+    }
+    else {
+        build_morton_keys<uint64_t>(bvh, bounds, workers, 4 * num_threads, STACK_SIZE, max_leaf_size);
+    }
+    return bvh;
+}
+
+size_t LinearBVH::depth() const {
+    return nodes.empty() ? 0 : subtree_depth(nodes, 0);
+}
+
+void LinearBVH::align_leaves(uint32_t width) {
+    std::vector<uint32_t> aligned;
+    aligned.reserve(indices.size() + nodes.size() * (width - 1));
+    for (auto& node : nodes) {
+        if (!node.is_leaf()) {
+            continue;
+        }
+        uint32_t offset = static_cast<uint32_t>(aligned.size());
+        aligned.insert(aligned.end(), indices.begin() + node.offset,
+            indices.begin() + node.offset + node.count);
+        aligned.resize((aligned.size() + width - 1) / width * width, indices[node.offset]);
+        node.offset = offset;
+    }
+    indices = std::move(aligned);
+}
+
+std::ostream& operator<<(std::ostream& os, const BVHReport& report) {
+    return os << "BVH: depth " << report.depth
+        << ", " << report.interior_nodes << " interior nodes"
+        << ", " << report.leaves << " leaves"
+        << ", " << report.primitives << " primitives"
+        << ", SAH cost " << report.sah_cost;
+}
+
+std::ostream& operator<<(std::ostream& os, const BVHBuildTimings& timings) {
+    return os << "BVH build: " << timings.references_ms << " ms references"
+        << ", " << timings.top_ms << " ms top splits"
+        << ", " << timings.subtrees_ms << " ms " << timings.subtrees << " subtrees"
+        << ", " << timings.flatten_ms << " ms flatten";
+}
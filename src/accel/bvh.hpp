@@ -0,0 +1,202 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <vector>
+
+#include "bounding_box.hpp"
+#include "../geometry/ray.hpp"
+
+enum class BVHMethod {
+    SAH,    // binned surface area heuristic: slower builds, faster traversal
+    Morton, // linear BVH over sorted Morton codes, for per-frame rebuilds
+};
+
+// Tuning for the binned surface-area-heuristic (SAH) builder. Morton builds
+// only use max_leaf_size and num_threads
+struct SAHOptions {
+    BVHMethod method = BVHMethod::SAH;
+    int bin_count = 12;
+    size_t max_leaf_size = 4;
+    // Relative costs of visiting a node and of testing one primitive
+    double traversal_cost = 1.0;
+    double intersection_cost = 1.0;
+    // Threads for the shapes' large builds (0 = all cores). Use 1 when
+    // building from inside another pool's tasks, which would otherwise each
+    // start a pool of their own
+    size_t num_threads = 0;
+};
+
+// A primitive as seen by the builders. `index` maps back into the owner's array
+struct BVHPrimitive {
+    BoundingBox bounds;
+    Point centroid;
+    size_t index;
+
+    BVHPrimitive() : index(0) {}
+    BVHPrimitive(BoundingBox bounds, size_t index)
+        : bounds(bounds), centroid(bounds.centroid()), index(index) {
+    }
+};
+
+// Binned SAH split of prims[begin, end). Reorders the range so that
+// [begin, mid) is the left child and returns mid, or nullopt if a leaf is
+// cheaper. Ranges larger than max_leaf_size are always split
+std::optional<size_t> sah_partition(std::vector<BVHPrimitive>& prims,
+    size_t begin, size_t end, const SAHOptions& options);
+
+struct BVHReport {
+    size_t depth = 0;
+    size_t interior_nodes = 0;
+    size_t leaves = 0;
+    size_t primitives = 0;
+    // Expected cost of tracing a ray that hits the root's bounds
+    double sah_cost = 0;
+};
+
+std::ostream& operator<<(std::ostream& os, const BVHReport& report);
+
+// Wall time of each phase of LinearBVH::build_parallel
+struct BVHBuildTimings {
+    double references_ms = 0; // bounds and centroid of every primitive
+    double top_ms = 0;        // splits above the subtrees, binned in parallel
+    double subtrees_ms = 0;   // one task per subtree
+    double flatten_ms = 0;    // subtrees copied into one depth-first array
+    size_t subtrees = 0;
+
+    double total_ms() const { return references_ms + top_ms + subtrees_ms + flatten_ms; }
+};
+
+std::ostream& operator<<(std::ostream& os, const BVHBuildTimings& timings);
+
+// Two nodes per cache line. Bounds are rounded outwards to float
+struct LinearBVHNode {
+    float min[3];
+    float max[3];
+    // Leaf: first entry in LinearBVH::indices. Interior: second child (the
+    // first child always directly follows its parent)
+    uint32_t offset;
+    uint32_t count; // 0 for interior nodes
+
+    bool is_leaf() const { return count > 0; }
+};
+static_assert(sizeof(LinearBVHNode) == 32);
+
+// Flattened, depth-first BVH over an array of primitive bounds. It only
+// stores indices, so the owner keeps its primitives in whatever form it likes
+struct LinearBVH {
+    std::vector<LinearBVHNode> nodes;
+    std::vector<uint32_t> indices; // primitive order; leaves reference ranges of this
+
+    static LinearBVH build(const std::vector<BoundingBox>& bounds,
+        const SAHOptions& options = SAHOptions());
+    // The same tree as build() on num_threads threads (0 = all cores): the
+    // top levels are split with their binning spread over the threads, then
+    // the subtrees below are built as independent tasks and stitched
+    // together. Small inputs don't start any threads
+    static LinearBVH build_parallel(const std::vector<BoundingBox>& bounds, size_t num_threads = 0,
+        const SAHOptions& options = SAHOptions(), BVHBuildTimings* timings = nullptr);
+    // LBVH: centroids are quantized within their bounds into Morton codes
+    // (30-bit, or 63-bit for large inputs), radix sorted on num_threads
+    // threads, and each node splits its range where the highest differing
+    // bit flips. build() and build_parallel() come here for BVHMethod::Morton
+    static LinearBVH build_morton(const std::vector<BoundingBox>& bounds, size_t num_threads = 0,
+        const SAHOptions& options = SAHOptions());
+
+    bool empty() const { return nodes.empty(); }
+    size_t depth() const;
+
+    // Moves every leaf's range of indices to start at a multiple of width,
+    // padding the gaps with the leaf's first primitive, so an owner can keep
+    // per-leaf SIMD packets at indices offset / width onwards
+    void align_leaves(uint32_t width);
+
+    // Front-to-back traversal of the leaves the ray enters within its
+    // [tmin, tmax]. visit(const uint32_t* prims, uint32_t count, real tmax)
+    // returns the new tmax (e.g. the closest hit so far), and subtrees
+    // entered beyond it are skipped
+    template<typename Visit>
+    void traverse(const Ray& r, Visit&& visit) const;
+
+private:
+    static constexpr size_t STACK_SIZE = 64;
+
+    uint32_t build_recursive(std::vector<BVHPrimitive>& prims, size_t begin,
+        size_t end, const SAHOptions& options, size_t depth);
+
+    // Slab test in float-widened bounds; inv_dir may hold infinities and
+    // sign picks each axis' near plane
+    static bool slab(const LinearBVHNode& node, const real origin[3], const real inv_dir[3],
+        const uint8_t sign[3], real tmin, real tmax, real& t_enter);
+};
+
+inline bool LinearBVH::slab(const LinearBVHNode& node, const real origin[3], const real inv_dir[3],
+    const uint8_t sign[3], real tmin, real tmax, real& t_enter) {
+    const float* planes[2] = { node.min, node.max };
+    for (int axis = 0; axis < 3; axis++) {
+        real t_near = (planes[sign[axis]][axis] - origin[axis]) * inv_dir[axis];
+        real t_far = (planes[1 - sign[axis]][axis] - origin[axis]) * inv_dir[axis];
+        // NaN (origin on a slab plane of a parallel ray) leaves the bound as is
+        tmin = t_near > tmin ? t_near : tmin;
+        tmax = t_far < tmax ? t_far : tmax;
+        if (tmin > tmax) {
+            return false;
+        }
+    }
+    t_enter = tmin;
+    return true;
+}
+
+template<typename Visit>
+void LinearBVH::traverse(const Ray& r, Visit&& visit) const {
+    if (nodes.empty()) {
+        return;
+    }
+    const real origin[3] = { r.origin.x, r.origin.y, r.origin.z };
+    const real inv_dir[3] = { r.inv_dir.x, r.inv_dir.y, r.inv_dir.z };
+    const real tmin = r.tmin;
+    real tmax = r.tmax;
+
+    struct Entry {
+        uint32_t node;
+        real t_enter;
+    };
+    Entry stack[STACK_SIZE];
+    size_t top = 0;
+
+    real t_enter = 0;
+    if (!slab(nodes[0], origin, inv_dir, r.sign, tmin, tmax, t_enter)) {
+        return;
+    }
+    stack[top++] = { 0, t_enter };
+
+    while (top > 0) {
+        Entry entry = stack[--top];
+        if (entry.t_enter > tmax) {
+            continue; // a closer hit was found since this was pushed
+        }
+        const LinearBVHNode& node = nodes[entry.node];
+        if (node.is_leaf()) {
+            tmax = visit(&indices[node.offset], node.count, tmax);
+            continue;
+        }
+
+        uint32_t near = entry.node + 1;
+        uint32_t far = node.offset;
+        real t_near = 0, t_far = 0;
+        bool hit_near = slab(nodes[near], origin, inv_dir, r.sign, tmin, tmax, t_near);
+        bool hit_far = slab(nodes[far], origin, inv_dir, r.sign, tmin, tmax, t_far);
+        if (hit_near && hit_far && t_far < t_near) {
+            std::swap(near, far);
+            std::swap(t_near, t_far);
+        }
+        // Far child first so the near one is popped next
+        if (hit_far) {
+            stack[top++] = { far, t_far };
+        }
+        if (hit_near) {
+            stack[top++] = { near, t_near };
+        }
+    }
+}
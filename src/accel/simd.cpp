@@ -0,0 +1,36 @@
+#include "simd.hpp"
+
+bool simd_level_supported(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::Scalar:
+        return true;
+#if defined(__x86_64__) || defined(_M_X64)
+    case SimdLevel::SSE2: // part of x86-64
+        return true;
+    case SimdLevel::AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+SimdLevel detect_simd_level() {
+    for (SimdLevel level : { SimdLevel::AVX2, SimdLevel::SSE2 }) {
+        if (simd_level_supported(level)) {
+            return level;
+        }
+    }
+    return SimdLevel::Scalar;
+}
+
+const char* simd_level_name(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::SSE2:
+        return "SSE2";
+    case SimdLevel::AVX2:
+        return "AVX2";
+    default:
+        return "scalar";
+    }
+}
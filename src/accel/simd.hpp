@@ -0,0 +1,10 @@
+#pragma once
+
+// Instruction sets the SIMD kernels are written for. Kernels are compiled
+// for every level and picked at runtime, so one binary runs everywhere
+enum class SimdLevel { Scalar, SSE2, AVX2 };
+
+// Best level this CPU supports; always Scalar off x86-64
+SimdLevel detect_simd_level();
+bool simd_level_supported(SimdLevel level);
+const char* simd_level_name(SimdLevel level);
@@ -0,0 +1,299 @@
+#include "triangle_packet.hpp"
+
+#include <cmath>
+
+#include "../math/util.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define RT_X86_64 1
+#include <immintrin.h>
+#endif
+
+void TrianglePacket::set(int lane, const Point& a, const Point& b, const Point& c) {
+    const Vector edge1 = b - a;
+    const Vector edge2 = c - a;
+    p1[0][lane] = a.x;
+    p1[1][lane] = a.y;
+    p1[2][lane] = a.z;
+    e1[0][lane] = edge1.x;
+    e1[1][lane] = edge1.y;
+    e1[2][lane] = edge1.z;
+    e2[0][lane] = edge2.x;
+    e2[1][lane] = edge2.y;
+    e2[2][lane] = edge2.z;
+}
+
+namespace {
+    unsigned intersect_scalar(const TrianglePacket& p, const Ray& r,
+        real t[TrianglePacket::WIDTH], real u[TrianglePacket::WIDTH], real v[TrianglePacket::WIDTH]) {
+        unsigned mask = 0;
+        for (int i = 0; i < TrianglePacket::WIDTH; i++) {
+            // Same steps as intersect_triangle
+            real hx = r.dir.y * p.e2[2][i] - r.dir.z * p.e2[1][i];
+            real hy = r.dir.z * p.e2[0][i] - r.dir.x * p.e2[2][i];
+            real hz = r.dir.x * p.e2[1][i] - r.dir.y * p.e2[0][i];
+            real det = p.e1[0][i] * hx + p.e1[1][i] * hy + p.e1[2][i] * hz;
+            if (std::abs(det) < EPSILON) {
+                continue;
+            }
+            real f = 1 / det;
+            real sx = r.origin.x - p.p1[0][i];
+            real sy = r.origin.y - p.p1[1][i];
+            real sz = r.origin.z - p.p1[2][i];
+            real ui = f * (sx * hx + sy * hy + sz * hz);
+            if (ui < 0 || ui > 1) {
+                continue;
+            }
+            real qx = sy * p.e1[2][i] - sz * p.e1[1][i];
+            real qy = sz * p.e1[0][i] - sx * p.e1[2][i];
+            real qz = sx * p.e1[1][i] - sy * p.e1[0][i];
+            real vi = f * (r.dir.x * qx + r.dir.y * qy + r.dir.z * qz);
+            if (vi < 0 || ui + vi > 1) {
+                continue;
+            }
+            t[i] = f * (p.e2[0][i] * qx + p.e2[1][i] * qy + p.e2[2][i] * qz);
+            u[i] = ui;
+            v[i] = vi;
+            mask |= 1u << i;
+        }
+        return mask;
+    }
+
+#ifdef RT_X86_64
+    // Lanes fill a 256-bit register: four doubles, or eight floats in a
+    // RAYTRACER_FLOAT build
+#ifndef RAYTRACER_FLOAT
+    // Two lanes at a time
+    unsigned intersect_sse2(const TrianglePacket& p, const Ray& r,
+        double t[4], double u[4], double v[4]) {
+        const __m128d dx = _mm_set1_pd(r.dir.x);
+        const __m128d dy = _mm_set1_pd(r.dir.y);
+        const __m128d dz = _mm_set1_pd(r.dir.z);
+        const __m128d zero = _mm_setzero_pd();
+        const __m128d one = _mm_set1_pd(1);
+        const __m128d sign = _mm_set1_pd(-0.0);
+        const __m128d epsilon = _mm_set1_pd(EPSILON);
+
+        unsigned mask = 0;
+        for (int i = 0; i < TrianglePacket::WIDTH; i += 2) {
+            __m128d e1x = _mm_load_pd(&p.e1[0][i]);
+            __m128d e1y = _mm_load_pd(&p.e1[1][i]);
+            __m128d e1z = _mm_load_pd(&p.e1[2][i]);
+            __m128d e2x = _mm_load_pd(&p.e2[0][i]);
+            __m128d e2y = _mm_load_pd(&p.e2[1][i]);
+            __m128d e2z = _mm_load_pd(&p.e2[2][i]);
+
+            __m128d hx = _mm_sub_pd(_mm_mul_pd(dy, e2z), _mm_mul_pd(dz, e2y));
+            __m128d hy = _mm_sub_pd(_mm_mul_pd(dz, e2x), _mm_mul_pd(dx, e2z));
+            __m128d hz = _mm_sub_pd(_mm_mul_pd(dx, e2y), _mm_mul_pd(dy, e2x));
+            __m128d det = _mm_add_pd(_mm_add_pd(_mm_mul_pd(e1x, hx), _mm_mul_pd(e1y, hy)),
+                _mm_mul_pd(e1z, hz));
+            __m128d f = _mm_div_pd(one, det);
+
+            __m128d sx = _mm_sub_pd(_mm_set1_pd(r.origin.x), _mm_load_pd(&p.p1[0][i]));
+            __m128d sy = _mm_sub_pd(_mm_set1_pd(r.origin.y), _mm_load_pd(&p.p1[1][i]));
+            __m128d sz = _mm_sub_pd(_mm_set1_pd(r.origin.z), _mm_load_pd(&p.p1[2][i]));
+            __m128d ui = _mm_mul_pd(f, _mm_add_pd(_mm_add_pd(_mm_mul_pd(sx, hx), _mm_mul_pd(sy, hy)),
+                _mm_mul_pd(sz, hz)));
+
+            __m128d qx = _mm_sub_pd(_mm_mul_pd(sy, e1z), _mm_mul_pd(sz, e1y));
+            __m128d qy = _mm_sub_pd(_mm_mul_pd(sz, e1x), _mm_mul_pd(sx, e1z));
+            __m128d qz = _mm_sub_pd(_mm_mul_pd(sx, e1y), _mm_mul_pd(sy, e1x));
+            __m128d vi = _mm_mul_pd(f, _mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, qx), _mm_mul_pd(dy, qy)),
+                _mm_mul_pd(dz, qz)));
+            __m128d ti = _mm_mul_pd(f, _mm_add_pd(_mm_add_pd(_mm_mul_pd(e2x, qx), _mm_mul_pd(e2y, qy)),
+                _mm_mul_pd(e2z, qz)));
+
+            // Ordered compares are false for NaN, like the scalar branches
+            __m128d miss = _mm_cmplt_pd(_mm_andnot_pd(sign, det), epsilon);
+            miss = _mm_or_pd(miss, _mm_cmplt_pd(ui, zero));
+            miss = _mm_or_pd(miss, _mm_cmpgt_pd(ui, one));
+            miss = _mm_or_pd(miss, _mm_cmplt_pd(vi, zero));
+            miss = _mm_or_pd(miss, _mm_cmpgt_pd(_mm_add_pd(ui, vi), one));
+
+            _mm_storeu_pd(t + i, ti);
+            _mm_storeu_pd(u + i, ui);
+            _mm_storeu_pd(v + i, vi);
+            mask |= (~_mm_movemask_pd(miss) & 0x3u) << i;
+        }
+        return mask;
+    }
+
+    // No FMA: contracting would round differently from the scalar path
+    __attribute__((target("avx2")))
+    unsigned intersect_avx2(const TrianglePacket& p, const Ray& r,
+        double t[4], double u[4], double v[4]) {
+        const __m256d dx = _mm256_set1_pd(r.dir.x);
+        const __m256d dy = _mm256_set1_pd(r.dir.y);
+        const __m256d dz = _mm256_set1_pd(r.dir.z);
+        const __m256d zero = _mm256_setzero_pd();
+        const __m256d one = _mm256_set1_pd(1);
+
+        __m256d e1x = _mm256_load_pd(p.e1[0]);
+        __m256d e1y = _mm256_load_pd(p.e1[1]);
+        __m256d e1z = _mm256_load_pd(p.e1[2]);
+        __m256d e2x = _mm256_load_pd(p.e2[0]);
+        __m256d e2y = _mm256_load_pd(p.e2[1]);
+        __m256d e2z = _mm256_load_pd(p.e2[2]);
+
+        __m256d hx = _mm256_sub_pd(_mm256_mul_pd(dy, e2z), _mm256_mul_pd(dz, e2y));
+        __m256d hy = _mm256_sub_pd(_mm256_mul_pd(dz, e2x), _mm256_mul_pd(dx, e2z));
+        __m256d hz = _mm256_sub_pd(_mm256_mul_pd(dx, e2y), _mm256_mul_pd(dy, e2x));
+        __m256d det = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(e1x, hx), _mm256_mul_pd(e1y, hy)),
+            _mm256_mul_pd(e1z, hz));
+        __m256d f = _mm256_div_pd(one, det);
+
+        __m256d sx = _mm256_sub_pd(_mm256_set1_pd(r.origin.x), _mm256_load_pd(p.p1[0]));
+        __m256d sy = _mm256_sub_pd(_mm256_set1_pd(r.origin.y), _mm256_load_pd(p.p1[1]));
+        __m256d sz = _mm256_sub_pd(_mm256_set1_pd(r.origin.z), _mm256_load_pd(p.p1[2]));
+        __m256d ui = _mm256_mul_pd(f, _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(sx, hx),
+            _mm256_mul_pd(sy, hy)), _mm256_mul_pd(sz, hz)));
+
+        __m256d qx = _mm256_sub_pd(_mm256_mul_pd(sy, e1z), _mm256_mul_pd(sz, e1y));
+        __m256d qy = _mm256_sub_pd(_mm256_mul_pd(sz, e1x), _mm256_mul_pd(sx, e1z));
+        __m256d qz = _mm256_sub_pd(_mm256_mul_pd(sx, e1y), _mm256_mul_pd(sy, e1x));
+        __m256d vi = _mm256_mul_pd(f, _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, qx),
+            _mm256_mul_pd(dy, qy)), _mm256_mul_pd(dz, qz)));
+        __m256d ti = _mm256_mul_pd(f, _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(e2x, qx),
+            _mm256_mul_pd(e2y, qy)), _mm256_mul_pd(e2z, qz)));
+
+        __m256d abs_det = _mm256_andnot_pd(_mm256_set1_pd(-0.0), det);
+        __m256d miss = _mm256_cmp_pd(abs_det, _mm256_set1_pd(EPSILON), _CMP_LT_OQ);
+        miss = _mm256_or_pd(miss, _mm256_cmp_pd(ui, zero, _CMP_LT_OQ));
+        miss = _mm256_or_pd(miss, _mm256_cmp_pd(ui, one, _CMP_GT_OQ));
+        miss = _mm256_or_pd(miss, _mm256_cmp_pd(vi, zero, _CMP_LT_OQ));
+        miss = _mm256_or_pd(miss, _mm256_cmp_pd(_mm256_add_pd(ui, vi), one, _CMP_GT_OQ));
+
+        _mm256_storeu_pd(t, ti);
+        _mm256_storeu_pd(u, ui);
+        _mm256_storeu_pd(v, vi);
+        return ~_mm256_movemask_pd(miss) & 0xFu;
+    }
+#else
+    // Four lanes at a time
+    unsigned intersect_sse2(const TrianglePacket& p, const Ray& r,
+        float t[8], float u[8], float v[8]) {
+        const __m128 dx = _mm_set1_ps(r.dir.x);
+        const __m128 dy = _mm_set1_ps(r.dir.y);
+        const __m128 dz = _mm_set1_ps(r.dir.z);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1);
+        const __m128 sign = _mm_set1_ps(-0.0f);
+        const __m128 epsilon = _mm_set1_ps(EPSILON);
+
+        unsigned mask = 0;
+        for (int i = 0; i < TrianglePacket::WIDTH; i += 4) {
+            __m128 e1x = _mm_load_ps(&p.e1[0][i]);
+            __m128 e1y = _mm_load_ps(&p.e1[1][i]);
+            __m128 e1z = _mm_load_ps(&p.e1[2][i]);
+            __m128 e2x = _mm_load_ps(&p.e2[0][i]);
+            __m128 e2y = _mm_load_ps(&p.e2[1][i]);
+            __m128 e2z = _mm_load_ps(&p.e2[2][i]);
+
+            __m128 hx = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+            __m128 hy = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+            __m128 hz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+            __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, hx), _mm_mul_ps(e1y, hy)),
+                _mm_mul_ps(e1z, hz));
+            __m128 f = _mm_div_ps(one, det);
+
+            __m128 sx = _mm_sub_ps(_mm_set1_ps(r.origin.x), _mm_load_ps(&p.p1[0][i]));
+            __m128 sy = _mm_sub_ps(_mm_set1_ps(r.origin.y), _mm_load_ps(&p.p1[1][i]));
+            __m128 sz = _mm_sub_ps(_mm_set1_ps(r.origin.z), _mm_load_ps(&p.p1[2][i]));
+            __m128 ui = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, hx), _mm_mul_ps(sy, hy)),
+                _mm_mul_ps(sz, hz)));
+
+            __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+            __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+            __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+            __m128 vi = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)),
+                _mm_mul_ps(dz, qz)));
+            __m128 ti = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)),
+                _mm_mul_ps(e2z, qz)));
+
+            // Ordered compares are false for NaN, like the scalar branches
+            __m128 miss = _mm_cmplt_ps(_mm_andnot_ps(sign, det), epsilon);
+            miss = _mm_or_ps(miss, _mm_cmplt_ps(ui, zero));
+            miss = _mm_or_ps(miss, _mm_cmpgt_ps(ui, one));
+            miss = _mm_or_ps(miss, _mm_cmplt_ps(vi, zero));
+            miss = _mm_or_ps(miss, _mm_cmpgt_ps(_mm_add_ps(ui, vi), one));
+
+            _mm_storeu_ps(t + i, ti);
+            _mm_storeu_ps(u + i, ui);
+            _mm_storeu_ps(v + i, vi);
+            mask |= (~_mm_movemask_ps(miss) & 0xFu) << i;
+        }
+        return mask;
+    }
+
+    // No FMA: contracting would round differently from the scalar path
+    __attribute__((target("avx2")))
+    unsigned intersect_avx2(const TrianglePacket& p, const Ray& r,
+        float t[8], float u[8], float v[8]) {
+        const __m256 dx = _mm256_set1_ps(r.dir.x);
+        const __m256 dy = _mm256_set1_ps(r.dir.y);
+        const __m256 dz = _mm256_set1_ps(r.dir.z);
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 one = _mm256_set1_ps(1);
+
+        __m256 e1x = _mm256_load_ps(p.e1[0]);
+        __m256 e1y = _mm256_load_ps(p.e1[1]);
+        __m256 e1z = _mm256_load_ps(p.e1[2]);
+        __m256 e2x = _mm256_load_ps(p.e2[0]);
+        __m256 e2y = _mm256_load_ps(p.e2[1]);
+        __m256 e2z = _mm256_load_ps(p.e2[2]);
+
+        __m256 hx = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+        __m256 hy = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+        __m256 hz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+        __m256 det = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, hx), _mm256_mul_ps(e1y, hy)),
+            _mm256_mul_ps(e1z, hz));
+        __m256 f = _mm256_div_ps(one, det);
+
+        __m256 sx = _mm256_sub_ps(_mm256_set1_ps(r.origin.x), _mm256_load_ps(p.p1[0]));
+        __m256 sy = _mm256_sub_ps(_mm256_set1_ps(r.origin.y), _mm256_load_ps(p.p1[1]));
+        __m256 sz = _mm256_sub_ps(_mm256_set1_ps(r.origin.z), _mm256_load_ps(p.p1[2]));
+        __m256 ui = _mm256_mul_ps(f, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sx, hx),
+            _mm256_mul_ps(sy, hy)), _mm256_mul_ps(sz, hz)));
+
+        __m256 qx = _mm256_sub_ps(_mm256_mul_ps(sy, e1z), _mm256_mul_ps(sz, e1y));
+        __m256 qy = _mm256_sub_ps(_mm256_mul_ps(sz, e1x), _mm256_mul_ps(sx, e1z));
+        __m256 qz = _mm256_sub_ps(_mm256_mul_ps(sx, e1y), _mm256_mul_ps(sy, e1x));
+        __m256 vi = _mm256_mul_ps(f, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx),
+            _mm256_mul_ps(dy, qy)), _mm256_mul_ps(dz, qz)));
+        __m256 ti = _mm256_mul_ps(f, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx),
+            _mm256_mul_ps(e2y, qy)), _mm256_mul_ps(e2z, qz)));
+
+        __m256 abs_det = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), det);
+        __m256 miss = _mm256_cmp_ps(abs_det, _mm256_set1_ps(EPSILON), _CMP_LT_OQ);
+        miss = _mm256_or_ps(miss, _mm256_cmp_ps(ui, zero, _CMP_LT_OQ));
+        miss = _mm256_or_ps(miss, _mm256_cmp_ps(ui, one, _CMP_GT_OQ));
+        miss = _mm256_or_ps(miss, _mm256_cmp_ps(vi, zero, _CMP_LT_OQ));
+        miss = _mm256_or_ps(miss, _mm256_cmp_ps(_mm256_add_ps(ui, vi), one, _CMP_GT_OQ));
+
+        _mm256_storeu_ps(t, ti);
+        _mm256_storeu_ps(u, ui);
+        _mm256_storeu_ps(v, vi);
+        return ~_mm256_movemask_ps(miss) & 0xFFu;
+    }
+#endif
+#endif
+}
+
+PacketIntersector packet_intersector(SimdLevel level) {
+#ifdef RT_X86_64
+    if (level == SimdLevel::AVX2 && simd_level_supported(level)) {
+        return intersect_avx2;
+    }
+    if (level == SimdLevel::SSE2) {
+        return intersect_sse2;
+    }
+#endif
+    return intersect_scalar;
+}
+
+unsigned intersect_packet(const TrianglePacket& packet, const Ray& r,
+    real t[TrianglePacket::WIDTH], real u[TrianglePacket::WIDTH], real v[TrianglePacket::WIDTH]) {
+    static const PacketIntersector intersect = packet_intersector(detect_simd_level());
+    return intersect(packet, r, t, u, v);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+
+#include "../geometry/ray.hpp"
+#include "simd.hpp"
+
+// Triangles in structure-of-arrays form (each row holds one coordinate of
+// every lane), so one Moller-Trumbore pass tests them all. A row fills a
+// 256-bit register: four triangles, or eight with RAYTRACER_FLOAT. Unused
+// lanes are left degenerate and never hit
+struct alignas(32) TrianglePacket {
+    static constexpr int WIDTH = 32 / sizeof(real);
+
+    real p1[3][WIDTH] = {};
+    real e1[3][WIDTH] = {};
+    real e2[3][WIDTH] = {};
+
+    void set(int lane, const Point& a, const Point& b, const Point& c);
+};
+
+// Intersects the ray with every lane, writing t/u/v of hit lanes. Returns
+// the mask of lanes hit (bit i for lane i). Same arithmetic, in the same
+// order, as intersect_triangle, so every level gives identical results
+using PacketIntersector = unsigned (*)(const TrianglePacket& packet, const Ray& r,
+    real t[TrianglePacket::WIDTH], real u[TrianglePacket::WIDTH], real v[TrianglePacket::WIDTH]);
+
+PacketIntersector packet_intersector(SimdLevel level);
+
+// Dispatches to the detected level, chosen once per process
+unsigned intersect_packet(const TrianglePacket& packet, const Ray& r,
+    real t[TrianglePacket::WIDTH], real u[TrianglePacket::WIDTH], real v[TrianglePacket::WIDTH]);
@@ -0,0 +1,207 @@
+#include "wide_bvh.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define RT_X86_64 1
+#include <immintrin.h>
+#endif
+
+namespace {
+    double node_area(const LinearBVHNode& node) {
+        return BoundingBox(Point(node.min[0], node.min[1], node.min[2]),
+            Point(node.max[0], node.max[1], node.max[2])).surface_area();
+    }
+
+    size_t subtree_depth(const std::vector<WideBVHNode>& nodes, uint32_t index) {
+        size_t depth = 0;
+        const WideBVHNode& node = nodes[index];
+        for (int i = 0; i < WideBVHNode::WIDTH; i++) {
+            if (node.count[i] == 0 && node.child[i] != 0) { // 0 (the root) marks an unused slot
+                depth = std::max(depth, subtree_depth(nodes, node.child[i]));
+            }
+        }
+        return depth + 1;
+    }
+
+    // NaN entry/exit values (a parallel ray starting on a slab plane) leave
+    // the running interval as is, like LinearBVH::slab
+    unsigned intersect_scalar(const WideBVHNode& node, const real origin[3],
+        const real inv_dir[3], real tmin, real tmax, real t_enter[4]) {
+        unsigned mask = 0;
+        for (int i = 0; i < WideBVHNode::WIDTH; i++) {
+            real enter = tmin;
+            real exit = tmax;
+            for (int axis = 0; axis < 3; axis++) {
+                bool positive = inv_dir[axis] >= 0;
+                real near = positive ? node.min[axis][i] : node.max[axis][i];
+                real far = positive ? node.max[axis][i] : node.min[axis][i];
+                real t_near = (near - origin[axis]) * inv_dir[axis];
+                real t_far = (far - origin[axis]) * inv_dir[axis];
+                enter = t_near > enter ? t_near : enter;
+                exit = t_far < exit ? t_far : exit;
+            }
+            t_enter[i] = enter;
+            mask |= (enter <= exit) << i;
+        }
+        return mask;
+    }
+
+#ifdef RT_X86_64
+#ifndef RAYTRACER_FLOAT
+    unsigned intersect_sse2(const WideBVHNode& node, const double origin[3],
+        const double inv_dir[3], double tmin, double tmax, double t_enter[4]) {
+        __m128d enter[2] = { _mm_set1_pd(tmin), _mm_set1_pd(tmin) };
+        __m128d exit[2] = { _mm_set1_pd(tmax), _mm_set1_pd(tmax) };
+        for (int axis = 0; axis < 3; axis++) {
+            bool positive = inv_dir[axis] >= 0;
+            __m128 near = _mm_load_ps(positive ? node.min[axis] : node.max[axis]);
+            __m128 far = _mm_load_ps(positive ? node.max[axis] : node.min[axis]);
+            __m128d o = _mm_set1_pd(origin[axis]);
+            __m128d inv = _mm_set1_pd(inv_dir[axis]);
+            __m128d near_pd[2] = { _mm_cvtps_pd(near), _mm_cvtps_pd(_mm_movehl_ps(near, near)) };
+            __m128d far_pd[2] = { _mm_cvtps_pd(far), _mm_cvtps_pd(_mm_movehl_ps(far, far)) };
+            for (int h = 0; h < 2; h++) {
+                // max/min return their second operand when either is NaN
+                enter[h] = _mm_max_pd(_mm_mul_pd(_mm_sub_pd(near_pd[h], o), inv), enter[h]);
+                exit[h] = _mm_min_pd(_mm_mul_pd(_mm_sub_pd(far_pd[h], o), inv), exit[h]);
+            }
+        }
+        _mm_storeu_pd(t_enter, enter[0]);
+        _mm_storeu_pd(t_enter + 2, enter[1]);
+        return _mm_movemask_pd(_mm_cmple_pd(enter[0], exit[0])) |
+            (_mm_movemask_pd(_mm_cmple_pd(enter[1], exit[1])) << 2);
+    }
+
+    __attribute__((target("avx2")))
+    unsigned intersect_avx2(const WideBVHNode& node, const double origin[3],
+        const double inv_dir[3], double tmin, double tmax, double t_enter[4]) {
+        __m256d enter = _mm256_set1_pd(tmin);
+        __m256d exit = _mm256_set1_pd(tmax);
+        for (int axis = 0; axis < 3; axis++) {
+            bool positive = inv_dir[axis] >= 0;
+            // Bounds widen to double exactly, so this is the scalar arithmetic
+            __m256d near = _mm256_cvtps_pd(_mm_load_ps(positive ? node.min[axis] : node.max[axis]));
+            __m256d far = _mm256_cvtps_pd(_mm_load_ps(positive ? node.max[axis] : node.min[axis]));
+            __m256d o = _mm256_set1_pd(origin[axis]);
+            __m256d inv = _mm256_set1_pd(inv_dir[axis]);
+            enter = _mm256_max_pd(_mm256_mul_pd(_mm256_sub_pd(near, o), inv), enter);
+            exit = _mm256_min_pd(_mm256_mul_pd(_mm256_sub_pd(far, o), inv), exit);
+        }
+        _mm256_storeu_pd(t_enter, enter);
+        return _mm256_movemask_pd(_mm256_cmp_pd(enter, exit, _CMP_LE_OQ));
+    }
+#else
+    // Float bounds and rays: one register holds the whole node
+    unsigned intersect_sse2(const WideBVHNode& node, const float origin[3],
+        const float inv_dir[3], float tmin, float tmax, float t_enter[4]) {
+        __m128 enter = _mm_set1_ps(tmin);
+        __m128 exit = _mm_set1_ps(tmax);
+        for (int axis = 0; axis < 3; axis++) {
+            bool positive = inv_dir[axis] >= 0;
+            __m128 near = _mm_load_ps(positive ? node.min[axis] : node.max[axis]);
+            __m128 far = _mm_load_ps(positive ? node.max[axis] : node.min[axis]);
+            __m128 o = _mm_set1_ps(origin[axis]);
+            __m128 inv = _mm_set1_ps(inv_dir[axis]);
+            // max/min return their second operand when either is NaN
+            enter = _mm_max_ps(_mm_mul_ps(_mm_sub_ps(near, o), inv), enter);
+            exit = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(far, o), inv), exit);
+        }
+        _mm_storeu_ps(t_enter, enter);
+        return _mm_movemask_ps(_mm_cmple_ps(enter, exit));
+    }
+
+    // Four floats already fit one SSE register, so AVX2 adds nothing
+    unsigned intersect_avx2(const WideBVHNode& node, const float origin[3],
+        const float inv_dir[3], float tmin, float tmax, float t_enter[4]) {
+        return intersect_sse2(node, origin, inv_dir, tmin, tmax, t_enter);
+    }
+#endif
+#endif
+}
+
+WideNodeIntersector wide_node_intersector(SimdLevel level) {
+#ifdef RT_X86_64
+    if (level == SimdLevel::AVX2 && simd_level_supported(level)) {
+        return intersect_avx2;
+    }
+    if (level == SimdLevel::SSE2) {
+        return intersect_sse2;
+    }
+#endif
+    return intersect_scalar;
+}
+
+unsigned intersect_wide_node(const WideBVHNode& node, const real origin[3],
+    const real inv_dir[3], real tmin, real tmax, real t_enter[WideBVHNode::WIDTH]) {
+    static const WideNodeIntersector intersect = wide_node_intersector(detect_simd_level());
+    return intersect(node, origin, inv_dir, tmin, tmax, t_enter);
+}
+
+WideBVH WideBVH::collapse(LinearBVH&& binary) {
+    WideBVH wide;
+    if (binary.empty()) {
+        return wide;
+    }
+    wide.nodes.reserve(binary.nodes.size() / 3 + 1);
+    wide.collapse_recursive(binary, 0);
+    wide.indices = std::move(binary.indices);
+    binary = LinearBVH();
+    return wide;
+}
+
+uint32_t WideBVH::collapse_recursive(const LinearBVH& binary, uint32_t root) {
+    const auto& bnodes = binary.nodes;
+    // Binary nodes that become this node's children
+    uint32_t slots[WideBVHNode::WIDTH] = { root };
+    int slot_count = 1;
+    if (!bnodes[root].is_leaf()) {
+        slots[0] = root + 1;
+        slots[1] = bnodes[root].offset;
+        slot_count = 2;
+    }
+    // Open up the biggest interior child while there is room; it is the
+    // one most rays would otherwise have to descend into
+    while (slot_count < WideBVHNode::WIDTH) {
+        int best = -1;
+        double best_area = -1;
+        for (int i = 0; i < slot_count; i++) {
+            const LinearBVHNode& node = bnodes[slots[i]];
+            if (!node.is_leaf() && node_area(node) > best_area) {
+                best = i;
+                best_area = node_area(node);
+            }
+        }
+        if (best < 0) {
+            break;
+        }
+        uint32_t opened = slots[best];
+        slots[best] = opened + 1;
+        slots[slot_count++] = bnodes[opened].offset;
+    }
+
+    uint32_t index = nodes.size();
+    nodes.emplace_back();
+    WideBVHNode& node = nodes[index];
+    for (int i = 0; i < WideBVHNode::WIDTH; i++) {
+        bool used = i < slot_count;
+        for (int axis = 0; axis < 3; axis++) {
+            node.min[axis][i] = used ? bnodes[slots[i]].min[axis] : INFINITY;
+            node.max[axis][i] = used ? bnodes[slots[i]].max[axis] : -INFINITY;
+        }
+        node.child[i] = used && bnodes[slots[i]].is_leaf() ? bnodes[slots[i]].offset : 0;
+        node.count[i] = used ? bnodes[slots[i]].count : 0;
+    }
+    for (int i = 0; i < slot_count; i++) {
+        if (!bnodes[slots[i]].is_leaf()) {
+            uint32_t child = collapse_recursive(binary, slots[i]);
+            nodes[index].child[i] = child; // node may have moved
+        }
+    }
+    return index;
+}
+
+size_t WideBVH::depth() const {
+    return nodes.empty() ? 0 : subtree_depth(nodes, 0);
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+#include "bvh.hpp"
+#include "simd.hpp"
+
+// Up to four children's bounds as structure-of-arrays float rows (rounded
+// outwards like LinearBVHNode), so one SIMD slab test covers all of them.
+// Unused slots hold an inverted box that no ray enters
+struct alignas(32) WideBVHNode {
+    static constexpr int WIDTH = 4;
+
+    float min[3][WIDTH];
+    float max[3][WIDTH];
+    // Leaf child: first entry in WideBVH::indices. Interior child: its node
+    // (never 0, the root, which unused slots hold)
+    uint32_t child[WIDTH];
+    uint32_t count[WIDTH]; // primitives in a leaf child; 0 otherwise
+};
+static_assert(sizeof(WideBVHNode) == 128);
+
+// Slab test of a ray against every slot of a node, clipped to [tmin, tmax].
+// Writes each hit slot's entry t and returns the mask of slots hit
+using WideNodeIntersector = unsigned (*)(const WideBVHNode& node, const real origin[3],
+    const real inv_dir[3], real tmin, real tmax, real t_enter[WideBVHNode::WIDTH]);
+
+WideNodeIntersector wide_node_intersector(SimdLevel level);
+
+// Dispatches to the detected level, chosen once per process
+unsigned intersect_wide_node(const WideBVHNode& node, const real origin[3],
+    const real inv_dir[3], real tmin, real tmax, real t_enter[WideBVHNode::WIDTH]);
+
+// 4-wide BVH collapsed from a binary LinearBVH: each node absorbs the
+// largest interior nodes below it until it has four children. Leaves keep
+// their ranges of indices, so LinearBVH::align_leaves() layouts carry over
+struct WideBVH {
+    std::vector<WideBVHNode> nodes; // root first
+    std::vector<uint32_t> indices;
+
+    static WideBVH collapse(LinearBVH&& binary);
+
+    bool empty() const { return nodes.empty(); }
+    size_t depth() const;
+
+    // Same contract as LinearBVH::traverse: visit(const uint32_t* prims,
+    // uint32_t count, real tmax) returns the new tmax. Children are tested
+    // together and pushed far to near, so leaves are visited front to back
+    template<typename Visit>
+    void traverse(const Ray& r, Visit&& visit) const;
+
+private:
+    // 3 slots left behind per level of a tree at most 64 deep, plus the root's 4
+    static constexpr size_t STACK_SIZE = 256;
+
+    uint32_t collapse_recursive(const LinearBVH& binary, uint32_t node);
+};
+
+template<typename Visit>
+void WideBVH::traverse(const Ray& r, Visit&& visit) const {
+    if (nodes.empty()) {
+        return;
+    }
+    const real origin[3] = { r.origin.x, r.origin.y, r.origin.z };
+    const real inv_dir[3] = { r.inv_dir.x, r.inv_dir.y, r.inv_dir.z };
+    const real tmin = r.tmin;
+    real tmax = r.tmax;
+
+    struct Entry {
+        uint32_t ref; // node, or offset into indices for a leaf
+        uint32_t count;
+        real t_enter;
+    };
+    Entry stack[STACK_SIZE];
+    size_t top = 0;
+    stack[top++] = { 0, 0, tmin };
+
+    while (top > 0) {
+        Entry entry = stack[--top];
+        if (entry.t_enter > tmax) {
+            continue; // a closer hit was found since this was pushed
+        }
+        if (entry.count > 0) {
+            tmax = visit(&indices[entry.ref], entry.count, tmax);
+            continue;
+        }
+
+        const WideBVHNode& node = nodes[entry.ref];
+        real t_enter[WideBVHNode::WIDTH];
+        Entry hit[WideBVHNode::WIDTH];
+        int hit_count = 0;
+        for (unsigned mask = intersect_wide_node(node, origin, inv_dir, tmin, tmax, t_enter);
+            mask; mask &= mask - 1) {
+            int slot = std::countr_zero(mask);
+            if (node.count[slot] == 0 && node.child[slot] <= entry.ref) {
+                continue; // an unused slot (or a cycle) whose box wasn't empty
+            }
+            // Insertion sort, farthest first
+            int i = hit_count++;
+            for (; i > 0 && hit[i - 1].t_enter < t_enter[slot]; i--) {
+                hit[i] = hit[i - 1];
+            }
+            hit[i] = { node.child[slot], node.count[slot], t_enter[slot] };
+        }
+        for (int i = 0; i < hit_count; i++) {
+            stack[top++] = hit[i];
+        }
+    }
+}
@@ -0,0 +1,900 @@
+#include "benchmarks.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <new>
+#include <optional>
+#include <random>
+#include <vector>
+
+#include "accel/triangle_packet.hpp"
+#include "accel/wide_bvh.hpp"
+#include "geometry/shapes/mesh_cache.hpp"
+#include "geometry/shapes/obj_parser.hpp"
+#include "mapped_file.hpp"
+#include "math/transformations.hpp"
+#include "rendering/camera.hpp"
+#include "rendering/thread_pool.hpp"
+
+// Counts every heap allocation in bench_renders. Every replaceable form is
+// defined, so nothing mixes these with the library's own (nothrow forms
+// call the plain ones)
+static std::atomic<size_t> allocation_count = 0;
+
+static void* counted_alloc(size_t size, size_t alignment = 0) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    size = size ? size : 1;
+    // aligned_alloc wants a multiple of the alignment
+    void* p = alignment > alignof(std::max_align_t)
+        ? std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment)
+        : std::malloc(size);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+// counted_alloc's match. Kept out of line, or GCC inlines the free() into
+// callers of delete and flags it against their operator new
+[[gnu::noinline]] static void counted_free(void* p) noexcept {
+    std::free(p);
+}
+
+void* operator new(size_t size) { return counted_alloc(size); }
+void* operator new[](size_t size) { return counted_alloc(size); }
+void* operator new(size_t size, std::align_val_t align) { return counted_alloc(size, static_cast<size_t>(align)); }
+void* operator new[](size_t size, std::align_val_t align) { return counted_alloc(size, static_cast<size_t>(align)); }
+
+void operator delete(void* p) noexcept { counted_free(p); }
+void operator delete[](void* p) noexcept { counted_free(p); }
+void operator delete(void* p, size_t) noexcept { counted_free(p); }
+void operator delete[](void* p, size_t) noexcept { counted_free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { counted_free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { counted_free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { counted_free(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { counted_free(p); }
+
+namespace {
+    // Keeps results observable so the timed loops aren't optimized away
+    volatile double sink = 0;
+
+    size_t arg_or(int argc, char* argv[], int index, size_t fallback) {
+        return index < argc ? std::stoul(argv[index]) : fallback;
+    }
+
+    // Writes a side x side grid (with normals, as quads) and returns its path
+    std::string write_synthetic_obj(size_t side) {
+        auto path = std::filesystem::temp_directory_path() / ("bench_grid_" + std::to_string(side) + ".obj");
+        std::ofstream out(path);
+        out << std::fixed << std::setprecision(6);
+        for (size_t y = 0; y <= side; y++) {
+            for (size_t x = 0; x <= side; x++) {
+                double h = std::sin(x * .1) * std::cos(y * .1);
+                out << "v " << x * .01 << " " << h << " " << y * .01 << "\n";
+                out << "vn " << -std::cos(x * .1) << " 1 " << std::sin(y * .1) << "\n";
+            }
+        }
+        out << "g grid\n";
+        for (size_t y = 0; y < side; y++) {
+            for (size_t x = 0; x < side; x++) {
+                size_t i = y * (side + 1) + x + 1;
+                size_t j = i + side + 1;
+                out << "f " << i << "//" << i << " " << i + 1 << "//" << i + 1 << " "
+                    << j + 1 << "//" << j + 1 << " " << j << "//" << j << "\n";
+            }
+        }
+        return path.string();
+    }
+
+    // Pixel bytes of a P6 file written by Canvas::save_ppm, empty if missing
+    std::vector<uint8_t> read_p6(const std::string& path, size_t width, size_t height) {
+        std::ifstream in(path, std::ios::binary);
+        std::string magic;
+        size_t w = 0, h = 0, max = 0;
+        in >> magic >> w >> h >> max;
+        in.get();
+        std::vector<uint8_t> rgb(3 * width * height);
+        if (!in || magic != "P6" || w != width || h != height ||
+            !in.read(reinterpret_cast<char*>(rgb.data()), rgb.size())) {
+            return {};
+        }
+        return rgb;
+    }
+
+    void report(const std::string& label, double ms, size_t count) {
+        std::cout << std::left << std::setw(32) << label << std::right
+            << std::setw(10) << std::fixed << std::setprecision(2) << ms << " ms"
+            << std::setw(12) << std::setprecision(1) << (ms * 1e6 / count)
+            << " ns/op\n";
+    }
+}
+
+int Benchmarks::run(const std::string& name, int argc, char* argv[]) {
+    static const std::map<std::string, std::function<int(int, char**)>> benchmarks = {
+        { "allocations", allocations },
+        { "matrix_inverse", matrix_inverse },
+        { "obj_load", obj_load },
+        { "triangle_packets", triangle_packets },
+        { "bvh_traversal", bvh_traversal },
+        { "compiled_scene", compiled_scene },
+        { "world_objects", world_objects },
+        { "world_transforms", world_transforms },
+        { "bake_transforms", bake_transforms },
+        { "instances", instances },
+        { "bvh_build", bvh_build },
+        { "morton_bvh", morton_bvh },
+        { "scenes", scenes },
+    };
+
+    auto it = benchmarks.find(name);
+    if (it == benchmarks.end()) {
+        std::cerr << "Unknown benchmark: " << name << "\nAvailable:";
+        for (const auto& [bench_name, fn] : benchmarks) {
+            std::cerr << " " << bench_name;
+        }
+        std::cerr << "\n";
+        return 1;
+    }
+    return it->second(argc, argv);
+}
+
+// ./bench_renders matrix_inverse [count]
+int Benchmarks::matrix_inverse(int argc, char* argv[]) {
+    size_t count = arg_or(argc, argv, 0, 50'000);
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> angle(0, 2 * M_PI);
+    std::uniform_real_distribution<double> scale(0.5, 4);
+    std::uniform_real_distribution<double> offset(-100, 100);
+
+    // Typical instance transforms (affine), plus a projective copy of each to
+    // exercise the general 4x4 path
+    std::vector<Matrix4> affine;
+    std::vector<Matrix4> projective;
+    affine.reserve(count);
+    projective.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        Transform t = Transform::translation(offset(rng), offset(rng), offset(rng)) *
+            Transform::rotation_y(angle(rng)) * Transform::rotation_x(angle(rng)) *
+            Transform::scaling(scale(rng), scale(rng), scale(rng));
+        affine.push_back(t);
+        Matrix4 p = t;
+        p(3, 0) = 0.01;
+        p(3, 2) = -0.02;
+        projective.push_back(p);
+    }
+
+    std::cout << "Inverting " << count << " 4x4 matrices\n";
+
+    double cofactor_ms = time_ms([&] {
+        for (const auto& m : affine) {
+            sink = sink + Matrix(m).inverse().data[3];
+        }
+        });
+    report("cofactor expansion (Matrix)", cofactor_ms, count);
+
+    double general_ms = time_ms([&] {
+        for (const auto& m : projective) {
+            sink = sink + m.inverse().data[3];
+        }
+        });
+    report("closed-form general (Matrix4)", general_ms, count);
+
+    double affine_ms = time_ms([&] {
+        for (const auto& m : affine) {
+            sink = sink + m.inverse().data[3];
+        }
+        });
+    report("closed-form affine (Matrix4)", affine_ms, count);
+
+    double transform_ms = time_ms([&] {
+        for (const auto& m : affine) {
+            sink = sink + Transform(m).inverse_matrix().data[3];
+        }
+        });
+    report("Transform construction", transform_ms, count);
+
+    std::cout << "Speedup over cofactor: " << std::setprecision(1)
+        << cofactor_ms / general_ms << "x general, "
+        << cofactor_ms / affine_ms << "x affine\n";
+    return 0;
+}
+
+// ./bench_renders allocations [size]
+int Benchmarks::allocations(int argc, char* argv[]) {
+    size_t size = arg_or(argc, argv, 0, 100);
+
+    // Default world spheres on a floor, plus a BVH'd group of small spheres
+    auto [w, s1, s2] = World::default_world();
+    auto floor_u = std::make_unique<Plane>();
+    floor_u.get()->transform = Transform::translation(0, -1, 0);
+    w.add_object(std::move(floor_u));
+
+    auto group_u = std::make_unique<Group>();
+    for (int i = 0; i < 64; i++) {
+        auto s_u = std::make_unique<Sphere>();
+        s_u.get()->transform = Transform::translation(i % 8 - 3.5, -.75, i / 8 + 2) *
+            Transform::scaling(.25, .25, .25);
+        group_u.get()->add_child(std::move(s_u));
+    }
+    group_u.get()->build_bvh();
+    w.add_object(std::move(group_u));
+    w.prepare();
+
+    Camera camera(size, size, M_PI / 3);
+    camera.transform = Transform::view_transform(Point(0, 1.5, -5), Point(0, 0, 0), Vector(0, 1, 0));
+    std::vector<Ray> rays;
+    rays.reserve(size * size);
+    for (size_t y = 0; y < size; y++) {
+        for (size_t x = 0; x < size; x++) {
+            rays.push_back(camera.ray_for_pixel(x, y));
+        }
+    }
+
+    // First pass warms this thread's spill arena
+    auto measure = [&](const std::string& label, auto&& trace) {
+        for (const Ray& r : rays) {
+            trace(r);
+        }
+        size_t before = allocation_count.load();
+        double ms = time_ms([&] {
+            for (const Ray& r : rays) {
+                trace(r);
+            }
+            });
+        size_t allocs = allocation_count.load() - before;
+        report(label, ms, rays.size());
+        std::cout << std::setw(44) << allocs << " allocations ("
+            << std::setprecision(3) << double(allocs) / rays.size() << " per ray)\n";
+        };
+
+    std::cout << rays.size() << " primary rays\n";
+    measure("intersect_world", [&](const Ray& r) {
+        sink = sink + w.intersect_world(r).count;
+        });
+    measure("color_at", [&](const Ray& r) {
+        sink = sink + w.color_at(r).r;
+        });
+    return 0;
+}
+
+// ./bench_renders obj_load [obj_file] [synthetic_side] [threads]
+int Benchmarks::obj_load(int argc, char* argv[]) {
+    std::string teapot = argc > 0 ? argv[0] : "../tests/test_files/teapot.obj";
+    size_t side = arg_or(argc, argv, 1, 700);
+    size_t threads = arg_or(argc, argv, 2, ThreadPool::default_thread_count());
+    std::string synthetic = write_synthetic_obj(side);
+
+    for (const auto& path : { teapot, synthetic }) {
+        double mb = std::filesystem::file_size(path) / 1e6;
+        std::cout << path << " (" << std::setprecision(1) << mb << " MB)\n";
+        double getline_ms = time_ms([&] {
+            auto group = ObjParser::parse_obj_file(path.c_str()).obj_to_group();
+            sink = sink + group.get()->shapes.size();
+            });
+        // Best of 3, so page faults on the first mapping aren't counted
+        auto best_parse_ms = [&](size_t num_threads) {
+            double best = INFINITY;
+            for (int rep = 0; rep < 3; rep++) {
+                best = std::min(best, time_ms([&] {
+                    MappedFile file(path.c_str());
+                    sink = sink + ObjParser::parse_obj_data(file.contents(), num_threads).faces.size();
+                    }));
+            }
+            return best;
+            };
+        double parse_ms = best_parse_ms(1);
+        double parallel_ms = best_parse_ms(threads);
+        double mapped_ms = time_ms([&] {
+            auto group = ObjParser::parse_obj_file_mapped(path.c_str()).obj_to_group();
+            sink = sink + group.get()->shapes.size();
+            });
+
+        std::unique_ptr<Group> model;
+        double mesh_ms = time_ms([&] {
+            model = ObjParser::parse_obj_mesh(path.c_str());
+            });
+        std::string cache = path + ".rtmesh";
+        MeshCacheKey key = MeshCacheKey::of(path.c_str());
+        MeshCache::save(cache, *model, key);
+        double cache_ms = INFINITY;
+        for (int rep = 0; rep < 3; rep++) {
+            cache_ms = std::min(cache_ms, time_ms([&] {
+                sink = sink + MeshCache::load(cache, key).get()->shapes.size();
+                }));
+        }
+        std::filesystem::remove(cache);
+
+        auto throughput = [mb](const std::string& label, double ms) {
+            std::cout << std::left << std::setw(32) << label << std::right
+                << std::setw(10) << std::fixed << std::setprecision(2) << ms << " ms"
+                << std::setw(10) << std::setprecision(1) << mb / (ms / 1000) << " MB/s\n";
+            };
+        throughput("getline + boost::split", getline_ms);
+        throughput("mapped parse (ObjData)", parse_ms);
+        throughput("chunked parse, " + std::to_string(threads) + " threads", parallel_ms);
+        throughput("mapped parse + groups", mapped_ms);
+        throughput("mapped parse + meshes (w/ BVH)", mesh_ms);
+        throughput("mesh cache load", cache_ms);
+    }
+    std::filesystem::remove(synthetic);
+    return 0;
+}
+
+// ./bench_renders triangle_packets [rays] [obj_file]
+int Benchmarks::triangle_packets(int argc, char* argv[]) {
+    size_t count = arg_or(argc, argv, 0, 200'000);
+    std::string path = argc > 1 ? argv[1] : "../tests/test_files/teapot.obj";
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> unit(-1, 1);
+    auto random_point = [&] { return Point(unit(rng), unit(rng), unit(rng)); };
+
+    // Kernels alone: one ray against one packet of small random triangles
+    std::vector<TrianglePacket> packets(1024);
+    for (auto& packet : packets) {
+        for (int lane = 0; lane < TrianglePacket::WIDTH; lane++) {
+            Point a = random_point();
+            packet.set(lane, a, a + Vector(unit(rng), unit(rng), 0), a + Vector(0, unit(rng), unit(rng)));
+        }
+    }
+    std::vector<Ray> rays;
+    for (size_t i = 0; i < count; i++) {
+        rays.emplace_back(Point(unit(rng), unit(rng), -5), Vector(unit(rng) * .2, unit(rng) * .2, 1));
+    }
+    std::cout << count << " ray/packet tests (" << TrianglePacket::WIDTH << " triangles each)\n";
+    for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2 }) {
+        if (!simd_level_supported(level)) {
+            continue;
+        }
+        PacketIntersector intersect = packet_intersector(level);
+        double ms = time_ms([&] {
+            real t[TrianglePacket::WIDTH], u[TrianglePacket::WIDTH], v[TrianglePacket::WIDTH];
+            for (size_t i = 0; i < count; i++) {
+                sink = sink + intersect(packets[i % packets.size()], rays[i], t, u, v);
+            }
+            });
+        report(simd_level_name(level), ms, count);
+    }
+
+    // Whole closest-hit queries: mesh (detected level) vs a Triangle per face
+    auto meshes = ObjParser::parse_obj_mesh(path.c_str());
+    auto triangles = ObjParser::parse_obj_file_mapped(path.c_str()).obj_to_group();
+    triangles.get()->build_bvh();
+    BoundingBox bb = meshes.get()->bounds_of();
+    Point center = bb.centroid();
+    double radius = Vector(bb.max - bb.min).magnitude();
+    for (Ray& r : rays) {
+        Point origin = center + Vector(unit(rng), unit(rng), unit(rng)).normalized() * radius;
+        r = Ray(origin, center + Vector(unit(rng), unit(rng), unit(rng)) * (radius / 4) - origin);
+    }
+    std::cout << path << ", closest hit (" << simd_level_name(detect_simd_level()) << " packets)\n";
+    double mesh_ms = time_ms([&] {
+        for (const Ray& r : rays) {
+            sink = sink + meshes.get()->intersect_closest(r).has_value();
+        }
+        });
+    report("TriangleMesh", mesh_ms, count);
+    double triangle_ms = time_ms([&] {
+        for (const Ray& r : rays) {
+            sink = sink + triangles.get()->intersect_closest(r).has_value();
+        }
+        });
+    report("Group of Triangles", triangle_ms, count);
+    return 0;
+}
+
+// ./bench_renders bvh_traversal [rays] [boxes]
+int Benchmarks::bvh_traversal(int argc, char* argv[]) {
+    size_t count = arg_or(argc, argv, 0, 200'000);
+    size_t box_count = arg_or(argc, argv, 1, 100'000);
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> unit(-1, 1);
+    std::vector<BoundingBox> bounds;
+    for (size_t i = 0; i < box_count; i++) {
+        Point p(unit(rng) * 50, unit(rng) * 50, unit(rng) * 50);
+        bounds.emplace_back(p, p + Vector(1, 1, 1));
+    }
+    std::vector<Ray> rays;
+    for (size_t i = 0; i < count; i++) {
+        Point origin(unit(rng) * 100, unit(rng) * 100, -100);
+        rays.emplace_back(origin, Point(unit(rng) * 50, unit(rng) * 50, unit(rng) * 50) - origin, 0, INFINITY);
+    }
+
+    LinearBVH binary = LinearBVH::build(bounds);
+    WideBVH wide = WideBVH::collapse(LinearBVH(binary));
+    std::cout << box_count << " boxes: " << binary.nodes.size() << " binary nodes (depth "
+        << binary.depth() << "), " << wide.nodes.size() << " wide nodes (depth " << wide.depth() << ")\n";
+    std::cout << "Closest box hit (" << simd_level_name(detect_simd_level()) << ")\n";
+
+    // Closest-hit style query: each leaf box hit shortens the ray
+    auto closest = [&](const auto& bvh) {
+        return time_ms([&] {
+            for (const Ray& r : rays) {
+                bvh.traverse(r, [&](const uint32_t* prims, uint32_t n, double tmax) {
+                    for (uint32_t i = 0; i < n; i++) {
+                        if (auto hit = bounds[prims[i]].slab(r.clipped(0, tmax))) {
+                            tmax = hit->first;
+                        }
+                    }
+                    return tmax;
+                    });
+                sink = sink + 1;
+            }
+            });
+        };
+    report("LinearBVH", closest(binary), count);
+    report("WideBVH", closest(wide), count);
+    return 0;
+}
+
+// ./bench_renders compiled_scene [rays] [objects]
+int Benchmarks::compiled_scene(int argc, char* argv[]) {
+    size_t count = arg_or(argc, argv, 0, 200'000);
+    size_t object_count = arg_or(argc, argv, 1, 20'000);
+
+    // Mixed primitives, each under a transform of its own, in one SAH group
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> unit(-1, 1);
+    World w;
+    auto group = std::make_unique<Group>();
+    for (size_t i = 0; i < object_count; i++) {
+        std::unique_ptr<Shape> shape;
+        switch (i % 4) {
+        case 0: shape = std::make_unique<Sphere>(); break;
+        case 1: shape = std::make_unique<Cube>(); break;
+        case 2: {
+            auto cylinder = std::make_unique<Cylinder>();
+            cylinder->minimum = -1;
+            cylinder->maximum = 1;
+            cylinder->closed = true;
+            shape = std::move(cylinder);
+            break;
+        }
+        default: {
+            auto cone = std::make_unique<Cone>();
+            cone->minimum = -1;
+            cone->maximum = 0;
+            cone->closed = true;
+            shape = std::move(cone);
+            break;
+        }
+        }
+        shape->transform = Transform::translation(unit(rng) * 50, unit(rng) * 50, unit(rng) * 50)
+            * Transform::rotation_y(unit(rng) * 3) * Transform::scaling(.5, .5, .5);
+        group->add_child(std::move(shape));
+    }
+    group->divide_sah();
+    w.add_object(std::move(group));
+
+    std::vector<Ray> rays;
+    for (size_t i = 0; i < count; i++) {
+        Point origin(unit(rng) * 100, unit(rng) * 100, -100);
+        Point target(unit(rng) * 50, unit(rng) * 50, unit(rng) * 50);
+        rays.emplace_back(origin, Vector(target - origin).normalized());
+    }
+
+    auto closest = [&] {
+        return time_ms([&] {
+            for (const Ray& r : rays) {
+                sink = sink + w.intersect_closest(r).has_value();
+            }
+            });
+        };
+    auto occluded = [&] {
+        return time_ms([&] {
+            for (const Ray& r : rays) {
+                sink = sink + w.occluded(r, 150);
+            }
+            });
+        };
+
+    std::cout << object_count << " objects\n";
+    report("Group closest hit", closest(), count);
+    report("Group occluded", occluded(), count);
+    double build_ms = time_ms([&] { w.prepare(); });
+    std::cout << "Compiled " << w.compiled_scene().primitive_count() << " primitives in "
+        << std::fixed << std::setprecision(2) << build_ms << " ms\n";
+    report("CompiledScene closest hit", closest(), count);
+    report("CompiledScene occluded", occluded(), count);
+    return 0;
+}
+
+// ./bench_renders world_objects [rays] [objects]
+int Benchmarks::world_objects(int argc, char* argv[]) {
+    size_t count = arg_or(argc, argv, 0, 20'000);
+    size_t object_count = arg_or(argc, argv, 1, 5'000);
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> unit(-1, 1);
+    World w;
+    for (size_t i = 0; i < object_count; i++) {
+        auto sphere = std::make_unique<Sphere>();
+        sphere->transform = Transform::translation(unit(rng) * 50, unit(rng) * 50, unit(rng) * 50)
+            * Transform::scaling(.5, .5, .5);
+        w.add_object(std::move(sphere));
+    }
+    std::vector<Ray> rays;
+    for (size_t i = 0; i < count; i++) {
+        Point origin(unit(rng) * 100, unit(rng) * 100, -100);
+        Point target(unit(rng) * 50, unit(rng) * 50, unit(rng) * 50);
+        rays.emplace_back(origin, Vector(target - origin).normalized());
+    }
+
+    std::cout << object_count << " top-level objects\n";
+    // What intersect_closest did before the world had a BVH
+    double scan_ms = time_ms([&] {
+        for (const Ray& r : rays) {
+            real tmax = INFINITY;
+            for (const auto& object : w.all_objects()) {
+                if (auto hit = object->intersect_closest(r, tmax)) {
+                    tmax = hit->t;
+                }
+            }
+            sink = sink + tmax;
+        }
+        });
+    report("Scan of every object", scan_ms, count);
+    double build_ms = time_ms([&] { w.intersect_closest(rays[0]); });
+    std::cout << "Top-level BVH built in " << std::fixed << std::setprecision(2) << build_ms << " ms\n";
+    report("Top-level BVH", time_ms([&] {
+        for (const Ray& r : rays) {
+            sink = sink + w.intersect_closest(r).has_value();
+        }
+        }), count);
+    return 0;
+}
+
+// ./bench_renders world_transforms [points] [depth]
+int Benchmarks::world_transforms(int argc, char* argv[]) {
+    size_t count = arg_or(argc, argv, 0, 1'000'000);
+    size_t depth = arg_or(argc, argv, 1, 4);
+
+    // A sphere at the bottom of a chain of transformed groups
+    Group root;
+    root.transform = Transform::rotation_y(.3);
+    Group* parent = &root;
+    for (size_t i = 1; i < depth; i++) {
+        auto group = std::make_unique<Group>();
+        group->transform = Transform::translation(1, 0, 0) * Transform::rotation_x(.2);
+        Group* next = group.get();
+        parent->add_child(std::move(group));
+        parent = next;
+    }
+    auto sphere_u = std::make_unique<Sphere>();
+    Sphere* sphere = sphere_u.get();
+    sphere->transform = Transform::scaling(1, 2, 1);
+    parent->add_child(std::move(sphere_u));
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> unit(-1, 1);
+    std::vector<Point> points;
+    for (size_t i = 0; i < count; i++) {
+        points.emplace_back(unit(rng), unit(rng), unit(rng));
+    }
+
+    // What world_to_object/normal_to_world did before the cache: one level
+    // per call, back up the parent chain
+    auto chained = [](auto&& self, const Shape* s, Point p) -> Point {
+        if (s->parent.has_value()) {
+            p = self(self, s->parent.value(), p);
+        }
+        return s->transform.inverse_matrix() * p;
+        };
+    std::cout << "Sphere " << depth << " levels deep\n";
+    report("Per-level world_to_object", time_ms([&] {
+        for (const Point& p : points) {
+            sink = sink + chained(chained, sphere, p).x;
+        }
+        }), count);
+    report("Cached world_to_object", time_ms([&] {
+        for (const Point& p : points) {
+            sink = sink + sphere->world_to_object(p).x;
+        }
+        }), count);
+    report("Cached normal_at", time_ms([&] {
+        for (const Point& p : points) {
+            sink = sink + sphere->normal_at(p).x;
+        }
+        }), count);
+    return 0;
+}
+
+// ./bench_renders bake_transforms [rays] [triangles]
+int Benchmarks::bake_transforms(int argc, char* argv[]) {
+    size_t count = arg_or(argc, argv, 0, 200'000);
+    size_t triangle_count = arg_or(argc, argv, 1, 50'000);
+
+    // Like a parsed OBJ under a scene transform: triangles in transformed
+    // groups of 256, inside a rotated group
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> unit(-1, 1);
+    Group root;
+    root.transform = Transform::rotation_y(.5) * Transform::scaling(2, 2, 2);
+    for (size_t i = 0; i < triangle_count; i += 256) {
+        auto group = std::make_unique<Group>();
+        group->transform = Transform::translation(unit(rng) * 10, unit(rng) * 10, unit(rng) * 10);
+        for (size_t j = i; j < std::min(i + 256, triangle_count); j++) {
+            Point p(unit(rng) * 3, unit(rng) * 3, unit(rng) * 3);
+            group->add_child(std::make_unique<Triangle>(p, p + Vector(unit(rng), unit(rng), 0) * .3,
+                p + Vector(0, unit(rng), unit(rng)) * .3));
+        }
+        group->build_bvh();
+        root.add_child(std::move(group));
+    }
+    root.build_bvh();
+
+    std::vector<Ray> rays;
+    for (size_t i = 0; i < count; i++) {
+        Point origin(unit(rng) * 40, unit(rng) * 40, -60);
+        Point target(unit(rng) * 20, unit(rng) * 20, unit(rng) * 20);
+        rays.emplace_back(origin, Vector(target - origin).normalized());
+    }
+    auto closest = [&] {
+        return time_ms([&] {
+            for (const Ray& r : rays) {
+                sink = sink + root.intersect_closest(r).has_value();
+            }
+            });
+        };
+
+    std::cout << triangle_count << " triangles\n";
+    report("Transformed subgroups", closest(), count);
+    double bake_ms = time_ms([&] { root.bake_child_transforms(); });
+    std::cout << "Baked in " << std::fixed << std::setprecision(2) << bake_ms << " ms\n";
+    report("Baked", closest(), count);
+    return 0;
+}
+
+// ./bench_renders instances [rays] [copies] [obj_file]
+int Benchmarks::instances(int argc, char* argv[]) {
+    size_t count = arg_or(argc, argv, 0, 100'000);
+    size_t copy_count = arg_or(argc, argv, 1, 100);
+    std::string path = argc > 2 ? argv[2] : "../tests/test_files/teapot.obj";
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> unit(-1, 1);
+    std::uniform_real_distribution<double> angle(0, 2 * M_PI);
+    std::vector<Transform> placements;
+    for (size_t i = 0; i < copy_count; i++) {
+        placements.push_back(Transform::translation(unit(rng) * 100, unit(rng) * 100, unit(rng) * 100)
+            * Transform::rotation_y(angle(rng)) * Transform::rotation_x(-M_PI / 2));
+    }
+    auto face_count = [](const Group& group) {
+        size_t faces = 0;
+        for (const auto& child : group.shapes) {
+            if (auto mesh = dynamic_cast<const TriangleMesh*>(child.get())) {
+                faces += mesh->face_count();
+            }
+        }
+        return faces;
+        };
+
+    // Every placement parses and builds its own meshes, as before instancing
+    World copies;
+    size_t copied_faces = 0;
+    double copies_ms = time_ms([&] {
+        for (const Transform& placement : placements) {
+            auto teapot = ObjParser::parse_obj_mesh(path.c_str());
+            teapot->transform = placement;
+            copied_faces += face_count(*teapot);
+            copies.add_object(std::move(teapot));
+        }
+        copies.prepare();
+        });
+    World instanced;
+    size_t instanced_faces = 0;
+    double instances_ms = time_ms([&] {
+        std::shared_ptr<Group> teapot = ObjParser::parse_obj_mesh(path.c_str());
+        instanced_faces = face_count(*teapot);
+        for (const Transform& placement : placements) {
+            instanced.add_object(std::make_unique<Instance>(teapot, placement));
+        }
+        instanced.prepare();
+        });
+
+    std::vector<Ray> rays;
+    for (size_t i = 0; i < count; i++) {
+        Point origin(unit(rng) * 200, unit(rng) * 200, -200);
+        Point target(unit(rng) * 100, unit(rng) * 100, unit(rng) * 100);
+        rays.emplace_back(origin, Vector(target - origin).normalized());
+    }
+    auto closest = [&](const World& w) {
+        return time_ms([&] {
+            for (const Ray& r : rays) {
+                sink = sink + w.intersect_closest(r).has_value();
+            }
+            });
+        };
+
+    std::cout << copy_count << " placements of " << path << "\n" << std::fixed << std::setprecision(2)
+        << "Copies:    " << copied_faces << " faces stored, built in " << copies_ms << " ms\n"
+        << "Instances: " << instanced_faces << " faces stored, built in " << instances_ms << " ms\n";
+    report("Copies", closest(copies), count);
+    report("Instances", closest(instanced), count);
+    return 0;
+}
+
+// ./bench_renders bvh_build [triangles] [max_threads] [obj_file]
+int Benchmarks::bvh_build(int argc, char* argv[]) {
+    size_t triangle_count = arg_or(argc, argv, 0, 10'000'000);
+    size_t max_threads = arg_or(argc, argv, 1, ThreadPool::default_thread_count());
+    std::string path = argc > 2 ? argv[2] : "../tests/test_files/teapot.obj";
+
+    std::vector<BoundingBox> teapot;
+    auto model = ObjParser::parse_obj_mesh(path.c_str());
+    for (const auto& child : model->shapes) {
+        if (auto mesh = dynamic_cast<const TriangleMesh*>(child.get())) {
+            for (uint32_t face = 0; face < mesh->face_count(); face++) {
+                teapot.push_back(mesh->face_bounds(face));
+            }
+        }
+    }
+    // Small triangles scattered through a box, like a dense scanned mesh
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> unit(-1, 1);
+    std::vector<BoundingBox> synthetic;
+    synthetic.reserve(triangle_count);
+    for (size_t i = 0; i < triangle_count; i++) {
+        Point p(unit(rng) * 100, unit(rng) * 100, unit(rng) * 100);
+        synthetic.emplace_back(p, p + Vector(unit(rng) + 1, unit(rng) + 1, unit(rng) + 1) * .05);
+    }
+
+    std::vector<size_t> thread_counts;
+    for (size_t threads = 1; threads < max_threads; threads *= 2) {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(max_threads);
+
+    for (const auto& [name, bounds] : { std::pair(path, &teapot), std::pair(std::string("synthetic"), &synthetic) }) {
+        std::cout << name << ", " << bounds->size() << " triangles\n";
+        double serial_ms = time_ms([&] { sink = sink + LinearBVH::build(*bounds).nodes.size(); });
+        std::cout << std::fixed << std::setprecision(2) << "  build():            " << serial_ms << " ms\n";
+        for (size_t threads : thread_counts) {
+            BVHBuildTimings timings;
+            double ms = time_ms([&] {
+                sink = sink + LinearBVH::build_parallel(*bounds, threads, SAHOptions(), &timings).nodes.size();
+                });
+            std::cout << "  " << std::setw(2) << threads << " threads:         " << ms << " ms ("
+                << serial_ms / ms << "x)\n    " << timings << "\n";
+        }
+    }
+    return 0;
+}
+
+// ./bench_renders morton_bvh [rays] [synthetic_side] [obj_file]
+int Benchmarks::morton_bvh(int argc, char* argv[]) {
+    size_t count = arg_or(argc, argv, 0, 200'000);
+    size_t side = arg_or(argc, argv, 1, 1000);
+    std::string teapot = argc > 2 ? argv[2] : "../tests/test_files/teapot.obj";
+    std::string synthetic = write_synthetic_obj(side);
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> unit(-1, 1);
+    for (const auto& path : { teapot, synthetic }) {
+        auto model = ObjParser::parse_obj_mesh(path.c_str());
+        size_t faces = 0;
+        for (const auto& child : model->shapes) {
+            if (auto mesh = dynamic_cast<const TriangleMesh*>(child.get())) {
+                faces += mesh->face_count();
+            }
+        }
+        BoundingBox bb = model->bounds_of();
+        Point center = bb.centroid();
+        double radius = Vector(bb.max - bb.min).magnitude();
+        std::vector<Ray> rays;
+        for (size_t i = 0; i < count; i++) {
+            Point origin = center + Vector(unit(rng), unit(rng), unit(rng)).normalized() * radius;
+            rays.emplace_back(origin, center + Vector(unit(rng), unit(rng), unit(rng)) * (radius / 4) - origin);
+        }
+
+        std::cout << path << ", " << faces << " triangles\n";
+        for (BVHMethod method : { BVHMethod::SAH, BVHMethod::Morton }) {
+            SAHOptions options;
+            options.method = method;
+            // Mesh rebuilds, packets included, as an animated mesh would do per frame
+            double build_ms = time_ms([&] {
+                for (auto& child : model->shapes) {
+                    child->divide_sah(options);
+                }
+                });
+            size_t hits = 0;
+            double trace_ms = time_ms([&] {
+                for (const Ray& r : rays) {
+                    hits += model->intersect_closest(r).has_value();
+                }
+                });
+            std::string name = method == BVHMethod::SAH ? "SAH" : "Morton";
+            std::cout << std::fixed << std::setprecision(2) << name << " built in " << build_ms << " ms, "
+                << hits << " hits\n";
+            report(name + " closest hits", trace_ms, count);
+        }
+    }
+    std::filesystem::remove(synthetic);
+    return 0;
+}
+
+// Defined in test_scenes.cpp
+Canvas shadow_puppets_scene();
+Canvas reflection_and_refraction_scene();
+Canvas glass_air_bubble_exact_scene();
+Canvas glass_air_cube_scene();
+Canvas reflection_and_refraction_cube_scene();
+Canvas cylinder_scene();
+Canvas cone_scene();
+Canvas group_scene();
+Canvas mesh_scene();
+
+// ./bench_renders scenes [scene...], then ./bench_renders_float scenes
+// Each run saves scene_<precision>.ppm and compares it with the other
+// precision's image when that exists
+int Benchmarks::scenes(int argc, char* argv[]) {
+    static const std::map<std::string, std::function<Canvas()>> all_scenes = {
+        { "shadow_puppets", shadow_puppets_scene },
+        { "reflection_and_refraction", reflection_and_refraction_scene },
+        { "glass_air_bubble", glass_air_bubble_exact_scene },
+        { "glass_air_cube", glass_air_cube_scene },
+        { "reflection_and_refraction_cube", reflection_and_refraction_cube_scene },
+        { "cylinder", cylinder_scene },
+        { "cone", cone_scene },
+        { "group", group_scene },
+        { "mesh", mesh_scene },
+    };
+    std::vector<std::string> names;
+    for (int i = 0; i < argc; i++) {
+        names.push_back(argv[i]);
+    }
+    if (names.empty()) {
+        for (const auto& [name, scene] : all_scenes) {
+            names.push_back(name);
+        }
+    }
+
+    constexpr bool single = sizeof(real) == sizeof(float);
+    const std::string precision = single ? "float" : "double";
+    const std::string other = single ? "double" : "float";
+    std::cout << "Rendering in " << precision << "\n";
+    for (const auto& name : names) {
+        auto it = all_scenes.find(name);
+        if (it == all_scenes.end()) {
+            std::cerr << "Unknown scene: " << name << "\n";
+            return 1;
+        }
+        std::optional<Canvas> canvas;
+        double ms = time_ms([&] { canvas = it->second(); });
+        size_t pixels = canvas->get_width() * canvas->get_height();
+        report(name, ms, pixels);
+
+        std::string path = "scene_" + name + "_" + precision + ".ppm";
+        if (!canvas->save_ppm(path)) {
+            std::cerr << "Failed to write " << path << "\n";
+            return 1;
+        }
+        auto theirs = read_p6("scene_" + name + "_" + other + ".ppm", canvas->get_width(), canvas->get_height());
+        if (!theirs.empty()) {
+            std::vector<uint8_t> ours(3 * pixels);
+            auto colors = canvas->get_pixels();
+            Canvas::to_rgb8(colors.data(), pixels, ours.data());
+            size_t differing = 0;
+            int max_delta = 0;
+            for (size_t i = 0; i < pixels; i++) {
+                int delta = 0;
+                for (int c = 0; c < 3; c++) {
+                    delta = std::max(delta, std::abs(ours[3 * i + c] - theirs[3 * i + c]));
+                }
+                differing += delta > 0;
+                max_delta = std::max(max_delta, delta);
+            }
+            std::cout << "  vs " << other << ": " << differing << " of " << pixels
+                << " pixels differ, by at most " << max_delta << "/255\n";
+        }
+    }
+    return 0;
+}
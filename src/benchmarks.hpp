@@ -0,0 +1,52 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+
+// Microbenchmarks, run through bench_renders: `./bench_renders <name> [args]`
+// With no name, bench_renders renders its default scene instead
+namespace Benchmarks {
+    int run(const std::string& name, int argc, char* argv[]);
+
+    // Wall-clock time of f() in milliseconds
+    template <typename F>
+    double time_ms(F&& f) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    }
+
+    // Closed-form Matrix4 inverse vs the book's cofactor expansion
+    int matrix_inverse(int argc, char* argv[]);
+    // Heap allocations per primary ray (global operator new is counted)
+    int allocations(int argc, char* argv[]);
+    // OBJ load throughput: line-based parser vs the memory-mapped one
+    int obj_load(int argc, char* argv[]);
+    // SoA triangle packet kernels at each SIMD level, then mesh closest hits
+    int triangle_packets(int argc, char* argv[]);
+    // Closest-hit traversal of the binary LinearBVH vs the 4-wide WideBVH
+    int bvh_traversal(int argc, char* argv[]);
+    // World queries through Group's virtual calls vs the CompiledScene
+    int compiled_scene(int argc, char* argv[]);
+    // Closest hits among many top-level objects: scanning World::objects vs
+    // its top-level BVH
+    int world_objects(int argc, char* argv[]);
+    // World-space conversions of a deeply nested shape: walking the parent
+    // chain per call vs the cached composed matrix
+    int world_transforms(int argc, char* argv[]);
+    // Closest hits in nested transformed groups of triangles, before and
+    // after baking the transforms into the vertices
+    int bake_transforms(int argc, char* argv[]);
+    // Many placements of one OBJ model: a parsed copy per placement vs
+    // instances of a single shared prototype
+    int instances(int argc, char* argv[]);
+    // Serial vs parallel LinearBVH builds of the OBJ's faces and of a large
+    // synthetic mesh, with per-phase times, from 1 to max_threads threads
+    int bvh_build(int argc, char* argv[]);
+    // Mesh BVH rebuild time and closest-hit time, SAH vs Morton codes
+    int morton_bvh(int argc, char* argv[]);
+    // Times the test scenes and diffs them against the other precision's
+    // render (bench_renders vs bench_renders_float)
+    int scenes(int argc, char* argv[]);
+}
@@ -1,7 +1,51 @@
 #include "canvas.hpp"
 
 #include <cassert>
+#include <cerrno>
+#include <charconv>
+#include <fcntl.h>
 #include <iostream>
+#include <unistd.h>
+
+namespace {
+    // Target size of each write() when streaming
+    constexpr size_t CHUNK_BYTES = 1 << 20;
+
+    bool write_all(int fd, const char* data, size_t size) {
+        while (size > 0) {
+            ssize_t written = ::write(fd, data, size);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            data += written;
+            size -= written;
+        }
+        return true;
+    }
+
+    // One row of P3 pixel data, wrapped like the book's pixel_data_to_ppm
+    void append_p3_row(std::string& out, const uint8_t* rgb, size_t width) {
+        int chars_added = 0;
+        for (size_t i = 0; i < width; i++) {
+            char ppm_color[12];
+            char* end = ppm_color;
+            for (int channel = 0; channel < 3; channel++) {
+                end = std::to_chars(end, ppm_color + sizeof(ppm_color), rgb[3 * i + channel]).ptr;
+                *end++ = ' ';
+            }
+            chars_added += end - ppm_color;
+            if (chars_added > 70) {
+                out += '\n';
+                chars_added = 0;
+            }
+            out.append(ppm_color, end);
+        }
+        out += '\n';
+    }
+}
 
 int Canvas::coords_to_index(size_t x, size_t y) const {
     assert(x < width && x >= 0 && "invald pixel 'x' index");
@@ -23,26 +67,59 @@ std::string Canvas::to_ppm_header() {
 
 std::string Canvas::pixel_data_to_ppm() {
     std::string ppm;
-    for (int j = 0; j < height; j++) {
-        int chars_added = 0;
-        for (int i = 0; i < width; i++) {
-            Color c = pixels[coords_to_index(i, j)];
-            int r_final = std::clamp<int>(c.r * 255, 0, 255);
-            int g_final = std::clamp<int>(c.g * 255, 0, 255);
-            int b_final = std::clamp<int>(c.b * 255, 0, 255);
-
-            std::string ppm_color =
-                std::format("{} {} {} ", r_final, g_final, b_final);
-            chars_added += ppm_color.size();
-            if (chars_added > 70) {
-                ppm += "\n";
-                chars_added = 0;
+    std::vector<uint8_t> rgb(3 * width);
+    for (size_t j = 0; j < height; j++) {
+        to_rgb8(&pixels[j * width], width, rgb.data());
+        append_p3_row(ppm, rgb.data(), width);
+    }
+    return ppm;
+}
+
+std::string Canvas::to_ppm() { return to_ppm_header() + pixel_data_to_ppm(); }
+
+void Canvas::to_rgb8(const Color* colors, size_t count, uint8_t* out) {
+    // max(0, v) comes first so NaN maps to 0; truncation matches the book's
+    // clamp<int>(c * 255, 0, 255)
+    auto channel = [](double c) {
+        return static_cast<uint8_t>(std::min(255.0, std::max(0.0, c * 255)));
+        };
+    for (size_t i = 0; i < count; i++) {
+        out[3 * i] = channel(colors[i].r);
+        out[3 * i + 1] = channel(colors[i].g);
+        out[3 * i + 2] = channel(colors[i].b);
+    }
+}
+
+bool Canvas::write_ppm(int fd, PPMFormat format) const {
+    std::string chunk = std::format("{}\n{} {}\n255\n",
+        format == PPMFormat::P6 ? "P6" : "P3", width, height);
+    chunk.reserve(CHUNK_BYTES + 16 * width);
+
+    std::vector<uint8_t> rgb(3 * width);
+    for (size_t j = 0; j < height; j++) {
+        to_rgb8(&pixels[j * width], width, rgb.data());
+        if (format == PPMFormat::P6) {
+            chunk.append(reinterpret_cast<const char*>(rgb.data()), rgb.size());
+        }
+        else {
+            append_p3_row(chunk, rgb.data(), width);
+        }
+
+        if (chunk.size() >= CHUNK_BYTES) {
+            if (!write_all(fd, chunk.data(), chunk.size())) {
+                return false;
             }
-            ppm += ppm_color;
+            chunk.clear();
         }
-        ppm += "\n";
     }
-    return ppm;
+    return write_all(fd, chunk.data(), chunk.size());
 }
 
-std::string Canvas::to_ppm() { return to_ppm_header() + pixel_data_to_ppm(); }
\ No newline at end of file
+bool Canvas::save_ppm(const std::string& path, PPMFormat format) const {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = write_ppm(fd, format);
+    return ::close(fd) == 0 && ok;
+}
\ No newline at end of file
@@ -1,9 +1,16 @@
 #pragma once
 
+#include <cstdint>
+#include <string>
 #include <vector>
 
 #include "math/color.hpp"
 
+enum class PPMFormat {
+    P3, // ASCII, what the book (and tests) use
+    P6, // binary, a third the size and far cheaper to write
+};
+
 struct Canvas {
    private:
     size_t width;
@@ -26,4 +33,13 @@ struct Canvas {
     std::string to_ppm_header();
     std::string pixel_data_to_ppm();
     std::string to_ppm();
+
+    // Streams the image to fd in chunks of rows rather than building it as
+    // one string. Returns false if a write fails
+    bool write_ppm(int fd, PPMFormat format = PPMFormat::P6) const;
+    bool save_ppm(const std::string& path, PPMFormat format = PPMFormat::P6) const;
+
+    // Clamped 8-bit RGB for count pixels (3 * count bytes); branchless so
+    // the compiler can vectorize it
+    static void to_rgb8(const Color* colors, size_t count, uint8_t* out);
 };
\ No newline at end of file
@@ -1,31 +1,43 @@
 #pragma once
 
+#include <cstdint>
+
 #include "ray.hpp"
+#include "small_buffer.hpp"
 // #include "shapes.hpp"
 
 struct Shape;
+struct Material;
 
 struct Intersection {
-    double t;
+    real t;
     const Shape* object;  // const
-    double u; // TODO: consider making these optional
-    double v;
+    real u; // TODO: consider making these optional
+    real v;
+    uint32_t face = 0; // which triangle of a TriangleMesh was hit
+    const Shape* leaf = nullptr; // shape hit inside an Instance's prototype, object is then the Instance
     Intersection() {}
-    Intersection(double t, const Shape* object) : t(t), object(object) {}
+    Intersection(real t, const Shape* object) : t(t), object(object) {}
     // TODO: u,v should only be used with triangles, move construction to cpp and make Triangle*
-    Intersection(double t, const Shape* tri, double u, double v) :
+    Intersection(real t, const Shape* tri, real u, real v) :
         t(t), object(tri), u(u), v(v) {
     }
+    Intersection(real t, const Shape* mesh, real u, real v, uint32_t face) :
+        t(t), object(mesh), u(u), v(v), face(face) {
+    }
 
     bool operator==(const Intersection& other) const {
-        return t == other.t && object == other.object;
+        return t == other.t && object == other.object && leaf == other.leaf;
     }
 };
 
+// Enough for any single primitive and most primary rays through a group
+using IntersectionBuffer = SmallBuffer<Intersection, 8>;
+
 // TODO: Dont love this structure
 struct IntersectionRecord {
     size_t count;
-    std::vector<Intersection> intersections;
+    IntersectionBuffer intersections;
 
     IntersectionRecord() : count(0) {}
 
@@ -41,19 +53,33 @@ struct IntersectionRecord {
 
     std::optional<Intersection> hit() const;
 
-    // TODO: Can use move rather than copy for greater efficiency
     void append_record(const IntersectionRecord& other) {
         count += other.count;
-        for (auto& intersection : other.intersections) {
-            intersections.push_back(intersection);
-        }
+        intersections.append(other.intersections.data(), other.intersections.size());
         assert(intersections.size() == count);
     }
+
+    // Takes over other's spilled storage when this record is still empty
+    void append_record(IntersectionRecord&& other) {
+        if (intersections.empty()) {
+            count = other.count;
+            intersections = std::move(other.intersections);
+            other.count = 0;
+            return;
+        }
+        append_record(other);
+    }
+
+    void append_record(const Intersection& intersection) {
+        count++;
+        intersections.push_back(intersection);
+    }
 };
 
 struct PrecomputedIntersection {
-    double t;
+    real t;
     const Shape* object;
+    const Material* material; // object->material_at() for the hit
     Point point;
     Vector eye;
     Vector normal;
@@ -62,8 +88,8 @@ struct PrecomputedIntersection {
     Vector reflect_dir;
 
     // refraction
-    double n1;
-    double n2;
+    real n1;
+    real n2;
     Point under_point; // origin of refracted rays under surface
 
     PrecomputedIntersection() {}
@@ -73,5 +99,5 @@ struct PrecomputedIntersection {
 
 // TODO: rename
 namespace Refraction {
-    double schlick(PrecomputedIntersection comps);
+    real schlick(PrecomputedIntersection comps);
 }
\ No newline at end of file
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <cassert>
+#include <cmath>
+#include <cstdint>
 #include <iostream>
 #include <vector>
 
@@ -9,15 +11,39 @@
 struct Ray {
     Point origin;
     Vector dir;
+    // Precomputed once per ray (and per object space it is transformed into)
+    // so box and slab tests multiply instead of divide. Infinite on axes the
+    // ray is parallel to
+    Vector inv_dir;
+    // 1 where the direction is negative: index of the near plane in {min, max}
+    uint8_t sign[3];
+    // Parametric interval traversal is limited to. t is preserved by
+    // transform(), as dir is transformed unnormalized
+    real tmin = -INFINITY;
+    real tmax = INFINITY;
 
     // TODO: unclear if within textbook structure
     // std::vector<Intersection> intersections;
 
     // TODO: i typically expect dir to be normalized, but maybe there are exceptions
     // YEP THERE ARE: why do i not expect this to always be normalized, is it because it is sometimes transformed to a diff space?
-    Ray(Point origin, Vector dir) : origin(origin), dir(dir) {}
+    Ray(Point origin, Vector dir, real tmin = -INFINITY, real tmax = INFINITY)
+        : origin(origin), dir(dir), inv_dir(1 / dir.x, 1 / dir.y, 1 / dir.z), tmin(tmin), tmax(tmax) {
+        // Compares inv_dir so -0 directions count as negative, like their -inf
+        sign[0] = inv_dir.x < 0;
+        sign[1] = inv_dir.y < 0;
+        sign[2] = inv_dir.z < 0;
+    }
 
-    Point position(double t) { return origin + dir * t; }
+    Point position(real t) { return origin + dir * t; }
 
-    Ray transform(Transform m) const { return Ray(m * origin, m * dir); }
-};
\ No newline at end of file
+    Ray transform(const Matrix4& m) const { return Ray(m * origin, m * dir, tmin, tmax); }
+
+    // Same ray limited to [tmin, tmax]; keeps the precomputed data
+    Ray clipped(real new_tmin, real new_tmax) const {
+        Ray r = *this;
+        r.tmin = new_tmin;
+        r.tmax = new_tmax;
+        return r;
+    }
+};
@@ -7,5 +7,7 @@
 #include "cone.hpp"
 #include "group.hpp"
 #include "triangle.hpp"
+#include "triangle_mesh.hpp"
+#include "instance.hpp"
 
 // Umbrella header for scene descriptions (TODO: make factory in the future w/ YAML scene description)
\ No newline at end of file
@@ -1,20 +1,41 @@
 #pragma once
 
-#include "shapes.hpp"
+#include "cylinder.hpp"
+
+// Up to 4 hits (caps first, then sides) with the double cone x^2 + z^2 = y^2
+// truncated to (minimum, maximum). Shared by Cone and CompiledScene
+inline int intersect_cone(const Ray& r, real minimum, real maximum, bool closed, real t[4]) {
+    auto a = pow(r.dir.x, 2) - pow(r.dir.y, 2) + pow(r.dir.z, 2);
+    auto b = 2 * r.origin.x * r.dir.x - 2 * r.origin.y * r.dir.y + 2 * r.origin.z * r.dir.z;
+    auto c = pow(r.origin.x, 2) - pow(r.origin.y, 2) + pow(r.origin.z, 2);
+
+    int count = closed ? intersect_caps(r, minimum, maximum, minimum, maximum, t) : 0;
+
+    if (double_equal(a, 0) && double_equal(b, 0)) { // TODO: what is this condition?
+        return count;
+    }
+
+    if (double_equal(a, 0)) { // parallel to one cone
+        real t0 = -c / (2 * b);
+        real y0 = r.origin.y + t0 * r.dir.y;
+        if (minimum < y0 && y0 < maximum) {
+            t[count++] = t0;
+        }
+        return count;
+    }
+    return count + truncated_roots(r, a, b, c, minimum, maximum, t + count);
+}
 
 struct Cone : public Shape {
-    double minimum;
-    double maximum;
+    real minimum;
+    real maximum;
     bool closed;
 
-    Cone() : minimum(std::numeric_limits<double>::lowest()), maximum(std::numeric_limits<double>::max()), closed(false) {}
+    Cone() : minimum(std::numeric_limits<real>::lowest()), maximum(std::numeric_limits<real>::max()), closed(false) {}
 
     BoundingBox bounds_of() const override;
 
 private:
     Vector local_normal_at(const Point local_p, Intersection i) const override;
     IntersectionRecord local_intersect(const Ray local_r) const override;
-
-    bool check_cap(Ray r, double t, double plane_y) const;
-    void intersect_caps(Ray r, IntersectionRecord& xs) const;
 };
\ No newline at end of file
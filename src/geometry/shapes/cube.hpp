@@ -2,6 +2,26 @@
 
 #include "shapes.hpp"
 
+// Identify where ray intersects planes offset by 1 from axis. The ray's sign
+// picks the near plane, and a parallel ray's infinite inv_dir sends both
+// planes to infinity
+inline std::pair<real, real> cube_check_axis(real origin, real inv_dir, uint8_t sign) {
+    real near = sign ? 1 : -1;
+    return std::make_pair((near - origin) * inv_dir, (-near - origin) * inv_dir);
+}
+
+// Entry and exit t of the axis-aligned cube [-1, 1]^3. Shared by Cube and
+// CompiledScene
+inline bool intersect_cube(const Ray& r, real& tmin, real& tmax) {
+    auto const [xtmin, xtmax] = cube_check_axis(r.origin.x, r.inv_dir.x, r.sign[0]);
+    auto const [ytmin, ytmax] = cube_check_axis(r.origin.y, r.inv_dir.y, r.sign[1]);
+    auto const [ztmin, ztmax] = cube_check_axis(r.origin.z, r.inv_dir.z, r.sign[2]);
+
+    tmin = std::max({ xtmin, ytmin, ztmin });
+    tmax = std::min({ xtmax, ytmax, ztmax });
+    return tmin <= tmax;
+}
+
 struct Cube : public Shape {
     BoundingBox bounds_of() const override {
         return BoundingBox(Point(-1, -1, -1), Point(1, 1, 1));
@@ -9,5 +29,4 @@ struct Cube : public Shape {
 private:
     Vector local_normal_at(const Point local_p, Intersection i) const override;
     IntersectionRecord local_intersect(const Ray local_r) const override;
-    std::pair<double, double> check_axis(double origin, double direction) const;
-};
\ No newline at end of file
+};
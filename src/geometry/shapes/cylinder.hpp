@@ -2,9 +2,73 @@
 
 #include "shapes.hpp"
 
+// Does the ray cross the plane at `t` within `radius` of the y axis
+inline bool check_cap(const Ray& r, real t, real radius) {
+    auto x = r.origin.x + t * r.dir.x;
+    auto z = r.origin.z + t * r.dir.z;
+    return (pow(x, 2) + pow(z, 2)) <= pow(radius, 2);
+}
+
+// Appends the t of each end cap (radius given per cap) the ray crosses
+inline int intersect_caps(const Ray& r, real minimum, real maximum, real min_radius,
+    real max_radius, real* t) {
+    if (double_equal(r.dir.y, 0)) {
+        return 0;
+    }
+    int count = 0;
+    real t_min = (minimum - r.origin.y) * r.inv_dir.y;
+    if (check_cap(r, t_min, min_radius)) {
+        t[count++] = t_min;
+    }
+    real t_max = (maximum - r.origin.y) * r.inv_dir.y;
+    if (check_cap(r, t_max, max_radius)) {
+        t[count++] = t_max;
+    }
+    return count;
+}
+
+// Appends the roots t0 <= t1 of a side's quadratic whose hit lies strictly
+// between minimum and maximum
+inline int truncated_roots(const Ray& r, real a, real b, real c, real minimum,
+    real maximum, real* t) {
+    auto discriminant = pow(b, 2) - 4 * a * c;
+    if (discriminant < 0) return 0; // ray doesn't intersect edges
+
+    auto t0 = (-b - sqrt(discriminant)) / (2 * a);
+    auto t1 = (-b + sqrt(discriminant)) / (2 * a);
+    if (t0 > t1) { // TODO: what's the purpose of this????
+        std::swap(t0, t1);
+    }
+
+    // Intersection between min and max values
+    int count = 0;
+    auto y0 = r.origin.y + t0 * r.dir.y;
+    if (minimum < y0 && y0 < maximum) {
+        t[count++] = t0;
+    }
+    auto y1 = r.origin.y + t1 * r.dir.y;
+    if (minimum < y1 && y1 < maximum) {
+        t[count++] = t1;
+    }
+    return count;
+}
+
+// Up to 4 hits (caps first, then sides) with the unit cylinder truncated to
+// (minimum, maximum). Shared by Cylinder and CompiledScene
+inline int intersect_cylinder(const Ray& r, real minimum, real maximum, bool closed, real t[4]) {
+    int count = closed ? intersect_caps(r, minimum, maximum, 1, 1, t) : 0;
+
+    real a = pow(r.dir.x, 2) + pow(r.dir.z, 2);
+    if (double_equal(a, 0)) return count; // ray parallel to y-axis
+
+    auto b = 2 * r.origin.x * r.dir.x + 2 * r.origin.z * r.dir.z;
+    auto c = pow(r.origin.x, 2) + pow(r.origin.z, 2) - 1;
+    return count + truncated_roots(r, a, b, c, minimum, maximum, t + count);
+}
+
 struct Cylinder : public Shape {
-    double minimum;
-    double maximum;
+    real minimum;
+    real maximum;
     bool closed;
 
     Cylinder() : minimum(MIN_DOUBLE), maximum(MAX_DOUBLE), closed(false) {}
@@ -16,7 +80,4 @@ struct Cylinder : public Shape {
 private:
     Vector local_normal_at(const Point local_p, Intersection i) const override;
     IntersectionRecord local_intersect(const Ray local_r) const override;
-
-    bool check_cap(Ray r, double t) const;
-    void intersect_caps(Ray r, IntersectionRecord& xs) const;
-};
\ No newline at end of file
+};
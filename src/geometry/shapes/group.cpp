@@ -1,6 +1,8 @@
 #include "group.hpp"
 #include "shapes.hpp"
 
+#include <algorithm>
+
 BoundingBox Group::bounds_of() const {
     if (bb_is_valid) { // cache group bb
         return bb;
@@ -22,12 +24,24 @@ Vector Group::local_normal_at(const Point local_p, Intersection i) const {
 
 IntersectionRecord Group::local_intersect(const Ray local_r) const {
     IntersectionRecord xs;
-    if (!bounds_of().intersects(local_r)) {
-        return IntersectionRecord();
+    if (!bvh.empty()) {
+        // All hits are needed (refraction), so no pruning within the interval
+        bvh.traverse(local_r,
+            [&](const uint32_t* prims, uint32_t count, real tmax) {
+                for (uint32_t i = 0; i < count; i++) {
+                    xs.append_record(bvh_primitives[prims[i]]->intersect(local_r));
+                }
+                return tmax;
+            });
     }
+    else {
+        if (!bounds_of().intersects(local_r)) {
+            return IntersectionRecord();
+        }
 
-    for (const auto& shape : shapes) {
-        xs.append_record(shape.get()->intersect(local_r));
+        for (const auto& shape : shapes) {
+            xs.append_record(shape.get()->intersect(local_r));
+        }
     }
     std::sort(xs.intersections.begin(), xs.intersections.end(), [](Intersection a, Intersection b) {
         return a.t < b.t;
@@ -35,6 +49,71 @@ IntersectionRecord Group::local_intersect(const Ray local_r) const {
     return xs;
 }
 
+bool Group::local_occluded(const Ray local_r, real tmax) const {
+    if (!bvh.empty()) {
+        bool hit = false;
+        bvh.traverse(local_r.clipped(0, tmax),
+            [&](const uint32_t* prims, uint32_t count, real limit) {
+                for (uint32_t i = 0; i < count && !hit; i++) {
+                    hit = bvh_primitives[prims[i]]->occluded(local_r, limit);
+                }
+                return hit ? -INFINITY : limit; // culls everything left on the stack
+            });
+        return hit;
+    }
+
+    if (!bounds_of().intersects(local_r.clipped(0, tmax))) {
+        return false;
+    }
+    for (const auto& shape : shapes) {
+        if (shape.get()->occluded(local_r, tmax)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::optional<Intersection> Group::local_intersect_closest(const Ray local_r, real tmax) const {
+    std::optional<Intersection> closest;
+    if (!bvh.empty()) {
+        bvh.traverse(local_r.clipped(0, tmax),
+            [&](const uint32_t* prims, uint32_t count, real limit) {
+                for (uint32_t i = 0; i < count; i++) {
+                    if (auto hit = bvh_primitives[prims[i]]->intersect_closest(local_r, limit)) {
+                        closest = hit;
+                        limit = hit->t;
+                    }
+                }
+                return limit;
+            });
+        return closest;
+    }
+
+    if (!bounds_of().intersects(local_r.clipped(0, tmax))) {
+        return std::nullopt;
+    }
+    for (const auto& shape : shapes) {
+        if (auto hit = shape.get()->intersect_closest(local_r, tmax)) {
+            closest = hit;
+            tmax = hit->t;
+        }
+    }
+    return closest;
+}
+
+std::unique_ptr<Shape> Group::remove_child(const Shape* child) {
+    auto it = std::find_if(shapes.begin(), shapes.end(),
+        [child](const auto& shape) { return shape.get() == child; });
+    if (it == shapes.end()) {
+        return nullptr;
+    }
+    std::unique_ptr<Shape> removed = std::move(*it);
+    shapes.erase(it);
+    removed->parent.reset();
+    children_changed();
+    return removed;
+}
+
 std::pair<std::vector<std::unique_ptr<Shape>>, std::vector<std::unique_ptr<Shape>>> Group::partition_children() {
     auto [left_bb, right_bb] = bounds_of().split_bounds();
     std::vector<std::unique_ptr<Shape>> left_group;
@@ -51,6 +130,7 @@ std::pair<std::vector<std::unique_ptr<Shape>>, std::vector<std::unique_ptr<Shape
     }
     // Cleanup original group
     std::erase_if(shapes, [](auto const& shape) { return !shape;});
+    children_changed();
     return { std::move(left_group), std::move(right_group) };
 }
 
@@ -69,4 +149,122 @@ void Group::divide(int min_children) {
     for (auto& shape : shapes) {
         shape.get()->divide(min_children);
     }
-}
\ No newline at end of file
+}
+
+void Group::add_partition(std::vector<std::unique_ptr<Shape>>& partition) {
+    if (partition.size() == 1) {
+        add_child(std::move(partition.front()));
+    }
+    else if (!partition.empty()) {
+        make_subgroup(partition);
+    }
+}
+
+void Group::divide_sah(const SAHOptions& options) {
+    if (shapes.size() > options.max_leaf_size) {
+        std::vector<BVHPrimitive> prims;
+        prims.reserve(shapes.size());
+        for (size_t i = 0; i < shapes.size(); i++) {
+            prims.emplace_back(shapes[i].get()->parent_space_bounds_of(), i);
+        }
+
+        if (auto mid = sah_partition(prims, 0, prims.size(), options)) {
+            std::vector<std::unique_ptr<Shape>> left;
+            std::vector<std::unique_ptr<Shape>> right;
+            for (size_t i = 0; i < prims.size(); i++) {
+                auto& side = i < *mid ? left : right;
+                side.push_back(std::move(shapes[prims[i].index]));
+            }
+            shapes.clear();
+            add_partition(left);
+            add_partition(right);
+        }
+    }
+
+    for (auto& shape : shapes) {
+        shape.get()->divide_sah(options);
+    }
+}
+
+// Cost of a ray that hits this group's bounds: one traversal step plus each
+// child weighted by the chance (surface area ratio) that the ray also hits it
+double Group::sah_cost(const SAHOptions& options, size_t depth, BVHReport& report) const {
+    report.depth = std::max(report.depth, depth);
+    report.interior_nodes++;
+
+    bool has_primitives = false;
+    double area = bounds_of().surface_area();
+    double cost = options.traversal_cost;
+    for (const auto& shape : shapes) {
+        double probability = 1;
+        double child_area = shape.get()->parent_space_bounds_of().surface_area();
+        if (std::isfinite(area) && area > 0 && std::isfinite(child_area)) {
+            probability = child_area / area;
+        }
+
+        if (auto child = dynamic_cast<const Group*>(shape.get())) {
+            cost += probability * child->sah_cost(options, depth + 1, report);
+        }
+        else {
+            has_primitives = true;
+            report.primitives++;
+            cost += probability * options.intersection_cost;
+        }
+    }
+    if (has_primitives) {
+        report.interior_nodes--;
+        report.leaves++;
+    }
+    return cost;
+}
+
+BVHReport Group::bvh_report(const SAHOptions& options) const {
+    BVHReport report;
+    report.sah_cost = sah_cost(options, 1, report);
+    return report;
+}
+
+void Group::collect_bvh_primitives(std::vector<const Shape*>& primitives,
+    std::vector<BoundingBox>& bounds, const SAHOptions& options) {
+    for (auto& shape : shapes) {
+        auto child = dynamic_cast<Group*>(shape.get());
+        if (child && child->transform.is_identity()) {
+            child->clear_bvh();
+            child->collect_bvh_primitives(primitives, bounds, options);
+            continue;
+        }
+        if (child) {
+            child->build_bvh(options);
+        }
+        primitives.push_back(shape.get());
+        bounds.push_back(shape.get()->parent_space_bounds_of());
+    }
+}
+
+void Group::build_bvh(const SAHOptions& options) {
+    clear_bvh();
+    std::vector<BoundingBox> bounds;
+    collect_bvh_primitives(bvh_primitives, bounds, options);
+    bvh = WideBVH::collapse(LinearBVH::build_parallel(bounds, options.num_threads, options));
+}
+
+void Group::bake_transform() {
+    if (!transform.is_identity()) {
+        for (auto& shape : shapes) {
+            shape.get()->transform = transform * shape.get()->transform;
+        }
+        transform = Transform();
+    }
+    bake_child_transforms();
+}
+
+void Group::bake_child_transforms() {
+    bool had_bvh = !bvh.empty();
+    for (auto& shape : shapes) {
+        shape.get()->bake_transform();
+    }
+    children_changed();
+    if (had_bvh) {
+        build_bvh();
+    }
+}
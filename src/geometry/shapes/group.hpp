@@ -37,9 +37,14 @@ struct Group : public Shape {
         shape.get()->parent = this;
         // shapes.emplace(std::move(shape));
         shapes.push_back(std::move(shape));
-        invalidate_bb();
+        children_changed();
     }
 
+    // Detaches and returns child, or nullptr if it isn't one of shapes. Like
+    // adding, this drops the BVHs of this group and its ancestors; edit
+    // shapes through these rather than directly
+    std::unique_ptr<Shape> remove_child(const Shape* child);
+
     // Note: definitely overcomplicated, but still a fun experiment
     // Could also require at least one shape inputted
     template<typename... ShapePtrs>
@@ -49,7 +54,7 @@ struct Group : public Shape {
     > && ...) { // rvalue reference
         ((shape.get()->parent = this), ...);
         (shapes.push_back(std::move(shape)), ...);
-        invalidate_bb();
+        children_changed();
     }
 
     BoundingBox bounds_of() const override;
@@ -66,15 +71,59 @@ struct Group : public Shape {
     }
 
     void divide(int min_children) override;
+    // Binned SAH BVH over the children; unlike divide(), no child is left
+    // behind at this level because it straddles a split plane
+    void divide_sah(const SAHOptions& options = SAHOptions()) override;
+
+    BVHReport bvh_report(const SAHOptions& options = SAHOptions()) const;
+
+    // Compiles the hierarchy into a WideBVH that local_intersect() then
+    // uses. Subgroups without a transform are flattened into it, transformed
+    // ones stay single primitives (with their own BVH). Rebuild after
+    // changing any transform below this group; adding or removing children
+    // here or in any group below drops it. Large builds run on
+    // options.num_threads threads
+    void build_bvh(const SAHOptions& options = SAHOptions());
+    void clear_bvh() {
+        bvh = WideBVH();
+        bvh_primitives.clear();
+    }
+    const WideBVH& wide_bvh() const { return bvh; }
+
+    // Pushes the group's transform onto its children, then bakes them
+    void bake_transform() override;
+    // Bakes every transform below this group into the leaves, so it ends up
+    // with untransformed subgroups (flattened into its BVH) and, where the
+    // leaves allow it, untransformed triangles. The group's own transform
+    // stays. A BVH the group had is rebuilt with default options
+    void bake_child_transforms();
 
 private:
     // Cached bounding box
     mutable BoundingBox bb;
-    mutable bool bb_is_valid;
+    mutable bool bb_is_valid = false;
+
+    WideBVH bvh;
+    std::vector<const Shape*> bvh_primitives; // indexed by bvh.indices
 
     Vector local_normal_at(const Point local_p, Intersection i) const override;
     IntersectionRecord local_intersect(const Ray local_r) const override;
+    bool local_occluded(const Ray local_r, real tmax) const override;
+    std::optional<Intersection> local_intersect_closest(const Ray local_r, real tmax) const override;
     void invalidate_bb() const {
         bb_is_valid = false;
     }
+    // Drops the cached bounds and BVH here and in every ancestor, whose
+    // bounds contain this group's and whose BVH may have flattened it
+    void children_changed() {
+        for (Group* g = this; g; g = g->parent.value_or(nullptr)) {
+            g->invalidate_bb();
+            g->clear_bvh();
+        }
+    }
+    // Wraps multiple shapes in a subgroup, a single shape is added directly
+    void add_partition(std::vector<std::unique_ptr<Shape>>& partition);
+    double sah_cost(const SAHOptions& options, size_t depth, BVHReport& report) const;
+    void collect_bvh_primitives(std::vector<const Shape*>& primitives,
+        std::vector<BoundingBox>& bounds, const SAHOptions& options);
 };
\ No newline at end of file
@@ -0,0 +1,64 @@
+#include "instance.hpp"
+
+#include "group.hpp"
+
+namespace {
+    // An instance's hit has a single leaf slot, so there's no room for a
+    // second level of instancing inside the prototype
+    bool contains_instance(const Shape* shape) {
+        if (dynamic_cast<const Instance*>(shape)) {
+            return true;
+        }
+        if (auto group = dynamic_cast<const Group*>(shape)) {
+            for (const auto& child : group->shapes) {
+                if (contains_instance(child.get())) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+}
+
+Instance::Instance(std::shared_ptr<const Shape> prototype, Transform transform)
+    : Instance(prototype, transform, prototype->material) {
+    overrides_material = false;
+}
+
+Instance::Instance(std::shared_ptr<const Shape> prototype, Transform transform, Material material)
+    : Shape(transform, material), prototype(std::move(prototype)), overrides_material(true) {
+    assert(!this->prototype->parent.has_value() && "prototype must be a root shape");
+    assert(!contains_instance(this->prototype.get()) && "prototypes can't contain instances");
+}
+
+const Material& Instance::material_at(const Intersection& i) const {
+    return overrides_material || !i.leaf ? material : i.leaf->material_at(i);
+}
+
+// The prototype's world space is this instance's object space
+Vector Instance::local_normal_at(const Point local_p, Intersection i) const {
+    i.object = i.leaf;
+    return i.leaf->normal_at(local_p, i);
+}
+
+IntersectionRecord Instance::local_intersect(const Ray local_r) const {
+    IntersectionRecord xs = prototype->intersect(local_r);
+    for (auto& i : xs.intersections) {
+        i.leaf = i.object;
+        i.object = this;
+    }
+    return xs;
+}
+
+bool Instance::local_occluded(const Ray local_r, real tmax) const {
+    return prototype->occluded(local_r, tmax);
+}
+
+std::optional<Intersection> Instance::local_intersect_closest(const Ray local_r, real tmax) const {
+    auto hit = prototype->intersect_closest(local_r, tmax);
+    if (hit) {
+        hit->leaf = hit->object;
+        hit->object = this;
+    }
+    return hit;
+}
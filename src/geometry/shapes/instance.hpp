@@ -0,0 +1,37 @@
+#pragma once
+
+#include <memory>
+
+#include "shapes.hpp"
+
+// One placement of a prototype (typically a TriangleMesh, or a Group with its
+// BVH built) that any number of instances share, so a copy costs a transform
+// and a material rather than its own geometry. Rays are transformed into the
+// instance's space and traverse the prototype's own acceleration structure,
+// making scenes two-level: World's BVH over the instances, the prototypes'
+// below them.
+//
+// Hits report the instance as their object, so shading, patterns and
+// refraction see each placement as a shape of its own. The prototype's shape
+// that was hit rides along in Intersection::leaf for the normal and, unless
+// the instance overrides it, the material. Patterns are evaluated in the
+// instance's object space either way. The prototype must not be edited while
+// instanced, nor sit inside a group or contain instances itself
+struct Instance : public Shape {
+    std::shared_ptr<const Shape> prototype;
+    bool overrides_material;
+
+    // Shades each hit with the material of the prototype's shape that was hit
+    Instance(std::shared_ptr<const Shape> prototype, Transform transform = Transform());
+    // Shades every hit with material
+    Instance(std::shared_ptr<const Shape> prototype, Transform transform, Material material);
+
+    BoundingBox bounds_of() const override { return prototype->parent_space_bounds_of(); }
+    const Material& material_at(const Intersection& i) const override;
+
+private:
+    Vector local_normal_at(const Point local_p, Intersection i) const override;
+    IntersectionRecord local_intersect(const Ray local_r) const override;
+    bool local_occluded(const Ray local_r, real tmax) const override;
+    std::optional<Intersection> local_intersect_closest(const Ray local_r, real tmax) const override;
+};
@@ -0,0 +1,221 @@
+#include "mesh_cache.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+
+#include "../../mapped_file.hpp"
+
+namespace {
+    constexpr char MAGIC[8] = { 'R', 'T', 'C', 'M', 'E', 'S', 'H', '\0' };
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t mesh_count;
+        MeshCacheKey key;
+        uint64_t vertex_count;
+        uint64_t normal_count;
+        uint64_t scalar_size; // sizeof(real) of the build that wrote it
+    };
+
+    struct MeshEntry {
+        double bounds_min[3];
+        double bounds_max[3];
+        uint64_t index_count;
+        uint64_t normal_index_count; // 0 or index_count
+        uint64_t node_count;
+        uint64_t bvh_index_count;
+    };
+
+    static_assert(std::is_trivially_copyable_v<Point> && sizeof(Point) == 4 * sizeof(real));
+    static_assert(std::is_trivially_copyable_v<Vector> && sizeof(Vector) == 4 * sizeof(real));
+    static_assert(std::is_trivially_copyable_v<WideBVHNode>);
+
+    // Every array starts 8-byte aligned
+    size_t padding(size_t bytes) {
+        return (8 - bytes % 8) % 8;
+    }
+
+    template <typename T>
+    void write_array(std::ofstream& out, const std::vector<T>& items) {
+        size_t bytes = items.size() * sizeof(T);
+        out.write(reinterpret_cast<const char*>(items.data()), bytes);
+        static constexpr char zeros[8] = {};
+        out.write(zeros, padding(bytes));
+    }
+
+    // Bounds-checked reads from the mapped cache
+    struct Reader {
+        std::string_view bytes;
+        size_t pos = 0;
+
+        const char* take(size_t size) {
+            if (size > bytes.size() - pos) {
+                throw std::runtime_error("Truncated mesh cache\n");
+            }
+            const char* p = bytes.data() + pos;
+            pos += size;
+            return p;
+        }
+
+        template <typename T>
+        T value() {
+            T v;
+            std::memcpy(&v, take(sizeof(T)), sizeof(T));
+            return v;
+        }
+
+        // One allocation and copy per array, never per element
+        template <typename T>
+        std::vector<T> array(uint64_t count) {
+            if (count > bytes.size() / sizeof(T)) {
+                throw std::runtime_error("Corrupt mesh cache\n");
+            }
+            size_t size = count * sizeof(T);
+            const T* first = reinterpret_cast<const T*>(take(size));
+            take(padding(size));
+            return std::vector<T>(first, first + count);
+        }
+    };
+}
+
+MeshCacheKey MeshCacheKey::of(const char* source) {
+    MeshCacheKey key;
+    key.source_size = std::filesystem::file_size(source);
+    key.source_mtime = std::filesystem::last_write_time(source).time_since_epoch().count();
+    return key;
+}
+
+bool MeshCache::save(const std::string& path, const Group& model, const MeshCacheKey& key) {
+    std::vector<const TriangleMesh*> meshes;
+    for (const auto& shape : model.shapes) {
+        auto mesh = dynamic_cast<const TriangleMesh*>(shape.get());
+        if (!mesh || (!meshes.empty() && mesh->buffers != meshes[0]->buffers)) {
+            return false;
+        }
+        meshes.push_back(mesh);
+    }
+    if (meshes.empty()) {
+        return false;
+    }
+    const MeshBuffers& buffers = *meshes[0]->buffers;
+
+    std::string temp_path = path + ".tmp";
+    {
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        Header header = {};
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.mesh_count = static_cast<uint32_t>(meshes.size());
+        header.key = key;
+        header.vertex_count = buffers.vertices.size();
+        header.normal_count = buffers.normals.size();
+        header.scalar_size = sizeof(real);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        write_array(out, buffers.vertices);
+        write_array(out, buffers.normals);
+
+        for (const TriangleMesh* mesh : meshes) {
+            BoundingBox bb = mesh->bounds_of();
+            const WideBVH& bvh = mesh->wide_bvh();
+            MeshEntry entry = {
+                { bb.min.x, bb.min.y, bb.min.z }, { bb.max.x, bb.max.y, bb.max.z },
+                mesh->indices.size(), mesh->normal_indices.size(),
+                bvh.nodes.size(), bvh.indices.size() };
+            out.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+            write_array(out, mesh->indices);
+            write_array(out, mesh->normal_indices);
+            write_array(out, bvh.nodes);
+            write_array(out, bvh.indices);
+        }
+        if (!out.flush()) {
+            std::filesystem::remove(temp_path);
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temp_path, path, error);
+    return !error;
+}
+
+std::unique_ptr<Group> MeshCache::load(const std::string& path, const MeshCacheKey& key) {
+    if (!std::filesystem::exists(path)) {
+        return nullptr;
+    }
+    MappedFile file(path.c_str());
+    Reader in{ file.contents() };
+    if (in.bytes.size() < sizeof(Header)) {
+        return nullptr;
+    }
+    auto header = in.value<Header>();
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION ||
+        header.scalar_size != sizeof(real) || !(header.key == key)) {
+        return nullptr;
+    }
+
+    auto buffers = std::make_shared<MeshBuffers>();
+    buffers->vertices = in.array<Point>(header.vertex_count);
+    buffers->normals = in.array<Vector>(header.normal_count);
+
+    auto model = std::make_unique<Group>();
+    for (uint32_t m = 0; m < header.mesh_count; m++) {
+        auto entry = in.value<MeshEntry>();
+        auto indices = in.array<uint32_t>(entry.index_count);
+        auto normal_indices = in.array<uint32_t>(entry.normal_index_count);
+        WideBVH bvh;
+        bvh.nodes = in.array<WideBVHNode>(entry.node_count);
+        bvh.indices = in.array<uint32_t>(entry.bvh_index_count);
+
+        // Indices are trusted from here on, so check them once
+        bool valid = indices.size() % 3 == 0 &&
+            (normal_indices.empty() || normal_indices.size() == indices.size());
+        for (uint32_t i : indices) {
+            valid = valid && i < buffers->vertices.size();
+        }
+        for (uint32_t i : normal_indices) {
+            valid = valid && (i < buffers->normals.size() || i == TriangleMesh::NO_NORMAL);
+        }
+        for (uint32_t i : bvh.indices) {
+            valid = valid && i < indices.size() / 3;
+        }
+        // Leaves must start on a packet, children must come after their
+        // parent (so there are no cycles) and have no other parent (so depths
+        // are exact), unused slots must hold a box no ray enters and the tree
+        // must fit traverse()'s stack, as collapse() guarantees
+        constexpr uint32_t PACKET = TrianglePacket::WIDTH;
+        valid = valid && bvh.indices.size() % PACKET == 0;
+        std::vector<uint8_t> depth(bvh.nodes.size());
+        for (size_t n = 0; n < bvh.nodes.size() && valid; n++) {
+            const auto& node = bvh.nodes[n];
+            for (int slot = 0; slot < WideBVHNode::WIDTH && valid; slot++) {
+                uint32_t child = node.child[slot];
+                if (node.count[slot] > 0) {
+                    valid = child % PACKET == 0 && uint64_t(child) + node.count[slot] <= bvh.indices.size();
+                }
+                else if (child != 0) {
+                    valid = depth[n] < 64 && n < child && child < bvh.nodes.size() && depth[child] == 0;
+                    if (valid) {
+                        depth[child] = depth[n] + 1;
+                    }
+                }
+                else {
+                    for (int axis = 0; axis < 3; axis++) {
+                        valid = valid && node.min[axis][slot] > node.max[axis][slot];
+                    }
+                }
+            }
+        }
+        if (!valid) {
+            throw std::runtime_error("Corrupt mesh cache\n");
+        }
+
+        BoundingBox bb(Point(entry.bounds_min[0], entry.bounds_min[1], entry.bounds_min[2]),
+            Point(entry.bounds_max[0], entry.bounds_max[1], entry.bounds_max[2]));
+        model->add_child(std::make_unique<TriangleMesh>(buffers, std::move(indices),
+            std::move(normal_indices), std::move(bvh), bb));
+    }
+    return model;
+}
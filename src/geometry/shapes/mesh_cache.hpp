@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "group.hpp"
+#include "triangle_mesh.hpp"
+
+// Identifies the source a cache was built from; any change to the OBJ's
+// size or modification time makes the cache stale
+struct MeshCacheKey {
+    uint64_t source_size = 0;
+    int64_t source_mtime = 0; // file clock ticks
+
+    static MeshCacheKey of(const char* source); // throws if source can't be stat'ed
+    bool operator==(const MeshCacheKey& other) const = default;
+};
+
+// Versioned binary snapshot of a group of TriangleMeshes that share one
+// MeshBuffers (as built by ObjParser::mesh_from_obj_data): the vertex and
+// normal arrays, then per mesh its bounds, index buffers and built face BVH.
+// Loading maps the file and copies each array in one block, so nothing is
+// parsed or rebuilt. Meshes' transforms and materials are not stored.
+// Native byte order; the cache is meant for the machine that wrote it
+struct MeshCache {
+    // 2: WideBVH nodes, 3: scalar size recorded
+    static constexpr uint32_t VERSION = 3;
+
+    // Written to a temporary file then renamed over path, so a reader never
+    // sees a partial cache. False if model isn't cacheable or on I/O errors
+    static bool save(const std::string& path, const Group& model, const MeshCacheKey& key);
+
+    // nullptr if there is no cache at path or it is stale, from another
+    // version or from a build with another real type. Throws
+    // std::runtime_error if the file is truncated or corrupt
+    static std::unique_ptr<Group> load(const std::string& path, const MeshCacheKey& key);
+};
@@ -1,5 +1,14 @@
 #include "obj_parser.hpp"
 
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <optional>
+
+#include "../../mapped_file.hpp"
+#include "../../rendering/thread_pool.hpp"
+#include "mesh_cache.hpp"
+
 void fan_triangulation(std::vector<Point>& face_verts, std::vector<std::unique_ptr<Triangle>>& triangles) {
     // std::vector<std::unique_ptr<Triangle>> triangles;
     for (int i = 2; i < face_verts.size() - 1; i++) {
@@ -47,9 +56,12 @@ ObjParser ObjParser::parse_obj_file(const char* filename) {
 
         std::string type = data[0];
         if (type == "g") {
-            auto new_group_u = std::make_unique<Group>();
-            curr_mesh = new_group_u.get();
-            parser.groups.emplace(data[1], std::move(new_group_u));
+            // Repeated names continue the existing group
+            auto [it, inserted] = parser.groups.try_emplace(data[1]);
+            if (inserted) {
+                it->second = std::make_unique<Group>();
+            }
+            curr_mesh = it->second.get();
             continue;
         }
         if (type == "v") {
@@ -113,12 +125,450 @@ ObjParser ObjParser::parse_obj_file(const char* filename) {
             auto n2 = parser.normals[vn2.value()];
             auto n3 = parser.normals[vn3.value()];
             curr_mesh->add_child(std::make_unique<SmoothTriangle>(p1, p2, p3, n1, n2, n3));
+            continue;
         }
         parser.ignored_lines++;
     }
     return parser;
 }
 
+namespace {
+    bool is_blank(char c) {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    // Tokenizer over a single line of the mapped file
+    struct LineCursor {
+        const char* p;
+        const char* end;
+
+        void skip_blanks() {
+            while (p < end && is_blank(*p)) {
+                p++;
+            }
+        }
+
+        std::string_view token() {
+            skip_blanks();
+            const char* start = p;
+            while (p < end && !is_blank(*p)) {
+                p++;
+            }
+            return std::string_view(start, p - start);
+        }
+
+        double number() {
+            skip_blanks();
+            if (p < end && *p == '+') { // from_chars rejects a leading '+'
+                p++;
+            }
+            double value;
+            if (fast_decimal(value)) {
+                return value;
+            }
+            auto [ptr, ec] = std::from_chars(p, end, value);
+            if (ec != std::errc()) {
+                throw std::runtime_error("Invalid number in OBJ file\n");
+            }
+            p = ptr;
+            return value;
+        }
+
+        // Plain decimals ("-1.234500") with at most 15 significant digits are
+        // exact as integer / 10^k, so one correctly rounded division gives the
+        // same double as from_chars at a fraction of the cost
+        bool fast_decimal(double& value) {
+            static constexpr double powers_of_10[] = {
+                1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+                1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+            };
+            const char* q = p;
+            bool negative = q < end && *q == '-';
+            q += negative;
+
+            uint64_t mantissa = 0;
+            int digits = 0;
+            int fraction_digits = 0;
+            const char* start = q;
+            while (q < end && *q >= '0' && *q <= '9') {
+                mantissa = mantissa * 10 + (*q++ - '0');
+                digits += mantissa != 0;
+            }
+            bool any_digits = q != start;
+            if (q < end && *q == '.') {
+                q++;
+                while (q < end && *q >= '0' && *q <= '9') {
+                    mantissa = mantissa * 10 + (*q++ - '0');
+                    digits += mantissa != 0;
+                    fraction_digits++;
+                }
+                any_digits |= fraction_digits != 0;
+            }
+            if (!any_digits || digits > 15 || fraction_digits > 22 ||
+                (q < end && (*q == 'e' || *q == 'E'))) {
+                return false; // exponents, long mantissas, etc. go through from_chars
+            }
+            value = static_cast<double>(mantissa) / powers_of_10[fraction_digits];
+            value = negative ? -value : value;
+            p = q;
+            return true;
+        }
+
+        // Hot enough in face lines to be worth hand-rolling over from_chars
+        int64_t integer() {
+            bool negative = p < end && *p == '-';
+            const char* q = p + negative;
+            const char* start = q;
+            int64_t value = 0;
+            while (q < end && *q >= '0' && *q <= '9' && q - start < 18) {
+                value = value * 10 + (*q++ - '0');
+            }
+            if (q == start || (q < end && *q >= '0' && *q <= '9')) {
+                throw std::runtime_error("Invalid face index in OBJ file\n");
+            }
+            p = q;
+            return negative ? -value : value;
+        }
+
+        bool consume(char c) {
+            if (p < end && *p == c) {
+                p++;
+                return true;
+            }
+            return false;
+        }
+    };
+
+    // 1-based index into an array that has a dummy at 0; negative indices
+    // count back from the most recent element
+    uint32_t resolve_index(int64_t index, size_t size) {
+        if (index < 0) {
+            index += size;
+        }
+        if (index <= 0 || index >= static_cast<int64_t>(size)) {
+            throw std::runtime_error("OBJ face index out of range\n");
+        }
+        return static_cast<uint32_t>(index);
+    }
+
+    // Calls f(line, type) for every line, type being the line's first token
+    template <typename F>
+    void for_each_line(std::string_view text, F&& f) {
+        const char* p = text.data();
+        const char* text_end = p + text.size();
+        while (p < text_end) {
+            const char* newline = static_cast<const char*>(std::memchr(p, '\n', text_end - p));
+            const char* line_end = newline ? newline : text_end;
+            LineCursor line{ p, line_end };
+            p = newline ? newline + 1 : text_end;
+            std::string_view type = line.token();
+            f(line, type);
+        }
+    }
+
+    // Splits text into about `count` pieces, each ending after a newline
+    std::vector<std::string_view> split_at_lines(std::string_view text, size_t count) {
+        std::vector<std::string_view> chunks;
+        size_t begin = 0;
+        for (size_t i = 1; i <= count && begin < text.size(); i++) {
+            size_t end = text.size();
+            if (i < count) {
+                end = text.find('\n', std::max(begin, text.size() * i / count));
+                end = end == std::string_view::npos ? text.size() : end + 1;
+            }
+            chunks.push_back(text.substr(begin, end - begin));
+            begin = end;
+        }
+        return chunks;
+    }
+
+    // First pass over a chunk: just enough to give every chunk its final
+    // vertex/normal offsets and starting group before any are parsed
+    struct ChunkScan {
+        std::string_view text;
+        size_t vertices = 0;
+        size_t normals = 0;
+        size_t face_lines = 0;
+        std::vector<std::string_view> group_names; // of each `g` line, in order
+
+        // Filled in by the serial pass between the two phases
+        size_t vertex_base = 0; // vertices declared before this chunk
+        size_t normal_base = 0;
+        uint32_t start_group = 0;
+        std::vector<uint32_t> group_ids; // for each `g` line
+    };
+
+    ChunkScan scan_chunk(std::string_view text) {
+        ChunkScan scan;
+        scan.text = text;
+        for_each_line(text, [&](LineCursor& line, std::string_view type) {
+            if (type == "v") {
+                scan.vertices++;
+            }
+            else if (type == "vn") {
+                scan.normals++;
+            }
+            else if (type == "f") {
+                scan.face_lines++;
+            }
+            else if (type == "g") {
+                scan.group_names.push_back(line.token());
+            }
+            });
+        return scan;
+    }
+
+    struct ChunkResult {
+        std::vector<ObjData::Face> faces;
+        int ignored_lines = 0;
+    };
+
+    // Second pass: vertices and normals go straight into their final slots
+    // in data, faces are collected per chunk and concatenated afterwards
+    void parse_chunk(const ChunkScan& scan, ObjData& data, ChunkResult& result) {
+        // Counts include the dummy at 0, as in the serial parse
+        size_t vertex_count = scan.vertex_base + 1;
+        size_t normal_count = scan.normal_base + 1;
+        uint32_t group = scan.start_group;
+        size_t next_group = 0;
+        result.faces.reserve(scan.face_lines);
+
+        // Reused across polygon lines
+        std::vector<uint32_t> face_v;
+        std::vector<uint32_t> face_vn;
+
+        for_each_line(scan.text, [&](LineCursor& line, std::string_view type) {
+            if (type == "v") {
+                double x = line.number();
+                double y = line.number();
+                double z = line.number();
+                data.vertices[vertex_count++] = Point(x, y, z);
+            }
+            else if (type == "vn") {
+                double x = line.number();
+                double y = line.number();
+                double z = line.number();
+                data.normals[normal_count++] = Vector(x, y, z);
+            }
+            else if (type == "vt") {
+            }
+            else if (type == "f") {
+                face_v.clear();
+                face_vn.clear();
+                bool has_normals = true;
+                for (line.skip_blanks(); line.p < line.end; line.skip_blanks()) {
+                    face_v.push_back(resolve_index(line.integer(), vertex_count));
+                    uint32_t vn = 0;
+                    if (line.consume('/')) {
+                        if (!line.consume('/')) {
+                            line.integer(); // texture coordinates are unused
+                            line.consume('/');
+                        }
+                        if (line.p < line.end && !is_blank(*line.p)) {
+                            vn = resolve_index(line.integer(), normal_count);
+                        }
+                    }
+                    has_normals = has_normals && vn != 0;
+                    face_vn.push_back(vn);
+                }
+                if (face_v.size() < 3) {
+                    throw std::runtime_error("OBJ face with fewer than 3 vertices\n");
+                }
+
+                // Fan around the first vertex, as in fan_triangulation
+                for (size_t i = 1; i + 1 < face_v.size(); i++) {
+                    ObjData::Face face = { { face_v[0], face_v[i], face_v[i + 1] }, { 0, 0, 0 }, group };
+                    if (has_normals) {
+                        face.vn[0] = face_vn[0];
+                        face.vn[1] = face_vn[i];
+                        face.vn[2] = face_vn[i + 1];
+                    }
+                    result.faces.push_back(face);
+                }
+            }
+            else if (type == "g") {
+                group = scan.group_ids[next_group++];
+            }
+            else {
+                result.ignored_lines++;
+            }
+            });
+    }
+}
+
+ObjData ObjParser::parse_obj_data(std::string_view text, size_t num_threads) {
+    if (num_threads == 0) {
+        num_threads = ThreadPool::default_thread_count();
+    }
+    // A few chunks per thread for balance, but not so small that the
+    // per-chunk bookkeeping shows up
+    constexpr size_t MIN_CHUNK_BYTES = 1 << 20;
+    size_t chunk_count = std::clamp<size_t>(text.size() / MIN_CHUNK_BYTES, 1, 4 * num_threads);
+    std::optional<ThreadPool> pool;
+    if (num_threads > 1 && chunk_count > 1) {
+        pool.emplace(num_threads);
+    }
+    ThreadPool* workers = pool ? &*pool : nullptr;
+
+    std::vector<std::string_view> chunks = split_at_lines(text, chunk_count);
+    std::vector<ChunkScan> scans(chunks.size());
+    for_each_chunk(workers, chunks.size(), [&](size_t i) {
+        scans[i] = scan_chunk(chunks[i]);
+        });
+
+    // Serial pass: global offsets and group numbering, in file order.
+    // Group names are views into text, which outlives the parse
+    ObjData data;
+    data.group_names.push_back("DefaultGroup");
+    std::unordered_map<std::string_view, uint32_t> group_ids = { { "DefaultGroup", 0 } };
+    uint32_t group = 0;
+    size_t vertices = 0;
+    size_t normals = 0;
+    for (auto& scan : scans) {
+        scan.vertex_base = vertices;
+        scan.normal_base = normals;
+        scan.start_group = group;
+        for (std::string_view name : scan.group_names) {
+            auto [it, inserted] = group_ids.try_emplace(name, data.group_names.size());
+            if (inserted) {
+                data.group_names.emplace_back(name);
+            }
+            group = it->second;
+            scan.group_ids.push_back(group);
+        }
+        vertices += scan.vertices;
+        normals += scan.normals;
+    }
+    data.vertices.resize(vertices + 1);
+    data.normals.resize(normals + 1);
+    data.vertices[0] = Point(INFINITY, INFINITY, INFINITY);
+    data.normals[0] = Vector(INFINITY, INFINITY, INFINITY);
+
+    std::vector<ChunkResult> results(chunks.size());
+    for_each_chunk(workers, chunks.size(), [&](size_t i) {
+        parse_chunk(scans[i], data, results[i]);
+        });
+
+    if (results.size() == 1) {
+        data.faces = std::move(results[0].faces);
+        data.ignored_lines = results[0].ignored_lines;
+        return data;
+    }
+    size_t faces = 0;
+    for (const auto& result : results) {
+        faces += result.faces.size();
+    }
+    data.faces.reserve(faces);
+    for (const auto& result : results) {
+        data.faces.insert(data.faces.end(), result.faces.begin(), result.faces.end());
+        data.ignored_lines += result.ignored_lines;
+    }
+    return data;
+}
+
+ObjParser ObjParser::from_obj_data(ObjData data) {
+    ObjParser parser;
+    parser.ignored_lines = data.ignored_lines;
+    parser.vertices = std::move(data.vertices);
+    parser.normals = std::move(data.normals);
+
+    std::vector<Group*> groups;
+    std::vector<size_t> group_sizes(data.group_names.size());
+    for (const auto& face : data.faces) {
+        group_sizes[face.group]++;
+    }
+    for (size_t i = 0; i < data.group_names.size(); i++) {
+        auto& group_u = parser.groups[data.group_names[i]];
+        if (!group_u) {
+            group_u = std::make_unique<Group>();
+        }
+        group_u.get()->shapes.reserve(group_sizes[i]);
+        groups.push_back(group_u.get());
+    }
+
+    for (const auto& face : data.faces) {
+        const auto& v = parser.vertices;
+        const auto& n = parser.normals;
+        if (face.vn[0] == 0) {
+            groups[face.group]->add_child(std::make_unique<Triangle>(
+                v[face.v[0]], v[face.v[1]], v[face.v[2]]));
+        }
+        else {
+            groups[face.group]->add_child(std::make_unique<SmoothTriangle>(
+                v[face.v[0]], v[face.v[1]], v[face.v[2]],
+                n[face.vn[0]], n[face.vn[1]], n[face.vn[2]]));
+        }
+    }
+    return parser;
+}
+
+std::unique_ptr<Group> ObjParser::mesh_from_obj_data(ObjData data, const SAHOptions& options) {
+    std::vector<size_t> group_sizes(data.group_names.size());
+    bool smooth = false;
+    for (const auto& face : data.faces) {
+        group_sizes[face.group]++;
+        smooth = smooth || face.vn[0] != 0;
+    }
+
+    // The dummy elements stay, so ObjData's 1-based indices are used as is
+    auto buffers = std::make_shared<MeshBuffers>();
+    buffers->vertices = std::move(data.vertices);
+    buffers->normals = std::move(data.normals);
+
+    std::vector<std::vector<uint32_t>> indices(group_sizes.size());
+    std::vector<std::vector<uint32_t>> normal_indices(group_sizes.size());
+    for (size_t i = 0; i < group_sizes.size(); i++) {
+        indices[i].reserve(3 * group_sizes[i]);
+        if (smooth) {
+            normal_indices[i].reserve(3 * group_sizes[i]);
+        }
+    }
+    for (const auto& face : data.faces) {
+        indices[face.group].insert(indices[face.group].end(), face.v, face.v + 3);
+        if (smooth) {
+            for (uint32_t vn : face.vn) {
+                normal_indices[face.group].push_back(vn == 0 ? TriangleMesh::NO_NORMAL : vn);
+            }
+        }
+    }
+
+    auto model = std::make_unique<Group>();
+    for (size_t i = 0; i < group_sizes.size(); i++) {
+        if (group_sizes[i] > 0) {
+            model->add_child(std::make_unique<TriangleMesh>(buffers, std::move(indices[i]),
+                std::move(normal_indices[i]), options));
+        }
+    }
+    return model;
+}
+
+std::unique_ptr<Group> ObjParser::parse_obj_mesh(const char* filename, size_t num_threads) {
+    MappedFile file(filename);
+    SAHOptions options;
+    options.num_threads = num_threads;
+    return mesh_from_obj_data(parse_obj_data(file.contents(), num_threads), options);
+}
+
+std::unique_ptr<Group> ObjParser::load_obj_mesh(const char* filename, const std::string& cache_path,
+    size_t num_threads) {
+    MeshCacheKey key = MeshCacheKey::of(filename);
+    try {
+        if (auto model = MeshCache::load(cache_path, key)) {
+            return model;
+        }
+    }
+    catch (const std::runtime_error&) { // corrupt cache, rebuild it
+    }
+    auto model = parse_obj_mesh(filename, num_threads);
+    MeshCache::save(cache_path, *model, key);
+    return model;
+}
+
+ObjParser ObjParser::parse_obj_file_mapped(const char* filename, size_t num_threads) {
+    MappedFile file(filename);
+    return from_obj_data(parse_obj_data(file.contents(), num_threads));
+}
+
 // TODO: this doesnt make it clear that `groups` is no longer valid
 // TODO: Need to throw error if used after this called (and set flag)
 // rvalue-qualification prevents accidental usage
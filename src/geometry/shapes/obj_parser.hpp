@@ -1,10 +1,28 @@
 #pragma once
 #include "all_shapes.hpp"
 
+#include <cstdint>
 #include <fstream>
 #include <boost/algorithm/string.hpp>
+#include <string_view>
 #include <unordered_map>
 
+// Flat result of the fast parser. vertices/normals keep a dummy element at 0
+// like ObjParser, so the file's 1-based indices are used as is
+struct ObjData {
+    struct Face {
+        uint32_t v[3];
+        uint32_t vn[3]; // all 0 when the face has no normals
+        uint32_t group; // into group_names
+    };
+
+    std::vector<Point> vertices;
+    std::vector<Vector> normals;
+    std::vector<Face> faces; // polygons are already fan-triangulated
+    std::vector<std::string> group_names; // 0 is always "DefaultGroup"
+    int ignored_lines = 0;
+};
+
 struct ObjParser {
 public:
     int ignored_lines;
@@ -19,6 +37,26 @@ public:
 
     static ObjParser parse_obj_file(const char* filename);
 
+    // Fast path: memory-maps the file and tokenizes it in place with
+    // std::from_chars, then builds the same groups as parse_obj_file.
+    // Large files are parsed in chunks on num_threads threads (0 = all
+    // cores); the result doesn't depend on the thread count
+    static ObjParser parse_obj_file_mapped(const char* filename, size_t num_threads = 0);
+    static ObjData parse_obj_data(std::string_view text, size_t num_threads = 1);
+    static ObjParser from_obj_data(ObjData data);
+
+    // Compact alternative to from_obj_data: one TriangleMesh per non-empty
+    // OBJ group, in file order, all sharing the model's vertex and normal
+    // buffers, instead of a Triangle shape per face
+    static std::unique_ptr<Group> mesh_from_obj_data(ObjData data,
+        const SAHOptions& options = SAHOptions());
+    static std::unique_ptr<Group> parse_obj_mesh(const char* filename, size_t num_threads = 0);
+    // parse_obj_mesh through a MeshCache at cache_path: a cache matching the
+    // OBJ's size and mtime is loaded instead of parsing, otherwise the OBJ
+    // is parsed and the cache (re)written
+    static std::unique_ptr<Group> load_obj_mesh(const char* filename, const std::string& cache_path,
+        size_t num_threads = 0);
+
     Group* get_default_group() const {
         return groups.at("DefaultGroup").get();
     }
@@ -1,5 +1,17 @@
+#pragma once
+
 #include "shapes.hpp"
 
+// Where the ray crosses the xz plane; none if it runs (nearly) parallel.
+// Shared by Plane and CompiledScene
+inline bool intersect_plane(const Ray& r, real& t) {
+    if (std::abs(r.dir.y) < EPSILON) {
+        return false;
+    }
+    t = -r.origin.y * r.inv_dir.y;
+    return true;
+}
+
 struct Plane : public Shape {
     BoundingBox bounds_of() const override {
         return BoundingBox(Point(MIN_DOUBLE, 0, MIN_DOUBLE), Point(MAX_DOUBLE, 0, MAX_DOUBLE));
@@ -10,11 +22,23 @@ private:
     }
 
     IntersectionRecord local_intersect(const Ray local_r) const override {
-        if (abs(local_r.dir.y) < EPSILON) {
+        real t;
+        if (!intersect_plane(local_r, t)) {
             return IntersectionRecord();
         }
-
-        double t = -local_r.origin.y / local_r.dir.y;
         return Intersection(t, this);
     }
+
+    bool local_occluded(const Ray local_r, real tmax) const override {
+        real t;
+        return intersect_plane(local_r, t) && t >= 0 && t < tmax;
+    }
+
+    std::optional<Intersection> local_intersect_closest(const Ray local_r, real tmax) const override {
+        real t;
+        if (intersect_plane(local_r, t) && t >= 0 && t < tmax) {
+            return Intersection(t, this);
+        }
+        return std::nullopt;
+    }
 };
\ No newline at end of file
@@ -1,6 +1,8 @@
 #include "shapes.hpp"
 #include "group.hpp"
 
+#include <atomic>
+
 Vector Shape::normal_at(const Point world_p, const Intersection i) const {
     Point local_p = this->world_to_object(world_p);
     Vector local_n = this->local_normal_at(local_p, i);
@@ -8,23 +10,102 @@ Vector Shape::normal_at(const Point world_p, const Intersection i) const {
 }
 
 IntersectionRecord Shape::intersect(const Ray r) const {
-    Ray obj_space_ray = r.transform(transform.inverse());
+    if (transform.is_identity()) {
+        return this->local_intersect(r);
+    }
+    if (!transform.is_invertible()) {
+        return IntersectionRecord(); // flattened to nothing
+    }
+    Ray obj_space_ray = r.transform(transform.inverse_matrix());
     return this->local_intersect(obj_space_ray);
 }
 
+bool Shape::occluded(const Ray r, real tmax) const {
+    if (transform.is_identity()) {
+        return this->local_occluded(r, tmax);
+    }
+    if (!transform.is_invertible()) {
+        return false;
+    }
+    Ray obj_space_ray = r.transform(transform.inverse_matrix());
+    return this->local_occluded(obj_space_ray, tmax);
+}
+
+// t is unchanged by the transform as the object space ray is not normalized
+bool Shape::local_occluded(const Ray local_r, real tmax) const {
+    for (const auto& i : this->local_intersect(local_r).intersections) {
+        if (i.t >= 0 && i.t < tmax) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::optional<Intersection> Shape::intersect_closest(const Ray r, real tmax) const {
+    if (transform.is_identity()) {
+        return this->local_intersect_closest(r, tmax);
+    }
+    if (!transform.is_invertible()) {
+        return std::nullopt;
+    }
+    Ray obj_space_ray = r.transform(transform.inverse_matrix());
+    return this->local_intersect_closest(obj_space_ray, tmax);
+}
+
+std::optional<Intersection> Shape::local_intersect_closest(const Ray local_r, real tmax) const {
+    std::optional<Intersection> closest;
+    for (const auto& i : this->local_intersect(local_r).intersections) {
+        if (i.t >= 0 && i.t < tmax) {
+            closest = i;
+            tmax = i.t;
+        }
+    }
+    return closest;
+}
+
+// Validating walks up the parents comparing ids, and only a change somewhere
+// along the chain costs matrix products: each level from there down is
+// recomputed, getting a new version that invalidates the level below
+const Shape::WorldTransform& Shape::world_transform() const {
+    for (const Shape* s = this;; ) {
+        const Shape* up = s->parent.has_value() ? static_cast<const Shape*>(s->parent.value()) : nullptr;
+        const WorldTransform& cache = s->world_cache;
+        if (cache.version == 0 || cache.transform_id != s->transform.id()
+            || cache.parent_version != (up ? up->world_cache.version : 0)) {
+            break;
+        }
+        if (!up) {
+            return world_cache;
+        }
+        s = up;
+    }
+
+    static std::atomic<uint64_t> next_version = 1;
+    const WorldTransform* parent_transform = parent.has_value()
+        ? &static_cast<const Shape*>(parent.value())->world_transform() : nullptr;
+    uint64_t parent_version = parent_transform ? parent_transform->version : 0;
+    world_cache.world_to_object = parent_transform
+        ? transform.inverse_matrix() * parent_transform->world_to_object
+        : transform.inverse_matrix();
+    world_cache.transform_id = transform.id();
+    world_cache.parent_version = parent_version;
+    world_cache.version = next_version++;
+    return world_cache;
+}
+
+// Top-level shapes skip the cache, as their transform already holds both
 Point Shape::world_to_object(Point p) const {
-    if (parent.has_value()) {
-        p = parent.value()->world_to_object(p);
+    if (!parent.has_value()) {
+        return transform.inverse_matrix() * p;
     }
-    return transform.inverse() * p;
+    return world_transform().world_to_object * p;
 }
 
+// Normalized once at the end, as every level is linear in the normal
 Vector Shape::normal_to_world(Vector normal) const {
-    auto temp_normal = transform.inverse().transpose() * normal;
+    auto temp_normal = parent.has_value()
+        ? world_transform().world_to_object.transpose_multiply(normal)
+        : transform.inverse_transpose_matrix() * normal;
     temp_normal.w = 0;
-    normal = Vector(temp_normal).normalized();
-    if (parent.has_value()) {
-        normal = parent.value()->normal_to_world(normal);
-    }
-    return normal;
-}
\ No newline at end of file
+    return Vector(temp_normal).normalized();
+}
@@ -8,6 +8,8 @@
 #include "../intersection.hpp"
 #include "../ray.hpp"
 #include "../../accel/bounding_box.hpp"
+#include "../../accel/bvh.hpp"
+#include "../../accel/wide_bvh.hpp"
 
 struct Group;
 
@@ -25,8 +27,18 @@ public:
 
     Vector normal_at(const Point p, const Intersection i = Intersection()) const;
     IntersectionRecord intersect(const Ray r) const;
+    // Any-hit query: is there an intersection with t in [0, tmax)?
+    bool occluded(const Ray r, real tmax) const;
+    // Closest-hit query: the nearest intersection with t in [0, tmax)
+    std::optional<Intersection> intersect_closest(const Ray r, real tmax = INFINITY) const;
     Point world_to_object(Point p) const;
     Vector normal_to_world(Vector normal) const;
+    // The material shading a hit on this shape; only an Instance's depends on
+    // which of its prototype's shapes was hit
+    virtual const Material& material_at(const Intersection& i) const { return material; }
+    // transform composed with every ancestor's, cached until one of them is
+    // replaced or the shape moves to another group
+    const Matrix4& world_to_object_matrix() const { return world_transform().world_to_object; }
     virtual BoundingBox bounds_of() const = 0;
 
     BoundingBox parent_space_bounds_of() const {
@@ -34,10 +46,29 @@ public:
     }
 
     virtual void divide(int min_children) {}
+    virtual void divide_sah(const SAHOptions& options) {}
+    // Moves transform into the shape's own geometry and resets it to the
+    // identity, which intersections then skip. Shapes that can't (spheres,
+    // meshes sharing their vertices, ...) keep it
+    virtual void bake_transform() {}
 
 private:
+    struct WorldTransform {
+        Matrix4 world_to_object;    // its transpose takes normals to world space
+        uint64_t transform_id = 0;  // transform.id() when computed
+        uint64_t parent_version = 0; // the parent's version, 0 without one
+        uint64_t version = 0;       // unique per computation, 0 before the first
+    };
+    // Lazily computed, so World::prepare() fills it before concurrent renders
+    mutable WorldTransform world_cache;
+
+    const WorldTransform& world_transform() const;
+
     virtual IntersectionRecord local_intersect(const Ray local_r) const = 0;
     virtual Vector local_normal_at(const Point local_p, Intersection i) const = 0;
+    // Scans local_intersect() by default; override to skip building the record
+    virtual bool local_occluded(const Ray local_r, real tmax) const;
+    virtual std::optional<Intersection> local_intersect_closest(const Ray local_r, real tmax) const;
 };
 
 struct TestShape : public Shape {
@@ -4,22 +4,34 @@ Vector Sphere::local_normal_at(const Point local_p, Intersection i) const {
     return local_p - origin;
 }
 
-// TODO: look into math of it
 IntersectionRecord Sphere::local_intersect(const Ray local_r) const {
-    // Ray obj_space_ray = r.transform(transform.inverse());
-
-    Vector sphere_to_ray = local_r.origin - origin;
-    double a = local_r.dir.dot(local_r.dir);
-    double b = 2 * local_r.dir.dot(sphere_to_ray);
-    double c = sphere_to_ray.dot(sphere_to_ray) - 1;
-    double discriminant = pow(b, 2) - 4 * a * c;
-
-    if (discriminant < 0) {
+    real t1, t2;
+    if (!intersect_sphere(local_r, origin, t1, t2)) {
         return IntersectionRecord();
     }
+    return IntersectionRecord(Intersection(t1, this), Intersection(t2, this));
+}
+
+bool Sphere::local_occluded(const Ray local_r, real tmax) const {
+    real t1, t2;
+    if (!intersect_sphere(local_r, origin, t1, t2)) {
+        return false;
+    }
+    return (t1 >= 0 && t1 < tmax) || (t2 >= 0 && t2 < tmax);
+}
 
-    double t1 = (-b - sqrt(discriminant)) / (2 * a);
-    double t2 = (-b + sqrt(discriminant)) / (2 * a);
+std::optional<Intersection> Sphere::local_intersect_closest(const Ray local_r, real tmax) const {
+    real t1, t2;
+    if (!intersect_sphere(local_r, origin, t1, t2)) {
+        return std::nullopt;
+    }
 
-    return IntersectionRecord(Intersection(t1, this), Intersection(t2, this));
-}
\ No newline at end of file
+    // t1 <= t2, so the first one in range is the closest
+    if (t1 >= 0 && t1 < tmax) {
+        return Intersection(t1, this);
+    }
+    if (t2 >= 0 && t2 < tmax) {
+        return Intersection(t2, this);
+    }
+    return std::nullopt;
+}
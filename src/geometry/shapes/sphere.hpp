@@ -2,10 +2,36 @@
 
 #include "shapes.hpp"
 
+// Both roots of |o + t d - center|^2 = 1, t1 <= t2. The discriminant comes
+// from the ray's closest approach to the center rather than b^2 - 4ac, and
+// the second root from c / q, so neither cancels catastrophically; in float
+// the textbook form misses thin, heavily scaled spheres. Shared by Sphere and
+// CompiledScene
+inline bool intersect_sphere(const Ray& r, const Point& center, real& t1, real& t2) {
+    Vector f = r.origin - center;
+    real a = r.dir.dot(r.dir);
+    real half_b = -f.dot(r.dir);
+    real c = f.dot(f) - 1;
+    Vector closest = f + r.dir * (half_b / a); // closest approach to the center
+    real discriminant = a * (1 - closest.dot(closest));
+
+    if (discriminant < 0) {
+        return false;
+    }
+
+    real q = half_b + std::copysign(sqrt(discriminant), half_b);
+    t1 = q / a;
+    t2 = q != 0 ? c / q : t1;
+    if (t1 > t2) {
+        std::swap(t1, t2);
+    }
+    return true;
+}
+
 struct Sphere : public Shape {
 public:
     Point origin;
-    double radius;
+    real radius;
     // Transform transform;
     // Material material;
 
@@ -21,8 +47,9 @@ public:
 private:
     Vector local_normal_at(const Point local_p, Intersection i) const override;
 
-    // TODO: look into math of it
     IntersectionRecord local_intersect(const Ray local_r) const override;
+    bool local_occluded(const Ray local_r, real tmax) const override;
+    std::optional<Intersection> local_intersect_closest(const Ray local_r, real tmax) const override;
 };
 
 struct GlassSphere : public Sphere {
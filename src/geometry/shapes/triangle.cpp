@@ -1,5 +1,13 @@
 #include "triangle.hpp"
 
+namespace {
+    // Left unnormalized, as normal_to_world normalizes after interpolating
+    Vector transform_normal(const Transform& transform, const Vector& normal) {
+        auto n = transform.inverse_transpose_matrix() * normal;
+        return Vector(n.x, n.y, n.z);
+    }
+}
+
 BoundingBox Triangle::bounds_of() const {
     BoundingBox bb;
     bb.add_point(p1);
@@ -8,31 +16,58 @@ BoundingBox Triangle::bounds_of() const {
     return bb;
 }
 
+void Triangle::bake_transform() {
+    // A singular transform stays, so the triangle keeps not being hit
+    if (transform.is_identity() || !transform.is_invertible()) {
+        return;
+    }
+    p1 = transform * p1;
+    p2 = transform * p2;
+    p3 = transform * p3;
+    e1 = p2 - p1;
+    e2 = p3 - p1;
+    // Not recomputed from the edges, which flip it under a mirroring transform
+    normal = transform_normal(transform, normal).normalized();
+    transform = Transform();
+}
+
 Vector Triangle::local_normal_at(const Point local_p, Intersection i) const {
     return normal;
 }
 
+bool Triangle::hit_triangle(const Ray& local_r, real& t, real& u, real& v) const {
+    return intersect_triangle(local_r, p1, e1, e2, t, u, v);
+}
+
 IntersectionRecord Triangle::local_intersect(const Ray local_r) const {
-    auto dir_cross_e2 = local_r.dir.cross(e2);
-    double determinant = e1.dot(dir_cross_e2);
-    if (abs(determinant) < EPSILON) {
-        return IntersectionRecord();
-    }
-    double f = 1 / determinant;
-    Vector p1_to_origin = local_r.origin - p1;
-    auto u = f * p1_to_origin.dot(dir_cross_e2);
-    if (u < 0 || u > 1) { // ray misses p1-p3 edge
+    real t, u, v;
+    if (!hit_triangle(local_r, t, u, v)) {
         return IntersectionRecord();
     }
+    return Intersection(t, this, u, v);
+}
 
-    Vector origin_cross_e1 = p1_to_origin.cross(e1);
-    auto v = f * local_r.dir.dot(origin_cross_e1);
-    if (v < 0 || u + v > 1) {
-        return IntersectionRecord();
+bool Triangle::local_occluded(const Ray local_r, real tmax) const {
+    real t, u, v;
+    return hit_triangle(local_r, t, u, v) && t >= 0 && t < tmax;
+}
+
+std::optional<Intersection> Triangle::local_intersect_closest(const Ray local_r, real tmax) const {
+    real t, u, v;
+    if (hit_triangle(local_r, t, u, v) && t >= 0 && t < tmax) {
+        return Intersection(t, this, u, v);
     }
+    return std::nullopt;
+}
 
-    auto t = f * e2.dot(origin_cross_e1);
-    return Intersection(t, this, u, v);
+void SmoothTriangle::bake_transform() {
+    if (transform.is_identity() || !transform.is_invertible()) {
+        return;
+    }
+    n1 = transform_normal(transform, n1);
+    n2 = transform_normal(transform, n2);
+    n3 = transform_normal(transform, n3);
+    Triangle::bake_transform();
 }
 
 // Interpolated normal
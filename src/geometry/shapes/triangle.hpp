@@ -2,6 +2,32 @@
 
 #include "shapes.hpp"
 
+// Moller-Trumbore against the triangle (p1, p1 + e1, p1 + e2). Shared by
+// Triangle and TriangleMesh so both give identical hits
+inline bool intersect_triangle(const Ray& r, const Point& p1, const Vector& e1,
+    const Vector& e2, real& t, real& u, real& v) {
+    auto dir_cross_e2 = r.dir.cross(e2);
+    real determinant = e1.dot(dir_cross_e2);
+    if (std::abs(determinant) < EPSILON) {
+        return false;
+    }
+    real f = 1 / determinant;
+    Vector p1_to_origin = r.origin - p1;
+    u = f * p1_to_origin.dot(dir_cross_e2);
+    if (u < 0 || u > 1) { // ray misses p1-p3 edge
+        return false;
+    }
+
+    Vector origin_cross_e1 = p1_to_origin.cross(e1);
+    v = f * r.dir.dot(origin_cross_e1);
+    if (v < 0 || u + v > 1) {
+        return false;
+    }
+
+    t = f * e2.dot(origin_cross_e1);
+    return true;
+}
+
 struct Triangle : public Shape {
 public:
     Point p1;
@@ -18,12 +44,20 @@ public:
     }
 
     // TODO: should this go in intersectionrecord as a factory method
-    // IntersectionRecord intersect_with_uv(double t, double u, double v) const;
+    // IntersectionRecord intersect_with_uv(real t, real u, real v) const;
     BoundingBox bounds_of() const override;
+    // Transforms the vertices. Hits keep their t and u/v, but the parallel
+    // ray test's EPSILON then applies at the new scale
+    void bake_transform() override;
 
 private:
     Vector local_normal_at(const Point local_p, Intersection i) const override;
     IntersectionRecord local_intersect(const Ray local_r) const override;
+    bool local_occluded(const Ray local_r, real tmax) const override;
+    std::optional<Intersection> local_intersect_closest(const Ray local_r, real tmax) const override;
+
+    // Moller-Trumbore; shared by both queries
+    bool hit_triangle(const Ray& local_r, real& t, real& u, real& v) const;
 };
 
 struct SmoothTriangle : public Triangle { // TODO: maybe a child of Triangle
@@ -39,6 +73,8 @@ struct SmoothTriangle : public Triangle { // TODO: maybe a child of Triangle
         Triangle(p1, p2, p3), n1(n1), n2(n2), n3(n3) {
     }
 
+    void bake_transform() override;
+
 private:
     Vector local_normal_at(const Point local_p, Intersection i) const override;
     // IntersectionRecord local_intersect(const Ray local_r) const override;
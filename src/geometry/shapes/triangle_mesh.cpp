@@ -0,0 +1,127 @@
+#include "triangle_mesh.hpp"
+
+#include <algorithm>
+#include <bit>
+
+
+TriangleMesh::TriangleMesh(std::shared_ptr<const MeshBuffers> buffers, std::vector<uint32_t> indices,
+    std::vector<uint32_t> normal_indices, const SAHOptions& options) :
+    buffers(std::move(buffers)), indices(std::move(indices)), normal_indices(std::move(normal_indices)) {
+    assert(this->indices.size() % 3 == 0);
+    assert(this->normal_indices.empty() || this->normal_indices.size() == this->indices.size());
+    divide_sah(options);
+}
+
+TriangleMesh::TriangleMesh(std::shared_ptr<const MeshBuffers> buffers, std::vector<uint32_t> indices,
+    std::vector<uint32_t> normal_indices, WideBVH bvh, BoundingBox bounds) :
+    buffers(std::move(buffers)), indices(std::move(indices)), normal_indices(std::move(normal_indices)),
+    bvh(std::move(bvh)), bb(bounds) {
+    build_packets();
+}
+
+BoundingBox TriangleMesh::face_bounds(uint32_t face) const {
+    BoundingBox face_bb;
+    for (int k = 0; k < 3; k++) {
+        face_bb.add_point(buffers->vertices[indices[3 * face + k]]);
+    }
+    return face_bb;
+}
+
+BoundingBox TriangleMesh::bounds_of() const {
+    return bb;
+}
+
+void TriangleMesh::divide_sah(const SAHOptions& options) {
+    std::vector<BoundingBox> bounds;
+    bounds.reserve(face_count());
+    bb = BoundingBox();
+    for (uint32_t face = 0; face < face_count(); face++) {
+        bounds.push_back(face_bounds(face));
+        bb.add_BB(bounds.back());
+    }
+    LinearBVH binary = LinearBVH::build_parallel(bounds, options.num_threads, options);
+    binary.align_leaves(TrianglePacket::WIDTH);
+    bvh = WideBVH::collapse(std::move(binary));
+    build_packets();
+}
+
+void TriangleMesh::build_packets() {
+    constexpr int WIDTH = TrianglePacket::WIDTH;
+    packets.assign(bvh.indices.size() / WIDTH, TrianglePacket());
+    const auto& vertices = buffers->vertices;
+    for (const auto& node : bvh.nodes) {
+        for (int slot = 0; slot < WideBVHNode::WIDTH; slot++) {
+            // Lanes past a leaf's count stay degenerate
+            uint32_t offset = node.child[slot];
+            for (uint32_t i = offset; i < offset + node.count[slot]; i++) {
+                const uint32_t* face = &indices[3 * bvh.indices[i]];
+                packets[i / WIDTH].set(i % WIDTH, vertices[face[0]], vertices[face[1]], vertices[face[2]]);
+            }
+        }
+    }
+}
+
+template <typename Visit>
+void TriangleMesh::traverse_faces(const Ray& local_r, Visit&& visit) const {
+    constexpr int WIDTH = TrianglePacket::WIDTH;
+    bvh.traverse(local_r,
+        [&](const uint32_t* faces, uint32_t count, real limit) {
+            size_t first = (faces - bvh.indices.data()) / WIDTH;
+            for (size_t k = first; k < first + (count + WIDTH - 1) / WIDTH; k++) {
+                real t[WIDTH], u[WIDTH], v[WIDTH];
+                for (unsigned hits = intersect_packet(packets[k], local_r, t, u, v); hits; hits &= hits - 1) {
+                    int lane = std::countr_zero(hits);
+                    limit = visit(Intersection(t[lane], this, u[lane], v[lane],
+                        bvh.indices[k * WIDTH + lane]), limit);
+                }
+            }
+            return limit;
+        });
+}
+
+// Same normals as Triangle and SmoothTriangle
+Vector TriangleMesh::local_normal_at(const Point local_p, Intersection i) const {
+    const uint32_t* n = normal_indices.empty() ? nullptr : &normal_indices[3 * i.face];
+    if (n && n[0] != NO_NORMAL) {
+        const auto& normals = buffers->normals;
+        return normals[n[1]] * i.u + normals[n[2]] * i.v + normals[n[0]] * (1 - i.u - i.v);
+    }
+    const auto& vertices = buffers->vertices;
+    const Point& p1 = vertices[indices[3 * i.face]];
+    Vector e1 = vertices[indices[3 * i.face + 1]] - p1;
+    Vector e2 = vertices[indices[3 * i.face + 2]] - p1;
+    return e2.cross(e1).normalized();
+}
+
+IntersectionRecord TriangleMesh::local_intersect(const Ray local_r) const {
+    IntersectionRecord xs;
+    traverse_faces(local_r, [&](const Intersection& hit, real tmax) {
+        xs.append_record(hit);
+        return tmax;
+        });
+    std::sort(xs.intersections.begin(), xs.intersections.end(), [](Intersection a, Intersection b) {
+        return a.t < b.t;
+        });
+    return xs;
+}
+
+bool TriangleMesh::local_occluded(const Ray local_r, real tmax) const {
+    bool hit = false;
+    traverse_faces(local_r.clipped(0, tmax), [&](const Intersection& i, real limit) {
+        hit = hit || (i.t >= 0 && i.t < limit);
+        return hit ? -INFINITY : limit; // culls everything left on the stack
+        });
+    return hit;
+}
+
+std::optional<Intersection> TriangleMesh::local_intersect_closest(const Ray local_r, real tmax) const {
+    std::optional<Intersection> closest;
+    traverse_faces(local_r.clipped(0, tmax), [&](const Intersection& i, real limit) {
+        if (i.t >= 0 && i.t < limit) {
+            closest = i;
+            return i.t;
+        }
+        return limit;
+        });
+    return closest;
+}
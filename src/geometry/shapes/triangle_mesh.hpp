@@ -0,0 +1,59 @@
+#pragma once
+
+#include <memory>
+
+#include "../../accel/triangle_packet.hpp"
+#include "shapes.hpp"
+
+// Vertex and normal arrays of a model, shared by all of its meshes
+struct MeshBuffers {
+    std::vector<Point> vertices;
+    std::vector<Vector> normals;
+};
+
+// Triangles stored as indices into shared buffers rather than as one Triangle
+// shape each, with a BVH over the faces. A face costs its 12 (24 if smooth)
+// bytes of indices, its share of the BVH and vertices, and nine reals (72
+// bytes, 36 with RAYTRACER_FLOAT) in the SIMD packets its leaf is
+// intersected with. Hits carry the face id and its barycentric u/v
+struct TriangleMesh : public Shape {
+    static constexpr uint32_t NO_NORMAL = UINT32_MAX;
+
+    std::shared_ptr<const MeshBuffers> buffers;
+    std::vector<uint32_t> indices; // 3 per face, into buffers->vertices
+    // 3 per face, into buffers->normals (NO_NORMAL for a flat face); empty
+    // when every face is flat
+    std::vector<uint32_t> normal_indices;
+
+    TriangleMesh(std::shared_ptr<const MeshBuffers> buffers, std::vector<uint32_t> indices,
+        std::vector<uint32_t> normal_indices = {}, const SAHOptions& options = SAHOptions());
+    // Adopts an already built face BVH and bounds (see MeshCache)
+    TriangleMesh(std::shared_ptr<const MeshBuffers> buffers, std::vector<uint32_t> indices,
+        std::vector<uint32_t> normal_indices, WideBVH bvh, BoundingBox bounds);
+
+    size_t face_count() const { return indices.size() / 3; }
+    BoundingBox face_bounds(uint32_t face) const;
+    BoundingBox bounds_of() const override;
+
+    // The face BVH is built on construction, on options.num_threads threads
+    // for large meshes; this rebuilds it with options
+    void divide_sah(const SAHOptions& options = SAHOptions()) override;
+    const WideBVH& wide_bvh() const { return bvh; }
+
+private:
+    WideBVH bvh; // leaves aligned to packets
+    BoundingBox bb;
+    // Packet k holds the faces at bvh.indices[k * WIDTH, (k + 1) * WIDTH)
+    std::vector<TrianglePacket> packets;
+
+    void build_packets();
+    // Calls visit(hit, tmax) -> new tmax for every face hit in leaves the
+    // ray enters within its [tmin, tmax], with no t filtering of its own
+    template <typename Visit>
+    void traverse_faces(const Ray& local_r, Visit&& visit) const;
+
+    Vector local_normal_at(const Point local_p, Intersection i) const override;
+    IntersectionRecord local_intersect(const Ray local_r) const override;
+    bool local_occluded(const Ray local_r, real tmax) const override;
+    std::optional<Intersection> local_intersect_closest(const Ray local_r, real tmax) const override;
+};
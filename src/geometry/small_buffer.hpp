@@ -0,0 +1,187 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+#include <initializer_list>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Per-thread free lists of spilled SmallBuffer storage, one per power-of-two
+// size class. Blocks are recycled rather than freed, so once a thread has
+// seen its longest intersection list it stops calling malloc
+template <typename T>
+struct SpillArena {
+    // Rounds capacity up to the block's (power of two) size
+    static T* acquire(size_t& capacity) {
+        capacity = std::bit_ceil(capacity);
+        if (pool_destroyed) { // called from another thread_local's destructor
+            return new T[capacity];
+        }
+        auto& blocks = pool().free[std::countr_zero(capacity)];
+        if (!blocks.empty()) {
+            T* block = blocks.back();
+            blocks.pop_back();
+            return block;
+        }
+        return new T[capacity];
+    }
+
+    static void release(T* block, size_t capacity) {
+        if (pool_destroyed) { // buffer outlived its thread's arena
+            delete[] block;
+            return;
+        }
+        pool().free[std::countr_zero(capacity)].push_back(block);
+    }
+
+private:
+    struct Pool {
+        std::vector<T*> free[64];
+
+        ~Pool() {
+            for (auto& blocks : free) {
+                for (T* block : blocks) {
+                    delete[] block;
+                }
+            }
+            pool_destroyed = true;
+        }
+    };
+
+    static Pool& pool() {
+        thread_local Pool p;
+        return p;
+    }
+
+    // Trivially destructible, so still readable while thread_locals are torn down
+    static inline thread_local bool pool_destroyed = false;
+};
+
+// Vector-like buffer holding up to N items inline. Larger sizes spill to
+// SpillArena storage, which moves steal instead of copying
+template <typename T, size_t N>
+struct SmallBuffer {
+    static_assert(std::is_trivially_copyable_v<T>);
+
+    SmallBuffer() {}
+
+    SmallBuffer(std::initializer_list<T> init) {
+        append(init.begin(), init.size());
+    }
+
+    SmallBuffer(const SmallBuffer& other) {
+        append(other.data(), other.size());
+    }
+
+    SmallBuffer(SmallBuffer&& other) noexcept {
+        take(other);
+    }
+
+    SmallBuffer& operator=(const SmallBuffer& other) {
+        if (this != &other) {
+            clear();
+            append(other.data(), other.size());
+        }
+        return *this;
+    }
+
+    SmallBuffer& operator=(SmallBuffer&& other) noexcept {
+        if (this != &other) {
+            free_spill();
+            take(other);
+        }
+        return *this;
+    }
+
+    SmallBuffer& operator=(std::initializer_list<T> init) {
+        clear();
+        append(init.begin(), init.size());
+        return *this;
+    }
+
+    ~SmallBuffer() {
+        free_spill();
+    }
+
+    size_t size() const { return count; }
+    size_t capacity() const { return cap; }
+    bool empty() const { return count == 0; }
+    bool is_inline() const { return items == inline_items; }
+
+    T* data() { return items; }
+    const T* data() const { return items; }
+    T* begin() { return items; }
+    T* end() { return items + count; }
+    const T* begin() const { return items; }
+    const T* end() const { return items + count; }
+
+    T& operator[](size_t i) { return items[i]; }
+    const T& operator[](size_t i) const { return items[i]; }
+    T& front() { return items[0]; }
+    const T& front() const { return items[0]; }
+    T& back() { return items[count - 1]; }
+    const T& back() const { return items[count - 1]; }
+
+    void clear() { count = 0; }
+
+    void reserve(size_t new_cap) {
+        if (new_cap <= cap) {
+            return;
+        }
+        T* block = SpillArena<T>::acquire(new_cap);
+        std::memcpy(static_cast<void*>(block), items, count * sizeof(T));
+        if (!is_inline()) {
+            SpillArena<T>::release(items, cap);
+        }
+        items = block;
+        cap = new_cap;
+    }
+
+    void push_back(const T& item) {
+        if (count == cap) {
+            reserve(cap * 2);
+        }
+        items[count++] = item;
+    }
+
+    void append(const T* first, size_t n) {
+        if (count + n > cap) {
+            reserve(std::max(count + n, cap * 2));
+        }
+        std::memcpy(static_cast<void*>(items + count), first, n * sizeof(T));
+        count += n;
+    }
+
+private:
+    T* items = inline_items;
+    size_t count = 0;
+    size_t cap = N;
+    T inline_items[N];
+
+    void free_spill() {
+        if (!is_inline()) {
+            SpillArena<T>::release(items, cap);
+            items = inline_items;
+            cap = N;
+        }
+        count = 0;
+    }
+
+    // Assumes this buffer is empty and inline
+    void take(SmallBuffer& other) {
+        if (other.is_inline()) {
+            std::memcpy(static_cast<void*>(inline_items), other.inline_items, other.count * sizeof(T));
+        }
+        else {
+            items = other.items;
+            cap = other.cap;
+            other.items = other.inline_items;
+            other.cap = N;
+        }
+        count = other.count;
+        other.count = 0;
+    }
+};
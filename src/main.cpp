@@ -86,11 +86,11 @@ int main(int argc, char* argv[]) {
     //     std::make_unique<PointLight>(Point(-10, 10, -10), Color(1, 1, 1));
 
     // // World
-    // w.objects.emplace(wall, std::move(wall_u));
-    // w.objects.emplace(floor, std::move(floor_u));
-    // // w.objects.emplace(water, std::move(water_u));
-    // // w.objects.emplace(sphere, std::move(sphere_u));
-    // // w.objects.emplace(inner_sphere, std::move(inner_sphere_u));
+    // w.add_object(std::move(wall_u));
+    // w.add_object(std::move(floor_u));
+    // // w.add_object(std::move(water_u));
+    // // w.add_object(std::move(sphere_u));
+    // // w.add_object(std::move(inner_sphere_u));
     // w.light = std::move(light_u);
 
     auto light_u = std::make_unique<PointLight>(Point(2, 2.5, -5), Color(.9, .9, .9));
@@ -131,9 +131,9 @@ int main(int argc, char* argv[]) {
     cylinder->material.shininess = 300;
 
 
-    w.objects.emplace(floor, std::move(floor_u));
-    w.objects.emplace(cone, std::move(cone_u));
-    // w.objects.emplace(cylinder, std::move(cylinder_u));
+    w.add_object(std::move(floor_u));
+    w.add_object(std::move(cone_u));
+    // w.add_object(std::move(cylinder_u));
     w.light = std::move(light_u);
 
     // Camera
@@ -142,12 +142,12 @@ int main(int argc, char* argv[]) {
         Point(1, 2, -5), Point(0, 0, 0), Vector(0, 1, 0));
 
     // Rendering
-    auto canvas = camera.render(&w);
+    auto canvas = camera.render_parallel(&w);
 
-    std::string ppm_data = canvas.to_ppm();
-    std::ofstream outputFile("output.ppm");
-    assert(outputFile.is_open());
-    outputFile << ppm_data;
+    if (!canvas.save_ppm("output.ppm")) {
+        std::cerr << "Failed to write output.ppm\n";
+        return 1;
+    }
     return 0;
 }
 
@@ -169,8 +169,8 @@ void build_refractive_world(World* w) {
         std::make_unique<PointLight>(Point(-10, 10, -10), Color(1, 1, 1));
 
     // World
-    w->objects.emplace(wall, std::move(wall_u));
-    w->objects.emplace(sphere, std::move(sphere_u));
+    w->add_object(std::move(wall_u));
+    w->add_object(std::move(sphere_u));
     w->light = std::move(light_u);
 }
 
@@ -220,11 +220,11 @@ void build_reflective_world(World* w) {
         std::make_unique<PointLight>(Point(-10, 10, -10), Color(1, 1, 1));
 
     // World
-    // w->objects.emplace(floor, std::move(floor_u));
-    w->objects.emplace(back_wall, std::move(back_wall_u));
-    w->objects.emplace(middle_s, std::move(middle_s_u));
-    // w->objects.emplace(right_s, std::move(right_s_u));
-    // w->objects.emplace(left_s, std::move(left_s_u));
+    // w->add_object(std::move(floor_u));
+    w->add_object(std::move(back_wall_u));
+    w->add_object(std::move(middle_s_u));
+    // w->add_object(std::move(right_s_u));
+    // w->add_object(std::move(left_s_u));
     w->light = std::move(light_u);
 }
 
@@ -294,11 +294,11 @@ void build_patterns_world(World* w) {
         std::make_unique<PointLight>(Point(-10, 10, -10), Color(1, 1, 1));
 
     // World
-    w->objects.emplace(floor, std::move(floor_u));
-    w->objects.emplace(back_wall, std::move(back_wall_u));
-    // w.objects.emplace(right_wall, std::move(right_wall_u));
-    w->objects.emplace(middle_s, std::move(middle_s_u));
-    w->objects.emplace(right_s, std::move(right_s_u));
-    w->objects.emplace(left_s, std::move(left_s_u));
+    w->add_object(std::move(floor_u));
+    w->add_object(std::move(back_wall_u));
+    // w.add_object(std::move(right_wall_u));
+    w->add_object(std::move(middle_s_u));
+    w->add_object(std::move(right_s_u));
+    w->add_object(std::move(left_s_u));
     w->light = std::move(light_u);
 }
\ No newline at end of file
@@ -0,0 +1,40 @@
+#include "mapped_file.hpp"
+
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const char* filename) {
+    int fd = ::open(filename, O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open file: " + std::string(filename) + "\n");
+    }
+
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Failed to stat file: " + std::string(filename) + "\n");
+    }
+    size = info.st_size;
+    if (size == 0) { // mmap rejects empty mappings
+        ::close(fd);
+        return;
+    }
+
+    void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // the mapping keeps its own reference
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("Failed to map file: " + std::string(filename) + "\n");
+    }
+    ::madvise(mapping, size, MADV_SEQUENTIAL);
+    data = static_cast<const char*>(mapping);
+}
+
+MappedFile::~MappedFile() {
+    if (data) {
+        ::munmap(const_cast<char*>(data), size);
+    }
+}
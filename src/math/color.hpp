@@ -4,11 +4,11 @@
 #include "util.hpp"
 
 struct Color {
-    double r;
-    double g;
-    double b;
+    real r;
+    real g;
+    real b;
 
-    Color(double r, double g, double b) : r(r), g(g), b(b) {}
+    Color(real r, real g, real b) : r(r), g(g), b(b) {}
     // Book says don't clamp yet as will go through transformations
     // Tuple(std::clamp(r, 0.f, 1.f), std::clamp(g, 0.f, 1.f), std::clamp(b,
     // 0.f, 1.f)) {}
@@ -26,7 +26,7 @@ struct Color {
         return Color(r - other.r, g - other.g, b - other.b);
     }
 
-    Color operator*(double c) const { return Color(r * c, g * c, b * c); }
+    Color operator*(real c) const { return Color(r * c, g * c, b * c); }
 
     Color operator*(const Color& other) const {
         return Color(r * other.r, g * other.g, b * other.b);
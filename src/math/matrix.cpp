@@ -4,6 +4,8 @@
 #include <format>
 #include <iostream>
 
+Matrix::Matrix(const Matrix4& m) : data(m.data.begin(), m.data.end()), rows(4), cols(4) {}
+
 int Matrix::coords_to_index(int i, int j) const {
     assert(j < cols && j >= 0 && "invalid column index");
     assert(i < rows && i >= 0 && "invalid row index");
@@ -42,7 +44,7 @@ Matrix Matrix::transpose() const {
     return transpose;
 }
 
-double Matrix::determinant() const {
+real Matrix::determinant() const {
     // if (rows != cols) {
     //     throw std::invalid_argument("cannot find determinant of non-square matrix");
     // }
@@ -76,21 +78,21 @@ Matrix Matrix::submatrix(size_t remove_row, size_t remove_col) const {
     return submatrix;
 }
 
-double Matrix::minor(size_t i, size_t j) const {
+real Matrix::minor(size_t i, size_t j) const {
     Matrix submatrix = this->submatrix(i, j);
     return submatrix.determinant();
 }
 
-double Matrix::cofactor(size_t i, size_t j) const {
+real Matrix::cofactor(size_t i, size_t j) const {
     double minor = this->minor(i, j);
     return (i + j) % 2 == 0 ? minor : -minor;
 }
 
 Matrix Matrix::inverse() const {
-    assert(this->is_invertible() && "matrix not invertible");
+    double det = this->determinant();
+    assert(det != 0 && "matrix not invertible");
     Matrix M2(rows, cols);
 
-    double det = this->determinant();
     for (size_t i = 0; i < rows; i++) {
         for (size_t j = 0; j < cols; j++) {
             double c = this->cofactor(i, j);
@@ -98,4 +100,154 @@ Matrix Matrix::inverse() const {
         }
     }
     return M2;
-}
\ No newline at end of file
+}
+
+Matrix4::Matrix4(const Matrix& m) {
+    assert(m.rows == 4 && m.cols == 4 && "Matrix4 must be built from a 4x4 matrix");
+    std::copy(m.data.begin(), m.data.end(), data.begin());
+}
+
+bool Matrix4::operator==(const Matrix& other) const {
+    if (other.rows != 4 || other.cols != 4) {
+        return false;
+    }
+    for (size_t i = 0; i < 16; i++) {
+        if (!double_equal(data[i], other.data[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+Matrix4 Matrix4::transpose() const {
+    Matrix4 transpose;
+    for (size_t i = 0; i < 4; i++) {
+        for (size_t j = 0; j < 4; j++) {
+            transpose(j, i) = (*this)(i, j);
+        }
+    }
+    return transpose;
+}
+
+namespace {
+    // Cofactors are accumulated in double even when real is float, where
+    // cancellation would otherwise cost most of the inverse's precision
+    std::array<double, 16> widened(const std::array<real, 16>& data) {
+        std::array<double, 16> a;
+        for (size_t i = 0; i < 16; i++) {
+            a[i] = data[i];
+        }
+        return a;
+    }
+}
+
+// Laplace expansion along the first two rows: six 2x2 determinants from the
+// top half (s*) and six from the bottom half (c*)
+real Matrix4::determinant() const {
+    const auto a = widened(data);
+    double s0 = a[0] * a[5] - a[4] * a[1];
+    double s1 = a[0] * a[6] - a[4] * a[2];
+    double s2 = a[0] * a[7] - a[4] * a[3];
+    double s3 = a[1] * a[6] - a[5] * a[2];
+    double s4 = a[1] * a[7] - a[5] * a[3];
+    double s5 = a[2] * a[7] - a[6] * a[3];
+
+    double c5 = a[10] * a[15] - a[14] * a[11];
+    double c4 = a[9] * a[15] - a[13] * a[11];
+    double c3 = a[9] * a[14] - a[13] * a[10];
+    double c2 = a[8] * a[15] - a[12] * a[11];
+    double c1 = a[8] * a[14] - a[12] * a[10];
+    double c0 = a[8] * a[13] - a[12] * a[9];
+
+    return s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+}
+
+std::optional<Matrix4> Matrix4::general_inverse() const {
+    const auto a = widened(data);
+    double s0 = a[0] * a[5] - a[4] * a[1];
+    double s1 = a[0] * a[6] - a[4] * a[2];
+    double s2 = a[0] * a[7] - a[4] * a[3];
+    double s3 = a[1] * a[6] - a[5] * a[2];
+    double s4 = a[1] * a[7] - a[5] * a[3];
+    double s5 = a[2] * a[7] - a[6] * a[3];
+
+    double c5 = a[10] * a[15] - a[14] * a[11];
+    double c4 = a[9] * a[15] - a[13] * a[11];
+    double c3 = a[9] * a[14] - a[13] * a[10];
+    double c2 = a[8] * a[15] - a[12] * a[11];
+    double c1 = a[8] * a[14] - a[12] * a[10];
+    double c0 = a[8] * a[13] - a[12] * a[9];
+
+    double det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+    if (det == 0) {
+        return std::nullopt;
+    }
+    double inv_det = 1 / det;
+
+    Matrix4 inv;
+    auto& b = inv.data;
+    b[0] = (a[5] * c5 - a[6] * c4 + a[7] * c3) * inv_det;
+    b[1] = (-a[1] * c5 + a[2] * c4 - a[3] * c3) * inv_det;
+    b[2] = (a[13] * s5 - a[14] * s4 + a[15] * s3) * inv_det;
+    b[3] = (-a[9] * s5 + a[10] * s4 - a[11] * s3) * inv_det;
+
+    b[4] = (-a[4] * c5 + a[6] * c2 - a[7] * c1) * inv_det;
+    b[5] = (a[0] * c5 - a[2] * c2 + a[3] * c1) * inv_det;
+    b[6] = (-a[12] * s5 + a[14] * s2 - a[15] * s1) * inv_det;
+    b[7] = (a[8] * s5 - a[10] * s2 + a[11] * s1) * inv_det;
+
+    b[8] = (a[4] * c4 - a[5] * c2 + a[7] * c0) * inv_det;
+    b[9] = (-a[0] * c4 + a[1] * c2 - a[3] * c0) * inv_det;
+    b[10] = (a[12] * s4 - a[13] * s2 + a[15] * s0) * inv_det;
+    b[11] = (-a[8] * s4 + a[9] * s2 - a[11] * s0) * inv_det;
+
+    b[12] = (-a[4] * c3 + a[5] * c1 - a[6] * c0) * inv_det;
+    b[13] = (a[0] * c3 - a[1] * c1 + a[2] * c0) * inv_det;
+    b[14] = (-a[12] * s3 + a[13] * s1 - a[14] * s0) * inv_det;
+    b[15] = (a[8] * s3 - a[9] * s1 + a[10] * s0) * inv_det;
+    return inv;
+}
+
+// [R t; 0 1]^-1 = [R^-1  -R^-1 t; 0 1], only a 3x3 inverse needed
+std::optional<Matrix4> Matrix4::affine_inverse() const {
+    const auto a = widened(data);
+    double c00 = a[5] * a[10] - a[6] * a[9];
+    double c01 = a[6] * a[8] - a[4] * a[10];
+    double c02 = a[4] * a[9] - a[5] * a[8];
+
+    double det = a[0] * c00 + a[1] * c01 + a[2] * c02;
+    if (det == 0) {
+        return std::nullopt;
+    }
+    double inv_det = 1 / det;
+
+    Matrix4 inv;
+    auto& b = inv.data;
+    b[0] = c00 * inv_det;
+    b[1] = (a[2] * a[9] - a[1] * a[10]) * inv_det;
+    b[2] = (a[1] * a[6] - a[2] * a[5]) * inv_det;
+
+    b[4] = c01 * inv_det;
+    b[5] = (a[0] * a[10] - a[2] * a[8]) * inv_det;
+    b[6] = (a[2] * a[4] - a[0] * a[6]) * inv_det;
+
+    b[8] = c02 * inv_det;
+    b[9] = (a[1] * a[8] - a[0] * a[9]) * inv_det;
+    b[10] = (a[0] * a[5] - a[1] * a[4]) * inv_det;
+
+    b[3] = -(b[0] * a[3] + b[1] * a[7] + b[2] * a[11]);
+    b[7] = -(b[4] * a[3] + b[5] * a[7] + b[6] * a[11]);
+    b[11] = -(b[8] * a[3] + b[9] * a[7] + b[10] * a[11]);
+    b[15] = 1;
+    return inv;
+}
+
+std::optional<Matrix4> Matrix4::try_inverse() const {
+    return is_affine() ? affine_inverse() : general_inverse();
+}
+
+Matrix4 Matrix4::inverse() const {
+    auto inv = try_inverse();
+    assert(inv.has_value() && "matrix not invertible");
+    return inv.value();
+}
@@ -1,6 +1,8 @@
 #ifndef MATRIX_HPP
 #define MATRIX_HPP
 
+#include <array>
+#include <optional>
 #include <vector>
 
 #include "tuples.hpp"
@@ -8,17 +10,22 @@
 template <typename T>
 concept TupleType = std::is_base_of_v<Tuple, T>;
 
+struct Matrix4;
+
+// General-size matrix used by the book's submatrix/cofactor tests. Anything on
+// the render path should use Matrix4 instead (no heap allocation)
 struct Matrix {
-    std::vector<double> data;
+    std::vector<real> data;
     size_t rows;
     size_t cols;
 
     Matrix(int i, int j) : cols(j), rows(i), data(i* j, 0) {}
+    Matrix(const Matrix4& m);
     // what is the most efficient
 
     int coords_to_index(int i, int j) const;
 
-    Matrix& operator=(std::initializer_list<double> values) {
+    Matrix& operator=(std::initializer_list<real> values) {
         if (values.size() != rows * cols)
             throw std::runtime_error(
                 "Initializer list size does not match matrix size");
@@ -26,8 +33,8 @@ struct Matrix {
         return *this;
     }
 
-    double operator()(int i, int j) const { return data[coords_to_index(i, j)]; }
-    double& operator()(int i, int j) { return data[coords_to_index(i, j)]; }
+    real operator()(int i, int j) const { return data[coords_to_index(i, j)]; }
+    real& operator()(int i, int j) { return data[coords_to_index(i, j)]; }
 
     // Faster methods: hash and compare, memcmp w/ vectors
     bool operator==(const Matrix& other) const {
@@ -52,10 +59,10 @@ struct Matrix {
     // } 
 
     Matrix transpose() const;
-    double determinant() const;
+    real determinant() const;
     Matrix submatrix(size_t remove_row, size_t remove_col) const;
-    double minor(size_t i, size_t j) const;
-    double cofactor(size_t i, size_t j) const;
+    real minor(size_t i, size_t j) const;
+    real cofactor(size_t i, size_t j) const;
 
     // Not the most efficient as will require calc determinant twice. Either
     // return det or accept cause book
@@ -70,4 +77,88 @@ inline const Matrix identity_matrix4 = [] {
     return id;
     }();
 
+// Fixed-size 4x4 matrix with inline (stack) storage. Multiply and tuple
+// kernels are unrolled and live in the header so they can be inlined
+struct Matrix4 {
+    std::array<real, 16> data;
+
+    Matrix4() : data{} {}
+    explicit Matrix4(const Matrix& m);
+
+    static Matrix4 identity() {
+        Matrix4 id;
+        id.data = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+        return id;
+    }
+
+    Matrix4& operator=(std::initializer_list<real> values) {
+        if (values.size() != 16)
+            throw std::runtime_error(
+                "Initializer list size does not match matrix size");
+        std::copy(values.begin(), values.end(), data.begin());
+        return *this;
+    }
+
+    real operator()(int i, int j) const { return data[i * 4 + j]; }
+    real& operator()(int i, int j) { return data[i * 4 + j]; }
+
+    bool operator==(const Matrix4& other) const {
+        for (size_t i = 0; i < 16; i++) {
+            if (!double_equal(data[i], other.data[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+    bool operator==(const Matrix& other) const;
+
+    Matrix4 operator*(const Matrix4& other) const {
+        const auto& a = data;
+        const auto& b = other.data;
+        Matrix4 m;
+        for (size_t i = 0; i < 16; i += 4) {
+            m.data[i + 0] = a[i] * b[0] + a[i + 1] * b[4] + a[i + 2] * b[8] + a[i + 3] * b[12];
+            m.data[i + 1] = a[i] * b[1] + a[i + 1] * b[5] + a[i + 2] * b[9] + a[i + 3] * b[13];
+            m.data[i + 2] = a[i] * b[2] + a[i + 1] * b[6] + a[i + 2] * b[10] + a[i + 3] * b[14];
+            m.data[i + 3] = a[i] * b[3] + a[i + 1] * b[7] + a[i + 2] * b[11] + a[i + 3] * b[15];
+        }
+        return m;
+    }
+
+    // Note: Tuple is always a 4x1 in our definition
+    Tuple operator*(const Tuple& t) const {
+        const auto& a = data;
+        return Tuple(a[0] * t.x + a[1] * t.y + a[2] * t.z + a[3] * t.w,
+            a[4] * t.x + a[5] * t.y + a[6] * t.z + a[7] * t.w,
+            a[8] * t.x + a[9] * t.y + a[10] * t.z + a[11] * t.w,
+            a[12] * t.x + a[13] * t.y + a[14] * t.z + a[15] * t.w);
+    }
+
+    // transpose() * t, without building the transpose
+    Tuple transpose_multiply(const Tuple& t) const {
+        const auto& a = data;
+        return Tuple(a[0] * t.x + a[4] * t.y + a[8] * t.z + a[12] * t.w,
+            a[1] * t.x + a[5] * t.y + a[9] * t.z + a[13] * t.w,
+            a[2] * t.x + a[6] * t.y + a[10] * t.z + a[14] * t.w,
+            a[3] * t.x + a[7] * t.y + a[11] * t.z + a[15] * t.w);
+    }
+
+    Matrix4 transpose() const;
+    real determinant() const;
+    bool is_invertible() const { return this->determinant() != 0; }
+    // Last row is (0, 0, 0, 1), i.e. every transform the book builds
+    bool is_affine() const {
+        return data[12] == 0 && data[13] == 0 && data[14] == 0 && data[15] == 1;
+    }
+
+    // Closed-form inverse (2x2 sub-determinants, or 3x3 + translation when
+    // affine). Returns nullopt if singular, so callers needn't check first
+    std::optional<Matrix4> try_inverse() const;
+    Matrix4 inverse() const;
+
+private:
+    std::optional<Matrix4> general_inverse() const;
+    std::optional<Matrix4> affine_inverse() const;
+};
+
 #endif
\ No newline at end of file
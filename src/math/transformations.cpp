@@ -1,58 +1,80 @@
 #include "transformations.hpp"
 
-Transform Transform::translation(double x, double y, double z) {
-    Transform translation;
+#include <atomic>
+
+uint64_t Transform::next_id() {
+    static std::atomic<uint64_t> counter = 1;
+    return counter++;
+}
+
+// Factories build the inverse alongside the matrix as it is known in closed form
+Transform Transform::translation(real x, real y, real z) {
+    Matrix4 translation = Matrix4::identity();
     translation(0, 3) = x;
     translation(1, 3) = y;
     translation(2, 3) = z;
-    return translation;
+
+    Matrix4 inv = Matrix4::identity();
+    inv(0, 3) = -x;
+    inv(1, 3) = -y;
+    inv(2, 3) = -z;
+    return Transform(translation, inv);
 }
 
-Transform Transform::scaling(double x, double y, double z) {
-    Transform scaling;
+Transform Transform::scaling(real x, real y, real z) {
+    Matrix4 scaling = Matrix4::identity();
     scaling(0, 0) = x;
     scaling(1, 1) = y;
     scaling(2, 2) = z;
-    return scaling;
+    if (x == 0 || y == 0 || z == 0) { // degenerate, no inverse
+        return Transform(scaling);
+    }
+
+    Matrix4 inv = Matrix4::identity();
+    inv(0, 0) = 1 / x;
+    inv(1, 1) = 1 / y;
+    inv(2, 2) = 1 / z;
+    return Transform(scaling, inv);
 }
 
-Transform Transform::rotation_x(double rad) {
-    Transform rotation_x;
+// Rotations are orthonormal: inverse == transpose
+Transform Transform::rotation_x(real rad) {
+    Matrix4 rotation_x = Matrix4::identity();
     rotation_x(1, 1) = cos(rad);
     rotation_x(1, 2) = -sin(rad);
     rotation_x(2, 1) = sin(rad);
     rotation_x(2, 2) = cos(rad);
-    return rotation_x;
+    return Transform(rotation_x, rotation_x.transpose());
 }
 
-Transform Transform::rotation_y(double rad) {
-    Transform rotation_y;
+Transform Transform::rotation_y(real rad) {
+    Matrix4 rotation_y = Matrix4::identity();
     rotation_y(0, 0) = cos(rad);
     rotation_y(0, 2) = sin(rad);
     rotation_y(2, 0) = -sin(rad);
     rotation_y(2, 2) = cos(rad);
-    return rotation_y;
+    return Transform(rotation_y, rotation_y.transpose());
 }
 
-Transform Transform::rotation_z(double rad) {
-    Transform rotation_z;
+Transform Transform::rotation_z(real rad) {
+    Matrix4 rotation_z = Matrix4::identity();
     rotation_z(0, 0) = cos(rad);
     rotation_z(0, 1) = -sin(rad);
     rotation_z(1, 0) = sin(rad);
     rotation_z(1, 1) = cos(rad);
-    return rotation_z;
+    return Transform(rotation_z, rotation_z.transpose());
 }
 
-Transform Transform::shearing(double x_y, double x_z, double y_x, double y_z,
-    double z_x, double z_y) {
-    Transform shearing;
+Transform Transform::shearing(real x_y, real x_z, real y_x, real y_z,
+    real z_x, real z_y) {
+    Matrix4 shearing = Matrix4::identity();
     shearing(0, 1) = x_y;
     shearing(0, 2) = x_z;
     shearing(1, 0) = y_x;
     shearing(1, 2) = y_z;
     shearing(0, 2) = z_x;
     shearing(2, 1) = z_y;
-    return shearing;
+    return Transform(shearing);
 }
 
 Transform Transform::view_transform(Point from, Point to, Vector up) {
@@ -60,10 +82,10 @@ Transform Transform::view_transform(Point from, Point to, Vector up) {
     Vector left = forward.cross(up.normalized());
     Vector true_up = left.cross(forward);
 
-    Matrix orientation(4, 4);
+    Matrix4 orientation;
     orientation = { left.x,     left.y,     left.z,     0,
                    true_up.x,  true_up.y,  true_up.z,  0,
                    -forward.x, -forward.y, -forward.z, 0,
                    0,          0,          0,          1 };
-    return Transform(orientation * translation(-from.x, -from.y, -from.z));
-}
\ No newline at end of file
+    return Transform(orientation) * translation(-from.x, -from.y, -from.z);
+}
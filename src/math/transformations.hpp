@@ -1,33 +1,94 @@
 #pragma once
 
-#include <cassert>
+#include <cstdint>
+#include <stdexcept>
 
 #include "matrix.hpp"
 
-struct Transform final : public Matrix {
-    Transform() : Matrix(identity_matrix4) {}
+// The inverse and inverse-transpose are computed once when a Transform is
+// built, so intersection/shading code only ever looks them up
+struct Transform final : public Matrix4 {
+    Transform()
+        : Matrix4(Matrix4::identity()), inv(Matrix4::identity()),
+        inv_transpose(Matrix4::identity()) {
+    }
 
-    explicit Transform(const Matrix& m) : Matrix(m) {
-        assert(m.rows == 4 && m.cols == 4 && "Transform must be a 4x4 matrix");
+    explicit Transform(const Matrix4& m)
+        : Matrix4(m), transform_id(next_id()), identity(m.data == Matrix4::identity().data) {
+        update_inverse();
     }
+    explicit Transform(const Matrix& m) : Transform(Matrix4(m)) {}
+
+    // Read-only element access: writing through would leave the cache stale
+    real operator()(int i, int j) const { return Matrix4::operator()(i, j); }
 
-    Transform inverse() const { return Transform(Matrix::inverse()); }
-    using Matrix::operator*;  // expose overload
+    // Unique to each newly built matrix and kept by copies, so caches derived
+    // from a transform can tell whether it has been replaced. 0 for the default
+    // identity
+    uint64_t id() const { return transform_id; }
+    // Exactly the identity, so applying it can be skipped
+    bool is_identity() const { return identity; }
+
+    // Singular transforms (e.g. a zero scale) flatten a shape to nothing;
+    // their inverses throw
+    bool is_invertible() const { return invertible; }
+    const Matrix4& inverse_matrix() const {
+        check_invertible();
+        return inv;
+    }
+    const Matrix4& inverse_transpose_matrix() const {
+        check_invertible();
+        return inv_transpose;
+    }
+
+    Transform inverse() const { return Transform(inverse_matrix(), *this); }
+    using Matrix4::operator*;  // expose overload
+    // (AB)^-1 = B^-1 A^-1, so composing never needs a fresh inversion. A
+    // product with a singular factor is singular too
     Transform operator*(const Transform& other) const {
-        return Transform(Matrix::operator*(other));
+        return Transform(Matrix4::operator*(other), other.inv * inv, invertible && other.invertible);
     }
 
-    static Transform translation(double x, double y, double z);
+    static Transform translation(real x, real y, real z);
 
-    static Transform scaling(double x, double y, double z);
+    static Transform scaling(real x, real y, real z);
 
-    static Transform rotation_x(double rad);
-    static Transform rotation_y(double rad);
-    static Transform rotation_z(double rad);
+    static Transform rotation_x(real rad);
+    static Transform rotation_y(real rad);
+    static Transform rotation_z(real rad);
 
-    static Transform shearing(double x_y, double x_z, double y_x, double y_z,
-        double z_x, double z_y);
+    static Transform shearing(real x_y, real x_z, real y_x, real y_z,
+        real z_x, real z_y);
 
     // TODO: what does step 3 mean? (pg 99)
     static Transform view_transform(Point from, Point to, Vector up);
-};
\ No newline at end of file
+
+private:
+    Matrix4 inv;
+    Matrix4 inv_transpose;
+    bool invertible = true;
+    uint64_t transform_id = 0;
+    bool identity = true;
+
+    Transform(const Matrix4& m, const Matrix4& m_inv, bool invertible = true)
+        : Matrix4(m), inv(m_inv), inv_transpose(m_inv.transpose()), invertible(invertible),
+        transform_id(next_id()), identity(m.data == Matrix4::identity().data) {
+    }
+
+    static uint64_t next_id();
+
+    void check_invertible() const {
+        if (!invertible) {
+            throw std::runtime_error("Transform is not invertible\n");
+        }
+    }
+
+    void update_inverse() {
+        auto m_inv = try_inverse();
+        invertible = m_inv.has_value();
+        if (invertible) {
+            inv = m_inv.value();
+            inv_transpose = inv.transpose();
+        }
+    }
+};
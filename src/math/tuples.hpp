@@ -12,12 +12,12 @@ struct Point;
 struct Vector;
 
 struct Tuple {
-    double x;
-    double y;
-    double z;
-    double w;
+    real x;
+    real y;
+    real z;
+    real w;
 
-    Tuple(double x, double y, double z, double w) : x(x), y(y), z(z), w(w) {}
+    Tuple(real x, real y, real z, real w) : x(x), y(y), z(z), w(w) {}
 
     bool is_point() const { return double_equal(w, 1.0); }
     bool is_vector() const { return double_equal(w, 0.0); }
@@ -42,29 +42,29 @@ struct Tuple {
         return Tuple(x - other.x, y - other.y, z - other.z, w - other.w);
     }
 
-    Tuple operator*(const double c) const {
+    Tuple operator*(const real c) const {
         return Tuple(x * c, y * c, z * c, w * c);
     }
 
-    Tuple operator/(const double c) const {
+    Tuple operator/(const real c) const {
         return Tuple(x / c, y / c, z / c, w / c);
     }
 };
 
-inline Tuple operator*(const double c, const Tuple& tuple) {
+inline Tuple operator*(const real c, const Tuple& tuple) {
     return Tuple(tuple.x * c, tuple.y * c, tuple.z * c, tuple.w * c);
 }
 
 // TODO: should include overloads for operator* and operator/???
 struct Point : public Tuple {
     Point() : Tuple(0, 0, 0, 1) {}
-    Point(double x, double y, double z) : Tuple(x, y, z, 1.0) {}
+    Point(real x, real y, real z) : Tuple(x, y, z, 1.0) {}
     // explicit Point(const Tuple& t) : Tuple(t.x, t.y, t.z, 1) {}
 };
 
 struct Vector : public Tuple {
     Vector() : Tuple(0, 0, 0, 0) {}
-    Vector(double x, double y, double z) : Tuple(x, y, z, 0.0) {}
+    Vector(real x, real y, real z) : Tuple(x, y, z, 0.0) {}
     // explicit Vector(const Tuple& t) : Tuple(t.x, t.y, t.z, 0) {}
 
     using Tuple::operator-;
@@ -73,18 +73,18 @@ struct Vector : public Tuple {
         return Vector(-x, -y, -z);
     }
 
-    double magnitude() const {
+    real magnitude() const {
         return sqrt(pow(x, 2) + pow(y, 2) + pow(z, 2) + pow(w, 2));
     }
 
     Vector normalized() const {
-        double magnitude = this->magnitude();
+        real magnitude = this->magnitude();
         if (double_equal(magnitude,0)) return *this;
         return Vector(x / magnitude, y / magnitude, z / magnitude);
     }
 
     // Gives angle relationship between. 1 = same dir, -1 = opp dir, 0 = 90°
-    double dot(const Vector& other) const {
+    real dot(const Vector& other) const {
         return x * other.x + y * other.y + z * other.z;
     }
 
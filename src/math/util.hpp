@@ -2,11 +2,24 @@
 #define UTIL_HPP
 
 #include <cmath>
+#include <limits>
 
-const double EPSILON = 0.0001;
-const double MIN_DOUBLE = std::numeric_limits<double>::lowest();
-const double MAX_DOUBLE = std::numeric_limits<double>::max();
+// Scalar of every geometric and shading type. Builds default to double (the
+// tests are written against it); RAYTRACER_FLOAT renders in single precision
+#ifdef RAYTRACER_FLOAT
+using real = float;
+// float keeps ~7 significant digits, so comparisons and surface offsets
+// (scaled by the hit point's magnitude) need a wider margin
+const real EPSILON = 0.001f;
+#else
+using real = double;
+const real EPSILON = 0.0001;
+#endif
 
-inline bool double_equal(double a, double b) { return std::fabs(a - b) < EPSILON; }
+// Largest finite reals, used for unbounded boxes
+const real MIN_DOUBLE = std::numeric_limits<real>::lowest();
+const real MAX_DOUBLE = std::numeric_limits<real>::max();
 
-#endif
\ No newline at end of file
+inline bool double_equal(real a, real b) { return std::fabs(a - b) < EPSILON; }
+
+#endif
@@ -6,14 +6,18 @@
 struct Camera {
     size_t hsize;
     size_t vsize;
-    double fov;
+    real fov;
     Transform transform;
-    double pixel_size;
-    double half_width;
-    double half_height;
+    real pixel_size;
+    real half_width;
+    real half_height;
 
-    Camera(size_t hsize, size_t vsize, double fov);
+    Camera(size_t hsize, size_t vsize, real fov);
 
     Ray ray_for_pixel(size_t px, size_t py) const;
     Canvas render(const World* w) const;
+    // Tile-based multithreaded render, same output as render().
+    // 0 threads = hardware concurrency
+    Canvas render_parallel(const World* w, size_t num_threads = 0,
+        size_t tile_size = 16) const;
 };
\ No newline at end of file
@@ -0,0 +1,130 @@
+#include "thread_pool.hpp"
+
+namespace {
+    // Index of the pool worker running on this thread, if any
+    thread_local const ThreadPool* current_pool = nullptr;
+    thread_local size_t current_worker = 0;
+}
+
+size_t ThreadPool::default_thread_count() {
+    size_t n = std::thread::hardware_concurrency();
+    return n == 0 ? 1 : n;
+}
+
+ThreadPool::ThreadPool(size_t num_threads)
+    : pending(0), queued(0), next_queue(0), stopping(false) {
+    if (num_threads == 0) {
+        num_threads = default_thread_count();
+    }
+    for (size_t i = 0; i < num_threads; i++) {
+        queues.push_back(std::make_unique<WorkQueue>());
+    }
+    for (size_t i = 0; i < num_threads; i++) {
+        workers.emplace_back([this, i] { worker_loop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    wait_idle();
+    {
+        std::lock_guard guard(sleep_lock);
+        stopping = true;
+    }
+    work_available.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    size_t index = current_pool == this
+        ? current_worker
+        : next_queue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+    pending.fetch_add(1);
+    {
+        std::lock_guard guard(queues[index]->lock);
+        queues[index]->tasks.push_back(std::move(task));
+        queued.fetch_add(1);
+    }
+    {
+        // Lock so a worker can't miss the wakeup between checking and sleeping
+        std::lock_guard guard(sleep_lock);
+    }
+    work_available.notify_one();
+}
+
+// Own queue from the back, then steal from the front of the others
+bool ThreadPool::pop_task(size_t preferred, std::function<void()>& task) {
+    {
+        auto& own = *queues[preferred];
+        std::lock_guard guard(own.lock);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+    for (size_t offset = 1; offset < queues.size(); offset++) {
+        auto& victim = *queues[(preferred + offset) % queues.size()];
+        std::lock_guard guard(victim.lock);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::finish_task() {
+    if (pending.fetch_sub(1) == 1) {
+        std::lock_guard guard(sleep_lock);
+        all_done.notify_all();
+    }
+}
+
+bool ThreadPool::run_pending_task() {
+    size_t preferred = current_pool == this ? current_worker : 0;
+    std::function<void()> task;
+    if (!pop_task(preferred, task)) {
+        return false;
+    }
+    task();
+    finish_task();
+    return true;
+}
+
+void ThreadPool::wait_idle() {
+    while (pending.load() > 0) {
+        if (run_pending_task()) {
+            continue;
+        }
+        std::unique_lock guard(sleep_lock);
+        all_done.wait(guard, [this] { return pending.load() == 0; });
+    }
+}
+
+void ThreadPool::worker_loop(size_t index) {
+    current_pool = this;
+    current_worker = index;
+    while (true) {
+        std::function<void()> task;
+        if (pop_task(index, task)) {
+            task();
+            finish_task();
+            continue;
+        }
+
+        // Checked under the lock so a submit between pop_task and here can't
+        // be missed
+        std::unique_lock guard(sleep_lock);
+        work_available.wait(guard, [this] {
+            return stopping.load() || queued.load() > 0;
+            });
+        if (stopping) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing pool: each worker owns a deque, pops its own work from the
+// back (LIFO, cache-warm) and steals from the front of other workers' deques
+// when it runs dry. Tasks submitted from inside a worker stay on that worker
+struct ThreadPool {
+public:
+    // 0 threads = std::thread::hardware_concurrency()
+    explicit ThreadPool(size_t num_threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const { return workers.size(); }
+
+    void submit(std::function<void()> task);
+
+    // Runs one queued task on the calling thread if there is one. Lets a
+    // waiting task help out instead of blocking a worker
+    bool run_pending_task();
+
+    // Blocks until every submitted task has finished (caller helps out)
+    void wait_idle();
+
+    static size_t default_thread_count();
+
+private:
+    struct WorkQueue {
+        std::mutex lock;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+
+    std::atomic<size_t> pending; // submitted but not yet finished
+    std::atomic<size_t> queued;  // submitted but not yet picked up
+    std::atomic<size_t> next_queue;
+    std::atomic<bool> stopping;
+
+    std::mutex sleep_lock;
+    std::condition_variable work_available;
+    std::condition_variable all_done;
+
+    void worker_loop(size_t index);
+    bool pop_task(size_t preferred, std::function<void()>& task);
+    void finish_task();
+};
+
+// Runs task(i) for every i below count, on the pool if there is one. The
+// first exception thrown by a task is rethrown once all of them have
+// finished. Waits for the whole pool to go idle, so the pool should be the
+// caller's own
+template <typename F>
+void for_each_chunk(ThreadPool* pool, size_t count, F&& task) {
+    if (!pool || count == 1) {
+        for (size_t i = 0; i < count; i++) {
+            task(i);
+        }
+        return;
+    }
+    std::mutex error_lock;
+    std::exception_ptr error;
+    for (size_t i = 0; i < count; i++) {
+        pool->submit([&, i] {
+            try {
+                task(i);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> guard(error_lock);
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+            });
+    }
+    pool->wait_idle();
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
@@ -0,0 +1,243 @@
+#include "compiled_scene.hpp"
+
+#include <map>
+
+namespace {
+    using Kind = CompiledScene::Kind;
+
+    struct Compiler {
+        CompiledScene& scene;
+        std::map<std::array<real, 16>, uint32_t> transform_ids;
+        std::vector<BoundingBox> bounds;  // of the bounded refs
+        std::vector<uint32_t> bounded;
+        std::vector<uint32_t> unbounded;
+
+        explicit Compiler(CompiledScene& scene) : scene(scene) {}
+
+        uint32_t transform_id(const Matrix4& m) {
+            if (m.data == Matrix4::identity().data) {
+                return 0;
+            }
+            auto [it, inserted] = transform_ids.emplace(m.data, scene.to_object.size());
+            if (inserted) {
+                scene.to_object.push_back(m);
+            }
+            return it->second;
+        }
+
+        // Planes, infinite cylinders etc. can't go in the BVH
+        void add_ref(Kind kind, size_t index, const BoundingBox& world_bounds) {
+            uint32_t ref = static_cast<uint32_t>(kind) << 28 | static_cast<uint32_t>(index);
+            if (std::isfinite(world_bounds.surface_area())) {
+                bounded.push_back(ref);
+                bounds.push_back(world_bounds);
+            }
+            else {
+                unbounded.push_back(ref);
+            }
+        }
+
+        // to_world/to_local map between world space and the space shape's
+        // transform is applied in
+        void add(const Shape* shape, const Matrix4& to_world, const Matrix4& to_local) {
+            if (!shape->transform.is_invertible()) {
+                return; // flattened to nothing, as Shape's queries treat it
+            }
+            Matrix4 object_to_world = to_world * shape->transform;
+            Matrix4 world_to_object = shape->transform.inverse_matrix() * to_local;
+
+            if (auto group = dynamic_cast<const Group*>(shape)) {
+                for (const auto& child : group->shapes) {
+                    add(child.get(), object_to_world, world_to_object);
+                }
+                return;
+            }
+
+            BoundingBox world_bounds = shape->bounds_of().transform(object_to_world);
+            uint32_t transform = transform_id(world_to_object);
+            if (auto sphere = dynamic_cast<const Sphere*>(shape)) {
+                scene.spheres.push_back({ shape, transform, sphere->origin });
+                add_ref(Kind::Sphere, scene.spheres.size() - 1, world_bounds);
+            }
+            else if (dynamic_cast<const Plane*>(shape)) {
+                scene.planes.push_back({ shape, transform });
+                add_ref(Kind::Plane, scene.planes.size() - 1, world_bounds);
+            }
+            else if (dynamic_cast<const Cube*>(shape)) {
+                scene.cubes.push_back({ shape, transform });
+                add_ref(Kind::Cube, scene.cubes.size() - 1, world_bounds);
+            }
+            else if (auto cylinder = dynamic_cast<const Cylinder*>(shape)) {
+                scene.cylinders.push_back({ shape, transform, cylinder->minimum,
+                    cylinder->maximum, cylinder->closed });
+                add_ref(Kind::Cylinder, scene.cylinders.size() - 1, world_bounds);
+            }
+            else if (auto cone = dynamic_cast<const Cone*>(shape)) {
+                scene.cones.push_back({ shape, transform, cone->minimum, cone->maximum, cone->closed });
+                add_ref(Kind::Cone, scene.cones.size() - 1, world_bounds);
+            }
+            else if (auto triangle = dynamic_cast<const Triangle*>(shape)) {
+                scene.triangles.push_back({ shape, transform, triangle->p1, triangle->e1, triangle->e2 });
+                add_ref(Kind::Triangle, scene.triangles.size() - 1, world_bounds);
+            }
+            else {
+                scene.others.push_back({ shape, transform_id(to_local) });
+                add_ref(Kind::Other, scene.others.size() - 1, world_bounds);
+            }
+        }
+    };
+}
+
+CompiledScene CompiledScene::build(const std::vector<const Shape*>& objects, const SAHOptions& options) {
+    CompiledScene scene;
+    scene.to_object.push_back(Matrix4::identity());
+    Compiler compiler(scene);
+    for (const Shape* object : objects) {
+        compiler.add(object, Matrix4::identity(), Matrix4::identity());
+    }
+
+    scene.unbounded = std::move(compiler.unbounded);
+    if (!compiler.bounded.empty()) {
+        scene.bvh = WideBVH::collapse(LinearBVH::build(compiler.bounds, options));
+        scene.refs = std::move(compiler.bounded);
+    }
+    return scene;
+}
+
+template <typename Emit>
+void CompiledScene::for_each_hit(uint32_t ref, const Ray& r, Emit&& emit) const {
+    uint32_t index = ref & INDEX_MASK;
+    switch (static_cast<Kind>(ref >> KIND_SHIFT)) {
+    case Kind::Sphere: {
+        const auto& sphere = spheres[index];
+        real t1, t2;
+        if (intersect_sphere(local_ray(sphere.transform, r), sphere.center, t1, t2)) {
+            emit(Intersection(t1, sphere.shape));
+            emit(Intersection(t2, sphere.shape));
+        }
+        break;
+    }
+    case Kind::Plane: {
+        const auto& plane = planes[index];
+        real t;
+        if (intersect_plane(local_ray(plane.transform, r), t)) {
+            emit(Intersection(t, plane.shape));
+        }
+        break;
+    }
+    case Kind::Cube: {
+        const auto& cube = cubes[index];
+        real tmin, tmax;
+        if (intersect_cube(local_ray(cube.transform, r), tmin, tmax)) {
+            emit(Intersection(tmin, cube.shape));
+            emit(Intersection(tmax, cube.shape));
+        }
+        break;
+    }
+    case Kind::Cylinder:
+    case Kind::Cone: {
+        bool is_cone = static_cast<Kind>(ref >> KIND_SHIFT) == Kind::Cone;
+        const auto& quadric = is_cone ? cones[index] : cylinders[index];
+        Ray local = local_ray(quadric.transform, r);
+        real t[4];
+        int count = is_cone
+            ? intersect_cone(local, quadric.minimum, quadric.maximum, quadric.closed, t)
+            : intersect_cylinder(local, quadric.minimum, quadric.maximum, quadric.closed, t);
+        for (int i = 0; i < count; i++) {
+            emit(Intersection(t[i], quadric.shape));
+        }
+        break;
+    }
+    case Kind::Triangle: {
+        const auto& triangle = triangles[index];
+        real t, u, v;
+        if (intersect_triangle(local_ray(triangle.transform, r), triangle.p1, triangle.e1,
+            triangle.e2, t, u, v)) {
+            emit(Intersection(t, triangle.shape, u, v));
+        }
+        break;
+    }
+    case Kind::Other:
+        break; // callers use the shape's own queries
+    }
+}
+
+IntersectionRecord CompiledScene::intersect(const Ray& r) const {
+    IntersectionRecord xs;
+    auto visit = [&](uint32_t ref) {
+        if (static_cast<Kind>(ref >> KIND_SHIFT) == Kind::Other) {
+            const auto& other = others[ref & INDEX_MASK];
+            xs.append_record(other.shape->intersect(local_ray(other.transform, r)));
+            return;
+        }
+        for_each_hit(ref, r, [&](const Intersection& i) { xs.append_record(i); });
+        };
+
+    for (uint32_t ref : unbounded) {
+        visit(ref);
+    }
+    bvh.traverse(r, [&](const uint32_t* prims, uint32_t count, real tmax) {
+        for (uint32_t i = 0; i < count; i++) {
+            visit(refs[prims[i]]);
+        }
+        return tmax;
+        });
+    return xs;
+}
+
+bool CompiledScene::occluded(const Ray& r, real tmax) const {
+    auto hits = [&](uint32_t ref) {
+        if (static_cast<Kind>(ref >> KIND_SHIFT) == Kind::Other) {
+            const auto& other = others[ref & INDEX_MASK];
+            return other.shape->occluded(local_ray(other.transform, r), tmax);
+        }
+        bool hit = false;
+        for_each_hit(ref, r, [&](const Intersection& i) { hit = hit || (i.t >= 0 && i.t < tmax); });
+        return hit;
+        };
+
+    for (uint32_t ref : unbounded) {
+        if (hits(ref)) {
+            return true;
+        }
+    }
+    bool hit = false;
+    bvh.traverse(r.clipped(0, tmax), [&](const uint32_t* prims, uint32_t count, real limit) {
+        for (uint32_t i = 0; i < count && !hit; i++) {
+            hit = hits(refs[prims[i]]);
+        }
+        return hit ? -INFINITY : limit; // culls everything left on the stack
+        });
+    return hit;
+}
+
+std::optional<Intersection> CompiledScene::intersect_closest(const Ray& r, real tmax) const {
+    std::optional<Intersection> closest;
+    auto visit = [&](uint32_t ref) {
+        if (static_cast<Kind>(ref >> KIND_SHIFT) == Kind::Other) {
+            const auto& other = others[ref & INDEX_MASK];
+            if (auto hit = other.shape->intersect_closest(local_ray(other.transform, r), tmax)) {
+                closest = hit;
+                tmax = hit->t;
+            }
+            return;
+        }
+        for_each_hit(ref, r, [&](const Intersection& i) {
+            if (i.t >= 0 && i.t < tmax) {
+                closest = i;
+                tmax = i.t;
+            }
+            });
+        };
+
+    for (uint32_t ref : unbounded) {
+        visit(ref);
+    }
+    bvh.traverse(r.clipped(0, tmax), [&](const uint32_t* prims, uint32_t count, real) {
+        for (uint32_t i = 0; i < count; i++) {
+            visit(refs[prims[i]]);
+        }
+        return tmax;
+        });
+    return closest;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "../accel/wide_bvh.hpp"
+#include "../geometry/intersection.hpp"
+#include "../geometry/shapes/all_shapes.hpp"
+
+// Flattened, render-ready copy of a world's shapes. Groups are dissolved into
+// their primitives, with every transform above a primitive baked into one
+// world-to-object matrix. Each primitive type lives in its own contiguous
+// array, and a single WideBVH over all of them dispatches leaves by a switch
+// on the type tag, so the intersection kernels inline instead of going
+// through Shape's virtual calls. Hits still point at the original shapes,
+// which shading uses unchanged. Holds raw pointers into the shapes: rebuild
+// after editing or freeing any of them
+struct CompiledScene {
+    enum class Kind : uint8_t { Sphere, Plane, Cube, Cylinder, Cone, Triangle, Other };
+
+    // transform indexes to_object; 0 is the identity (the ray is used as is)
+    struct CompiledSphere {
+        const Shape* shape;
+        uint32_t transform;
+        Point center;
+    };
+    struct CompiledPlane {
+        const Shape* shape;
+        uint32_t transform;
+    };
+    struct CompiledCube {
+        const Shape* shape;
+        uint32_t transform;
+    };
+    // Cylinders and cones
+    struct CompiledQuadric {
+        const Shape* shape;
+        uint32_t transform;
+        real minimum;
+        real maximum;
+        bool closed;
+    };
+    struct CompiledTriangle {
+        const Shape* shape;
+        uint32_t transform;
+        Point p1;
+        Vector e1;
+        Vector e2;
+    };
+    // Anything without a kernel here (meshes, instances, test shapes), intersected
+    // through its virtual interface. transform goes to the shape's parent
+    // space, as the shape applies its own
+    struct CompiledOther {
+        const Shape* shape;
+        uint32_t transform;
+    };
+
+    std::vector<Matrix4> to_object;
+    std::vector<CompiledSphere> spheres;
+    std::vector<CompiledPlane> planes;
+    std::vector<CompiledCube> cubes;
+    std::vector<CompiledQuadric> cylinders;
+    std::vector<CompiledQuadric> cones;
+    std::vector<CompiledTriangle> triangles;
+    std::vector<CompiledOther> others;
+
+    static CompiledScene build(const std::vector<const Shape*>& objects,
+        const SAHOptions& options = SAHOptions());
+
+    size_t primitive_count() const { return refs.size() + unbounded.size(); }
+    const WideBVH& wide_bvh() const { return bvh; }
+
+    // Same contracts as World's queries; intersect() leaves the hits unsorted
+    IntersectionRecord intersect(const Ray& r) const;
+    bool occluded(const Ray& r, real tmax) const;
+    std::optional<Intersection> intersect_closest(const Ray& r, real tmax = INFINITY) const;
+
+private:
+    // A primitive reference: Kind in the top bits, array index below
+    static constexpr uint32_t KIND_SHIFT = 28;
+    static constexpr uint32_t INDEX_MASK = (1u << KIND_SHIFT) - 1;
+
+    WideBVH bvh;
+    std::vector<uint32_t> refs;      // indexed by bvh.indices
+    std::vector<uint32_t> unbounded; // planes etc., tested by every ray
+
+    Ray local_ray(uint32_t transform, const Ray& r) const {
+        return transform == 0 ? r : r.transform(to_object[transform]);
+    }
+
+    // Calls emit(Intersection) for every hit of a kernel-backed primitive
+    template <typename Emit>
+    void for_each_hit(uint32_t ref, const Ray& r, Emit&& emit) const;
+};
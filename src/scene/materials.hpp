@@ -6,19 +6,19 @@
 
 struct Material {
     Color color;
-    double ambient;
-    double diffuse;
-    double specular;
-    double shininess;
+    real ambient;
+    real diffuse;
+    real specular;
+    real shininess;
     Pattern* pattern;
-    double reflective;
-    double transparency;
-    double refractive_index;
+    real reflective;
+    real transparency;
+    real refractive_index;
 
     // TODO: why are these my default values again?
-    Material(Color color = Color(1, 1, 1), double ambient = .1,
-        double diffuse = .9, double specular = .9, double shininess = 200,
-        Pattern* pattern = nullptr, double reflective = 0.0, double transparency = 0.0, double refractive_index = 1)
+    Material(Color color = Color(1, 1, 1), real ambient = .1,
+        real diffuse = .9, real specular = .9, real shininess = 200,
+        Pattern* pattern = nullptr, real reflective = 0.0, real transparency = 0.0, real refractive_index = 1)
         : color(color),
         ambient(ambient),
         diffuse(diffuse),
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// Stable reference to a SlotMap entry. The generation changes whenever a slot
+// is reused, so a handle to an erased entry stays invalid instead of
+// silently aliasing whatever is stored there next
+struct SlotHandle {
+    uint32_t index = UINT32_MAX;
+    uint32_t generation = 0;
+
+    bool operator==(const SlotHandle& other) const = default;
+};
+
+// Values are packed in a contiguous vector, iterated in insertion order until
+// an erase moves the last value into the hole. Handles go through a slot
+// table, so insert, erase and lookup are all O(1)
+template <typename T>
+struct SlotMap {
+    SlotHandle insert(T value);
+    // The erased value, or nothing if the handle is stale
+    std::optional<T> erase(SlotHandle handle);
+
+    T* get(SlotHandle handle);
+    const T* get(SlotHandle handle) const;
+    bool contains(SlotHandle handle) const { return get(handle) != nullptr; }
+
+    size_t size() const { return values.size(); }
+    bool empty() const { return values.empty(); }
+    void clear();
+
+    auto begin() { return values.begin(); }
+    auto end() { return values.end(); }
+    auto begin() const { return values.begin(); }
+    auto end() const { return values.end(); }
+
+private:
+    struct Slot {
+        uint32_t value;      // index into values while occupied
+        uint32_t generation; // odd while occupied
+    };
+
+    std::vector<T> values;
+    std::vector<uint32_t> value_slots; // slot of each value
+    std::vector<Slot> slots;
+    std::vector<uint32_t> free_slots;
+};
+
+template <typename T>
+SlotHandle SlotMap<T>::insert(T value) {
+    uint32_t slot;
+    if (free_slots.empty()) {
+        slot = static_cast<uint32_t>(slots.size());
+        slots.push_back({ 0, 0 });
+    }
+    else {
+        slot = free_slots.back();
+        free_slots.pop_back();
+    }
+    slots[slot].value = static_cast<uint32_t>(values.size());
+    slots[slot].generation++;
+    values.push_back(std::move(value));
+    value_slots.push_back(slot);
+    return { slot, slots[slot].generation };
+}
+
+template <typename T>
+std::optional<T> SlotMap<T>::erase(SlotHandle handle) {
+    if (!contains(handle)) {
+        return std::nullopt;
+    }
+    Slot& slot = slots[handle.index];
+    std::optional<T> erased = std::move(values[slot.value]);
+
+    // Move the last value into the hole
+    uint32_t last = static_cast<uint32_t>(values.size() - 1);
+    if (slot.value != last) {
+        values[slot.value] = std::move(values[last]);
+        value_slots[slot.value] = value_slots[last];
+        slots[value_slots[last]].value = slot.value;
+    }
+    values.pop_back();
+    value_slots.pop_back();
+
+    slot.generation++;
+    free_slots.push_back(handle.index);
+    return erased;
+}
+
+template <typename T>
+T* SlotMap<T>::get(SlotHandle handle) {
+    return const_cast<T*>(std::as_const(*this).get(handle));
+}
+
+template <typename T>
+const T* SlotMap<T>::get(SlotHandle handle) const {
+    if (handle.index >= slots.size() || slots[handle.index].generation != handle.generation
+        || handle.generation % 2 == 0) {
+        return nullptr;
+    }
+    return &values[slots[handle.index].value];
+}
+
+template <typename T>
+void SlotMap<T>::clear() {
+    for (uint32_t slot : value_slots) {
+        slots[slot].generation++;
+        free_slots.push_back(slot);
+    }
+    values.clear();
+    value_slots.clear();
+}
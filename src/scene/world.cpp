@@ -1,5 +1,25 @@
 #include "world.hpp"
 
+namespace {
+    // Shading reads each shape's cached world transform, so fill them all
+    // before threads share the shapes. Singular shapes are never hit, so
+    // neither is anything under them
+    void cache_world_transforms(const Shape* shape) {
+        if (!shape->transform.is_invertible()) {
+            return;
+        }
+        shape->world_to_object_matrix();
+        if (auto group = dynamic_cast<const Group*>(shape)) {
+            for (const auto& child : group->shapes) {
+                cache_world_transforms(child.get());
+            }
+        }
+        else if (auto instance = dynamic_cast<const Instance*>(shape)) {
+            cache_world_transforms(instance->prototype.get());
+        }
+    }
+}
+
 DefaultWorld World::default_world() {
     DefaultWorld result;
     auto light =
@@ -18,18 +38,105 @@ DefaultWorld World::default_world() {
     result.s1 = s1.get();
     result.s2 = s2.get();
 
-    result.w.objects.emplace(s1.get(), std::move(s1));
-    result.w.objects.emplace(s2.get(), std::move(s2));
+    result.w.add_object(std::move(s1));
+    result.w.add_object(std::move(s2));
     // result.w.lights.emplace(light.get(), std::move(light));
     result.w.light = std::move(light);
 
     return result;
 }
 
+ObjectHandle World::add_object(std::unique_ptr<Shape> object) {
+    invalidate();
+    return objects.insert(std::move(object));
+}
+
+std::unique_ptr<Shape> World::remove_object(ObjectHandle handle) {
+    auto object = objects.erase(handle);
+    if (!object) {
+        return nullptr;
+    }
+    invalidate();
+    return std::move(*object);
+}
+
+const Shape* World::get_object(ObjectHandle handle) const {
+    auto object = objects.get(handle);
+    return object ? object->get() : nullptr;
+}
+
+Shape* World::edit_object(ObjectHandle handle) {
+    auto object = objects.get(handle);
+    if (!object) {
+        return nullptr;
+    }
+    invalidate();
+    return object->get();
+}
+
+void World::bake_transforms() {
+    for (auto& object : objects) {
+        object.get()->bake_transform();
+    }
+    invalidate();
+}
+
+void World::prepare() const {
+    std::vector<const Shape*> shapes;
+    for (auto& object : objects) {
+        object.get()->bounds_of();
+        cache_world_transforms(object.get());
+        shapes.push_back(object.get());
+    }
+    compiled = std::make_unique<CompiledScene>(CompiledScene::build(shapes));
+}
+
+const CompiledScene& World::compiled_scene() const {
+    if (!compiled) {
+        prepare();
+    }
+    return *compiled;
+}
+
+const World::TopLevel& World::top_level_bvh() const {
+    if (top_level) {
+        return *top_level;
+    }
+    top_level = std::make_unique<TopLevel>();
+    std::vector<BoundingBox> bounds;
+    for (auto& object : objects) {
+        BoundingBox bb = object.get()->parent_space_bounds_of();
+        if (std::isfinite(bb.surface_area())) {
+            top_level->bounded.push_back(object.get());
+            bounds.push_back(bb);
+        }
+        else {
+            top_level->unbounded.push_back(object.get());
+        }
+    }
+    if (!bounds.empty()) {
+        LinearBVH binary = LinearBVH::build(bounds);
+        top_level->bvh = WideBVH::collapse(std::move(binary));
+    }
+    return *top_level;
+}
+
 IntersectionRecord World::intersect_world(const Ray r) const {
     IntersectionRecord xs;
-    for (auto& [key, object] : objects) {
-        xs.append_record(object.get()->intersect(r));
+    if (compiled) {
+        xs = compiled->intersect(r);
+    }
+    else {
+        const TopLevel& tl = top_level_bvh();
+        for (const Shape* object : tl.unbounded) {
+            xs.append_record(object->intersect(r));
+        }
+        tl.bvh.traverse(r, [&](const uint32_t* prims, uint32_t count, real tmax) {
+            for (uint32_t i = 0; i < count; i++) {
+                xs.append_record(tl.bounded[prims[i]]->intersect(r));
+            }
+            return tmax;
+            });
     }
 
     std::sort(xs.intersections.begin(), xs.intersections.end(),
@@ -37,17 +144,61 @@ IntersectionRecord World::intersect_world(const Ray r) const {
     return xs;
 }
 
+bool World::occluded(const Ray r, real tmax) const {
+    if (compiled) {
+        return compiled->occluded(r, tmax);
+    }
+    const TopLevel& tl = top_level_bvh();
+    for (const Shape* object : tl.unbounded) {
+        if (object->occluded(r, tmax)) {
+            return true;
+        }
+    }
+    bool hit = false;
+    tl.bvh.traverse(r.clipped(0, tmax), [&](const uint32_t* prims, uint32_t count, real limit) {
+        for (uint32_t i = 0; i < count && !hit; i++) {
+            hit = tl.bounded[prims[i]]->occluded(r, tmax);
+        }
+        return hit ? -INFINITY : limit;
+        });
+    return hit;
+}
+
+std::optional<Intersection> World::intersect_closest(const Ray r, real tmax) const {
+    if (compiled) {
+        return compiled->intersect_closest(r, tmax);
+    }
+    std::optional<Intersection> closest;
+    auto visit = [&](const Shape* object) {
+        if (auto hit = object->intersect_closest(r, tmax)) {
+            closest = hit;
+            tmax = hit->t;
+        }
+        };
+    const TopLevel& tl = top_level_bvh();
+    for (const Shape* object : tl.unbounded) {
+        visit(object);
+    }
+    tl.bvh.traverse(r.clipped(0, tmax), [&](const uint32_t* prims, uint32_t count, real) {
+        for (uint32_t i = 0; i < count; i++) {
+            visit(tl.bounded[prims[i]]);
+        }
+        return tmax;
+        });
+    return closest;
+}
+
 Color World::shade_hit(PrecomputedIntersection comps, int remaining) const {
     bool shadowed = is_shadowed(comps.over_point);
     // TODO: change to allow for multiple lights
-    Color surface = Shading::phong_lighting(comps.object->material, comps.object,
+    Color surface = Shading::phong_lighting(*comps.material, comps.object,
         light.get(), comps.over_point, comps.eye, // TESTED CHANGING TO OVER_POINT
         comps.normal, shadowed);
     Color reflected = reflected_color(comps, remaining);
     Color refracted = refracted_color(comps, remaining);
 
-    if (comps.object->material.reflective > 0 && comps.object->material.transparency > 0) {
-        double reflectance = Refraction::schlick(comps);
+    if (comps.material->reflective > 0 && comps.material->transparency > 0) {
+        real reflectance = Refraction::schlick(comps);
         return surface + reflected * reflectance + refracted * (1 - reflectance);
     }
 
@@ -55,12 +206,20 @@ Color World::shade_hit(PrecomputedIntersection comps, int remaining) const {
 }
 
 Color World::color_at(Ray r, int remaining) const {
-    auto xs = this->intersect_world(r);
-    auto hit = xs.hit();
+    auto hit = this->intersect_closest(r);
     if (!hit.has_value()) {
         return Color(0, 0, 0);
     }
 
+    // Opaque hits need no refractive indices, only transparent ones need the
+    // full sorted list for the containers walk in prepare_computations
+    if (hit->object->material_at(*hit).transparency <= 0) {
+        auto comps = PrecomputedIntersection::prepare_computations(hit.value(), r);
+        return shade_hit(comps, remaining);
+    }
+
+    auto xs = this->intersect_world(r);
+    hit = xs.hit();
     auto comps = PrecomputedIntersection::prepare_computations(hit.value(), r, &xs);
     // ---- DEBUGGING: visualize which object was hit ----
     // if (hit->object->material.reflective == 1) return Color(1, 0, 0); // red = self-hit
@@ -70,37 +229,35 @@ Color World::color_at(Ray r, int remaining) const {
 
 bool World::is_shadowed(Point p) const {
     Vector p_to_light = light.get()->pos - p;
-    double distance = p_to_light.magnitude();
+    real distance = p_to_light.magnitude();
     Vector dir_to_light = p_to_light.normalized();
 
     Ray r(p, dir_to_light);
-    auto intersections = this->intersect_world(r);
-    auto hit = intersections.hit();
-    return hit.has_value() && hit.value().t < distance; // && hit.value().t > 0;
+    return occluded(r, distance);
 }
 
 Color World::reflected_color(PrecomputedIntersection comps, int remaining) const {
-    if (remaining <= 0 || double_equal(comps.object->material.reflective, 0)) {
+    if (remaining <= 0 || double_equal(comps.material->reflective, 0)) {
         return Color(0, 0, 0);
     }
 
     Ray reflected_ray(comps.over_point, comps.reflect_dir);
-    return color_at(reflected_ray, remaining - 1) * comps.object->material.reflective;
+    return color_at(reflected_ray, remaining - 1) * comps.material->reflective;
 }
 
 Color World::refracted_color(PrecomputedIntersection comps, int remaining) const {
-    if (remaining <= 0 || double_equal(comps.object->material.transparency, 0)) {
+    if (remaining <= 0 || double_equal(comps.material->transparency, 0)) {
         return Color(0, 0, 0);
-        if (double_equal(comps.object->material.transparency, 0)) {
+        if (double_equal(comps.material->transparency, 0)) {
             return Color(0, 0, 0);
         }
         return Color(0, 1, 0);
     }
 
     // Snell's Law
-    double n_ratio = comps.n1 / comps.n2;
-    double cos_i = comps.eye.dot(comps.normal);
-    double sin2_t = pow(n_ratio, 2) * (1 - pow(cos_i, 2));
+    real n_ratio = comps.n1 / comps.n2;
+    real cos_i = comps.eye.dot(comps.normal);
+    real sin2_t = pow(n_ratio, 2) * (1 - pow(cos_i, 2));
 
     if (sin2_t > 1) { // Total internal reflection
         // assert(false);
@@ -111,9 +268,9 @@ Color World::refracted_color(PrecomputedIntersection comps, int remaining) const
 
     // return Color(0,1,0);
 
-    double cos_t = sqrt(1 - sin2_t);
+    real cos_t = sqrt(1 - sin2_t);
     Vector refracted_dir = comps.normal * (n_ratio * cos_i - cos_t) - comps.eye * n_ratio;
     Ray refracted_ray(comps.under_point, refracted_dir.normalized());
 
-    return color_at(refracted_ray, remaining - 1) * comps.object->material.transparency;
+    return color_at(refracted_ray, remaining - 1) * comps.material->transparency;
 }
\ No newline at end of file
@@ -1,11 +1,13 @@
 #pragma once
 
-#include <unordered_map>
+#include <memory>
 
 #include "../geometry/intersection.hpp"
 #include "../geometry/shapes/shapes.hpp"
 #include "../rendering/lighting.hpp"
 #include "../geometry/shapes/all_shapes.hpp"
+#include "compiled_scene.hpp"
+#include "slot_map.hpp"
 
 // struct UniquePtrHash {
 //     template <typename T>
@@ -25,15 +27,14 @@
 // Return object ptrs for testing
 struct DefaultWorld;
 
+using ObjectHandle = SlotHandle;
+
 struct World {
     //    private:
     // TODO: does order matter? Might at least for tests
     // TODO: is this the best way of storing? quick lookup, but is this what
     // should own objects/lights
 
-    // TODO: not really much reason to use unique_ptrs in this project, but good practice at least!
-    std::unordered_map<Shape*, std::unique_ptr<Shape>> objects;
-
     // TODO: allow for multiple lights
     // std::unordered_map<PointLight*, std::unique_ptr<PointLight>> lights;
     std::unique_ptr<PointLight> light;
@@ -42,7 +43,35 @@ struct World {
 
     static DefaultWorld default_world();
 
+    ObjectHandle add_object(std::unique_ptr<Shape> object);
+    // Hands the object back, or nullptr if the handle is stale
+    std::unique_ptr<Shape> remove_object(ObjectHandle handle);
+    const Shape* get_object(ObjectHandle handle) const;
+    // For changing an object in place, which drops the caches below like
+    // add/remove_object do
+    Shape* edit_object(ObjectHandle handle);
+    const SlotMap<std::unique_ptr<Shape>>& all_objects() const { return objects; }
+
+    // Flattened copy of the objects that the queries below use once it is
+    // built, by prepare() or on first use here. Objects edited through
+    // pointers kept from before add_object leave it stale, so call prepare()
+    // again (renders do) before querying
+    const CompiledScene& compiled_scene() const;
+    bool is_compiled() const { return compiled != nullptr; }
+
+    // Optional compile step: bakes every object's transforms as far down
+    // as its leaves allow (see Shape::bake_transform), leaving objects in
+    // world space wherever they can be
+    void bake_transforms();
+
+    // Fills lazily-computed caches (group bounds, world transforms) and compiles the
+    // scene up front so that concurrent renders only ever read shared state
+    void prepare() const;
+
     IntersectionRecord intersect_world(const Ray r) const;
+    // Any-hit query with early exit, for shadow rays
+    bool occluded(const Ray r, real tmax) const;
+    std::optional<Intersection> intersect_closest(const Ray r, real tmax = INFINITY) const;
     Color shade_hit(PrecomputedIntersection comps, int remaining = 5) const;
     Color color_at(Ray r, int remaining = 5) const;
     bool is_shadowed(Point p) const;
@@ -51,6 +80,27 @@ struct World {
 
     // TODO: should intersect_world be a member of this? Not ray? cause
     // is_shadowed refers to point...
+
+private:
+    // TODO: not really much reason to use unique_ptrs in this project, but good practice at least!
+    SlotMap<std::unique_ptr<Shape>> objects;
+
+    mutable std::unique_ptr<CompiledScene> compiled;
+
+    // BVH over the objects' bounds, for queries without a compiled scene.
+    // Built on first use and dropped by add/remove/edit_object
+    struct TopLevel {
+        WideBVH bvh;
+        std::vector<const Shape*> bounded;   // indexed by bvh.indices
+        std::vector<const Shape*> unbounded; // planes etc., tested by every ray
+    };
+    mutable std::unique_ptr<TopLevel> top_level;
+
+    const TopLevel& top_level_bvh() const;
+    void invalidate() {
+        compiled.reset();
+        top_level.reset();
+    }
 };
 
 struct DefaultWorld {
@@ -7,6 +7,7 @@
 #include "rendering/camera.hpp"
 #include "rendering/lighting.hpp"
 #include "geometry/shapes/obj_parser.hpp"
+#include "benchmarks.hpp"
 
 Canvas shadow_puppets_scene();
 
@@ -25,13 +26,16 @@ Canvas group_scene();
 Canvas mesh_scene();
 
 int main(int argc, char* argv[]) {
+    if (argc > 1) { // ./bench_renders <benchmark> [args]
+        return Benchmarks::run(argv[1], argc - 2, argv + 2);
+    }
 
     Canvas canvas = mesh_scene();//reflection_and_refraction_scene(); //shadow_puppets_scene(); //glass_air_bubble_exact_scene(); //
 
-    std::string ppm_data = canvas.to_ppm();
-    std::ofstream outputFile("complex_teapot_bounds.ppm");
-    assert(outputFile.is_open());
-    outputFile << ppm_data;
+    if (!canvas.save_ppm("complex_teapot_bounds.ppm")) {
+        std::cerr << "Failed to write complex_teapot_bounds.ppm\n";
+        return 1;
+    }
     return 0;
 }
 
@@ -41,15 +45,15 @@ Canvas mesh_scene() {
     camera.transform = Transform::view_transform(
         Point(4, 10, -20), Point(0, 0, 0), Vector(0, 1, 0));
 
-    ObjParser parser = ObjParser::parse_obj_file("../tests/test_files/teapot.obj");
-    auto mesh_u = std::move(parser).obj_to_group();
+    // Later runs load the parsed meshes and their BVHs from the cache
+    auto mesh_u = ObjParser::load_obj_mesh("../tests/test_files/teapot.obj", "teapot.rtmesh");
     // mesh_u.get()->transform = Transform::rotation_x(-M_PI / 2);
-    mesh_u.get()->divide(10);
+    mesh_u.get()->build_bvh();
 
     World w;
     w.light = std::move(light_u);
-    w.objects.emplace(mesh_u.get(), std::move(mesh_u));
-    return camera.render(&w);
+    w.add_object(std::move(mesh_u));
+    return camera.render_parallel(&w);
 }
 
 Canvas group_scene() {
@@ -79,12 +83,12 @@ Canvas group_scene() {
         return side_u;
         };
 
+    // All six sides share one prototype
     auto hexagon = [hexagon_side]() {
+        std::shared_ptr<const Shape> side = hexagon_side();
         auto hex = std::make_unique<Group>();
         for (int n = 0; n < 6; n++) {
-            auto side = hexagon_side();
-            side.get()->transform = Transform::rotation_y(n * M_PI / 3);
-            hex.get()->add_child(std::move(side));
+            hex.get()->add_child(std::make_unique<Instance>(side, Transform::rotation_y(n * M_PI / 3)));
         }
         return hex;
         };
@@ -98,8 +102,8 @@ Canvas group_scene() {
     w.light = std::move(light_u);
     auto hex_model_u = hexagon();
     hex_model_u.get()->transform = Transform::rotation_x(-M_PI/2);
-    w.objects.emplace(hex_model_u.get(), std::move(hex_model_u));
-    return camera.render(&w);
+    w.add_object(std::move(hex_model_u));
+    return camera.render_parallel(&w);
 }
 
 Canvas cone_scene() {
@@ -244,20 +248,20 @@ Canvas cone_scene() {
 
     World w;
 
-    w.objects.emplace(floor, std::move(floor_u));
-    w.objects.emplace(concentric_1, std::move(concentric_1_u));
-    // w.objects.emplace(concentric_2, std::move(concentric_2_u));
-    // w.objects.emplace(concentric_3, std::move(concentric_3_u));
-    // w.objects.emplace(concentric_4, std::move(concentric_4_u));
-    // w.objects.emplace(decorative_1, std::move(decorative_1_u));
-    // w.objects.emplace(decorative_2, std::move(decorative_2_u));
-    // w.objects.emplace(decorative_3, std::move(decorative_3_u));
-    // w.objects.emplace(decorative_4, std::move(decorative_4_u));
-    // w.objects.emplace(glass, std::move(glass_u));
-    // w.objects.emplace(reflective, std::move(reflective_u));
+    w.add_object(std::move(floor_u));
+    w.add_object(std::move(concentric_1_u));
+    // w.add_object(std::move(concentric_2_u));
+    // w.add_object(std::move(concentric_3_u));
+    // w.add_object(std::move(concentric_4_u));
+    // w.add_object(std::move(decorative_1_u));
+    // w.add_object(std::move(decorative_2_u));
+    // w.add_object(std::move(decorative_3_u));
+    // w.add_object(std::move(decorative_4_u));
+    // w.add_object(std::move(glass_u));
+    // w.add_object(std::move(reflective_u));
     w.light = std::move(light_u);
 
-    return camera.render(&w);
+    return camera.render_parallel(&w);
 }
 
 Canvas cylinder_scene() {
@@ -402,20 +406,20 @@ Canvas cylinder_scene() {
 
     World w;
 
-    w.objects.emplace(floor, std::move(floor_u));
-    w.objects.emplace(concentric_1, std::move(concentric_1_u));
-    w.objects.emplace(concentric_2, std::move(concentric_2_u));
-    w.objects.emplace(concentric_3, std::move(concentric_3_u));
-    w.objects.emplace(concentric_4, std::move(concentric_4_u));
-    w.objects.emplace(decorative_1, std::move(decorative_1_u));
-    w.objects.emplace(decorative_2, std::move(decorative_2_u));
-    w.objects.emplace(decorative_3, std::move(decorative_3_u));
-    w.objects.emplace(decorative_4, std::move(decorative_4_u));
-    w.objects.emplace(glass, std::move(glass_u));
-    w.objects.emplace(reflective, std::move(reflective_u));
+    w.add_object(std::move(floor_u));
+    w.add_object(std::move(concentric_1_u));
+    w.add_object(std::move(concentric_2_u));
+    w.add_object(std::move(concentric_3_u));
+    w.add_object(std::move(concentric_4_u));
+    w.add_object(std::move(decorative_1_u));
+    w.add_object(std::move(decorative_2_u));
+    w.add_object(std::move(decorative_3_u));
+    w.add_object(std::move(decorative_4_u));
+    w.add_object(std::move(glass_u));
+    w.add_object(std::move(reflective_u));
     w.light = std::move(light_u);
 
-    return camera.render(&w);
+    return camera.render_parallel(&w);
 }
 
 Canvas reflection_and_refraction_cube_scene() {
@@ -528,22 +532,22 @@ Canvas reflection_and_refraction_cube_scene() {
 
     World w;
 
-    w.objects.emplace(floor, std::move(floor_u));
-    w.objects.emplace(ceiling, std::move(ceiling_u));
-    w.objects.emplace(north_wall, std::move(north_wall_u));
-    w.objects.emplace(west_wall, std::move(west_wall_u));
-    w.objects.emplace(east_wall, std::move(east_wall_u));
-    w.objects.emplace(south_wall, std::move(south_wall_u));
-    w.objects.emplace(b_sphere_1, std::move(b_sphere_1_u));
-    w.objects.emplace(b_sphere_2, std::move(b_sphere_2_u));
-    w.objects.emplace(b_sphere_3, std::move(b_sphere_3_u));
-    w.objects.emplace(b_sphere_4, std::move(b_sphere_4_u));
-    w.objects.emplace(red_sphere, std::move(red_sphere_u));
-    w.objects.emplace(blue_sphere, std::move(blue_sphere_u));
-    w.objects.emplace(green_sphere, std::move(green_sphere_u));
+    w.add_object(std::move(floor_u));
+    w.add_object(std::move(ceiling_u));
+    w.add_object(std::move(north_wall_u));
+    w.add_object(std::move(west_wall_u));
+    w.add_object(std::move(east_wall_u));
+    w.add_object(std::move(south_wall_u));
+    w.add_object(std::move(b_sphere_1_u));
+    w.add_object(std::move(b_sphere_2_u));
+    w.add_object(std::move(b_sphere_3_u));
+    w.add_object(std::move(b_sphere_4_u));
+    w.add_object(std::move(red_sphere_u));
+    w.add_object(std::move(blue_sphere_u));
+    w.add_object(std::move(green_sphere_u));
     w.light = std::move(light_u);
 
-    return camera.render(&w);
+    return camera.render_parallel(&w);
 }
 
 Canvas glass_air_cube_scene() {
@@ -588,13 +592,13 @@ Canvas glass_air_cube_scene() {
     inner_air_sphere->material.color = Color(1, 1, 1);
 
     World w;
-    w.objects.emplace(floor, std::move(floor_u));
-    w.objects.emplace(glass_sphere, std::move(glass_sphere_u));
-    w.objects.emplace(inner_air_sphere, std::move(inner_air_sphere_u));
+    w.add_object(std::move(floor_u));
+    w.add_object(std::move(glass_sphere_u));
+    w.add_object(std::move(inner_air_sphere_u));
     std::cout << "Hollow glass cube\n";
     w.light = std::move(light_u);
 
-    return camera.render(&w);
+    return camera.render_parallel(&w);
 }
 
 Canvas glass_air_bubble_exact_scene() {
@@ -637,13 +641,13 @@ Canvas glass_air_bubble_exact_scene() {
     inner_air_sphere->material.color = Color(1, 1, 1);
 
     World w;
-    w.objects.emplace(floor, std::move(floor_u));
-    w.objects.emplace(glass_sphere, std::move(glass_sphere_u));
-    w.objects.emplace(inner_air_sphere, std::move(inner_air_sphere_u));
+    w.add_object(std::move(floor_u));
+    w.add_object(std::move(glass_sphere_u));
+    w.add_object(std::move(inner_air_sphere_u));
     std::cout << "Hollow glass - no reflections - colors 1\n";
     w.light = std::move(light_u);
 
-    return camera.render(&w);
+    return camera.render_parallel(&w);
 }
 
 Canvas glass_air_bubble_forum_scene() {
@@ -679,12 +683,12 @@ Canvas glass_air_bubble_forum_scene() {
     inner_air_sphere->material.color = Color(0, 0, .1);
 
     World w;
-    w.objects.emplace(floor, std::move(floor_u));
-    w.objects.emplace(glass_sphere, std::move(glass_sphere_u));
-    // w.objects.emplace(inner_air_sphere, std::move(inner_air_sphere_u));
+    w.add_object(std::move(floor_u));
+    w.add_object(std::move(glass_sphere_u));
+    // w.add_object(std::move(inner_air_sphere_u));
     w.light = std::move(light_u);
 
-    return camera.render(&w);
+    return camera.render_parallel(&w);
 }
 
 Canvas shadow_puppets_scene() {
@@ -753,17 +757,17 @@ Canvas shadow_puppets_scene() {
 
     World w;
 
-    w.objects.emplace(sphere, std::move(sphere_u));
-    w.objects.emplace(wrist, std::move(wrist_u));
-    w.objects.emplace(palm, std::move(palm_u));
-    w.objects.emplace(thumb, std::move(thumb_u));
-    w.objects.emplace(index, std::move(index_u));
-    w.objects.emplace(middle, std::move(middle_u));
-    w.objects.emplace(ring, std::move(ring_u));
-    w.objects.emplace(pinky, std::move(pinky_u));
+    w.add_object(std::move(sphere_u));
+    w.add_object(std::move(wrist_u));
+    w.add_object(std::move(palm_u));
+    w.add_object(std::move(thumb_u));
+    w.add_object(std::move(index_u));
+    w.add_object(std::move(middle_u));
+    w.add_object(std::move(ring_u));
+    w.add_object(std::move(pinky_u));
     w.light = std::move(light_u);
 
-    return camera.render(&w);
+    return camera.render_parallel(&w);
 }
 
 Canvas reflection_and_refraction_scene() {
@@ -876,20 +880,20 @@ Canvas reflection_and_refraction_scene() {
 
     World w;
 
-    w.objects.emplace(floor, std::move(floor_u));
-    w.objects.emplace(ceiling, std::move(ceiling_u));
-    w.objects.emplace(north_wall, std::move(north_wall_u));
-    w.objects.emplace(west_wall, std::move(west_wall_u));
-    w.objects.emplace(east_wall, std::move(east_wall_u));
-    w.objects.emplace(south_wall, std::move(south_wall_u));
-    w.objects.emplace(b_sphere_1, std::move(b_sphere_1_u));
-    w.objects.emplace(b_sphere_2, std::move(b_sphere_2_u));
-    w.objects.emplace(b_sphere_3, std::move(b_sphere_3_u));
-    w.objects.emplace(b_sphere_4, std::move(b_sphere_4_u));
-    w.objects.emplace(red_sphere, std::move(red_sphere_u));
-    w.objects.emplace(blue_sphere, std::move(blue_sphere_u));
-    w.objects.emplace(green_sphere, std::move(green_sphere_u));
+    w.add_object(std::move(floor_u));
+    w.add_object(std::move(ceiling_u));
+    w.add_object(std::move(north_wall_u));
+    w.add_object(std::move(west_wall_u));
+    w.add_object(std::move(east_wall_u));
+    w.add_object(std::move(south_wall_u));
+    w.add_object(std::move(b_sphere_1_u));
+    w.add_object(std::move(b_sphere_2_u));
+    w.add_object(std::move(b_sphere_3_u));
+    w.add_object(std::move(b_sphere_4_u));
+    w.add_object(std::move(red_sphere_u));
+    w.add_object(std::move(blue_sphere_u));
+    w.add_object(std::move(green_sphere_u));
     w.light = std::move(light_u);
 
-    return camera.render(&w);
+    return camera.render_parallel(&w);
 }
\ No newline at end of file
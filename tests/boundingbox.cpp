@@ -1,6 +1,10 @@
 #include "../src/accel/bounding_box.hpp"
 #include "../src/geometry/shapes/all_shapes.hpp"
 
+#include <cstring>
+#include <functional>
+#include <random>
+
 #include <catch2/catch_approx.hpp>
 #include <catch2/catch_test_macros.hpp>
 
@@ -437,4 +441,477 @@ TEST_CASE("Subdividing a group with too few children", "[accel][bounding_box][bv
     REQUIRE(subsubgroup2->shapes.size() == 2);
     REQUIRE(subsubgroup2->shapes[0].get() == s2);
     REQUIRE(subsubgroup2->shapes[1].get() == s3);
-}
\ No newline at end of file
+}
+
+TEST_CASE("Bounding box surface area and centroid", "[accel][bounding_box]") {
+    BoundingBox box(Point(-1, -2, -3), Point(3, 2, 1));
+    REQUIRE(box.surface_area() == 2 * (4 * 4 + 4 * 4 + 4 * 4));
+    REQUIRE(box.centroid() == Point(1, 0, -1));
+
+    REQUIRE(BoundingBox().surface_area() == 0);
+
+    BoundingBox unbounded = Plane().bounds_of();
+    REQUIRE(std::isinf(unbounded.surface_area()));
+    REQUIRE(unbounded.centroid() == Point(0, 0, 0));
+}
+
+TEST_CASE("SAH partition separates two clusters", "[accel][bvh][sah]") {
+    std::vector<BVHPrimitive> prims;
+    for (int i = 0; i < 4; i++) {
+        prims.emplace_back(BoundingBox(Point(-10 - i, 0, 0), Point(-9 - i, 1, 1)), prims.size());
+        prims.emplace_back(BoundingBox(Point(10 + i, 0, 0), Point(11 + i, 1, 1)), prims.size());
+    }
+
+    auto mid = sah_partition(prims, 0, prims.size(), SAHOptions());
+    REQUIRE(mid.has_value());
+    REQUIRE(*mid == 4);
+    for (size_t i = 0; i < prims.size(); i++) {
+        REQUIRE((prims[i].centroid.x < 0) == (i < 4));
+    }
+}
+
+TEST_CASE("SAH partition keeps small ranges as leaves", "[accel][bvh][sah]") {
+    std::vector<BVHPrimitive> prims;
+    for (int i = 0; i < 3; i++) {
+        prims.emplace_back(BoundingBox(Point(0, 0, 0), Point(10, 10, 10)), i);
+    }
+    REQUIRE_FALSE(sah_partition(prims, 0, prims.size(), SAHOptions()).has_value());
+
+    // Identical primitives have no split plane, but large ranges are still split
+    SAHOptions options;
+    options.max_leaf_size = 2;
+    auto mid = sah_partition(prims, 0, prims.size(), options);
+    REQUIRE(mid.has_value());
+    REQUIRE(*mid == 1);
+}
+
+TEST_CASE("SAH subdivision partitions every child", "[accel][bvh][sah]") {
+    Group g;
+    std::vector<Shape*> spheres;
+    for (int x = 0; x < 4; x++) {
+        for (int y = 0; y < 4; y++) {
+            auto s_u = std::make_unique<Sphere>();
+            s_u.get()->transform = Transform::translation(x * 3, y * 3, 0);
+            spheres.push_back(s_u.get());
+            g.add_child(std::move(s_u));
+        }
+    }
+    // One large shape straddling everything would be stuck at the root by divide()
+    auto big_u = std::make_unique<Cube>();
+    big_u.get()->transform = Transform::translation(4.5, 4.5, 5) * Transform::scaling(6, 6, 1);
+    g.add_child(std::move(big_u));
+
+    SAHOptions options;
+    options.max_leaf_size = 2;
+    g.divide_sah(options);
+
+    REQUIRE(g.shapes.size() == 2);
+    BVHReport report = g.bvh_report(options);
+    REQUIRE(report.primitives == 17);
+    REQUIRE(report.depth > 1);
+    REQUIRE(report.sah_cost > 0);
+    REQUIRE(report.sah_cost < 17);
+
+    std::function<void(const Group&)> check_leaves = [&](const Group& group) {
+        REQUIRE(group.shapes.size() <= options.max_leaf_size);
+        for (const auto& shape : group.shapes) {
+            if (auto child = dynamic_cast<const Group*>(shape.get())) {
+                REQUIRE(child->parent == &group);
+                check_leaves(*child);
+            }
+        }
+        };
+    check_leaves(g);
+
+    Ray r(Point(6, 6, -5), Vector(0, 0, 1));
+    auto xs = g.intersect(r);
+    REQUIRE(xs.count == 4);
+    REQUIRE(xs.intersections[0].object == spheres[2 * 4 + 2]);
+}
+
+TEST_CASE("Building a linear BVH", "[accel][bvh][linear_bvh]") {
+    std::vector<BoundingBox> bounds;
+    for (int i = 0; i < 50; i++) {
+        double x = (i * 7) % 50;
+        double y = (i * 13) % 50;
+        bounds.emplace_back(Point(x, y, 0), Point(x + 1, y + 1, 1.1));
+    }
+    SAHOptions options;
+    options.max_leaf_size = 2;
+    LinearBVH bvh = LinearBVH::build(bounds, options);
+
+    REQUIRE(bvh.indices.size() == bounds.size());
+    std::vector<uint32_t> sorted = bvh.indices;
+    std::sort(sorted.begin(), sorted.end());
+    for (uint32_t i = 0; i < sorted.size(); i++) {
+        REQUIRE(sorted[i] == i);
+    }
+
+    // Float bounds never shrink the double ones, and children sit inside parents
+    auto node_box = [&](const LinearBVHNode& n) {
+        return BoundingBox(Point(n.min[0], n.min[1], n.min[2]), Point(n.max[0], n.max[1], n.max[2]));
+        };
+    std::function<void(uint32_t)> check = [&](uint32_t i) {
+        const LinearBVHNode& node = bvh.nodes[i];
+        if (node.is_leaf()) {
+            REQUIRE(node.count <= options.max_leaf_size);
+            for (uint32_t p = node.offset; p < node.offset + node.count; p++) {
+                REQUIRE(node_box(node).contains_bb(bounds[bvh.indices[p]]));
+            }
+            return;
+        }
+        REQUIRE(node_box(node).contains_bb(node_box(bvh.nodes[i + 1])));
+        REQUIRE(node_box(node).contains_bb(node_box(bvh.nodes[node.offset])));
+        check(i + 1);
+        check(node.offset);
+        };
+    check(0);
+    REQUIRE(bvh.depth() > 1);
+}
+
+TEST_CASE("Linear BVH traversal skips nodes beyond the closest hit", "[accel][bvh][linear_bvh]") {
+    // A row of unit boxes along z
+    std::vector<BoundingBox> bounds;
+    for (int i = 0; i < 32; i++) {
+        bounds.emplace_back(Point(0, 0, i * 2), Point(1, 1, i * 2 + 1));
+    }
+    SAHOptions options;
+    options.max_leaf_size = 1;
+    LinearBVH bvh = LinearBVH::build(bounds, options);
+
+    Ray r(Point(.5, .5, -5), Vector(0, 0, 1));
+    std::vector<uint32_t> visited;
+    bvh.traverse(r.clipped(0, INFINITY), [&](const uint32_t* prims, uint32_t, double tmax) {
+        visited.push_back(prims[0]);
+        return std::min(tmax, bounds[prims[0]].min.z - r.origin.z);
+        });
+    REQUIRE(visited.size() == 1);
+    REQUIRE(visited[0] == 0);
+
+    // Without pruning every box along the ray is reached, front to back
+    visited.clear();
+    bvh.traverse(r.clipped(0, INFINITY), [&](const uint32_t* prims, uint32_t, double tmax) {
+        visited.push_back(prims[0]);
+        return tmax;
+        });
+    REQUIRE(visited.size() == 32);
+    for (uint32_t i = 0; i < visited.size(); i++) {
+        REQUIRE(visited[i] == i);
+    }
+
+    Ray miss(Point(5, 5, -5), Vector(0, 0, 1));
+    visited.clear();
+    bvh.traverse(miss.clipped(0, INFINITY), [&](const uint32_t* prims, uint32_t, double tmax) {
+        visited.push_back(prims[0]);
+        return tmax;
+        });
+    REQUIRE(visited.empty());
+}
+
+TEST_CASE("A parallel build makes the same linear BVH on any number of threads", "[accel][bvh][linear_bvh]") {
+    // Enough boxes to start threads, some of them stacked on one centroid
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<double> coord(-100, 100);
+    std::uniform_real_distribution<double> size(.1, 3);
+    std::vector<BoundingBox> bounds;
+    for (int i = 0; i < 40'000; i++) {
+        Point p = i % 10 == 0 ? Point(5, 5, 5) : Point(coord(rng), coord(rng), coord(rng) * .1);
+        bounds.emplace_back(p, p + Vector(size(rng), size(rng), size(rng)));
+    }
+    LinearBVH serial = LinearBVH::build(bounds);
+
+    for (size_t threads : { 1, 2, 4 }) {
+        BVHBuildTimings timings;
+        LinearBVH parallel = LinearBVH::build_parallel(bounds, threads, SAHOptions(), &timings);
+        REQUIRE(timings.subtrees > 1);
+        REQUIRE(parallel.indices == serial.indices);
+        REQUIRE(parallel.nodes.size() == serial.nodes.size());
+        for (size_t i = 0; i < serial.nodes.size(); i++) {
+            REQUIRE(std::memcmp(&parallel.nodes[i], &serial.nodes[i], sizeof(LinearBVHNode)) == 0);
+        }
+    }
+}
+
+TEST_CASE("Building a linear BVH from Morton codes", "[accel][bvh][linear_bvh][morton]") {
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<double> coord(-100, 100);
+    std::uniform_real_distribution<double> size(.1, 3);
+    std::vector<BoundingBox> bounds;
+    for (int i = 0; i < 40'000; i++) {
+        Point p = i % 10 == 0 ? Point(5, 5, 5) : Point(coord(rng), coord(rng), coord(rng) * .1);
+        bounds.emplace_back(p, p + Vector(size(rng), size(rng), size(rng)));
+    }
+    SAHOptions options;
+    options.method = BVHMethod::Morton;
+    LinearBVH bvh = LinearBVH::build(bounds, options);
+
+    std::vector<uint32_t> sorted = bvh.indices;
+    std::sort(sorted.begin(), sorted.end());
+    REQUIRE(sorted.size() == bounds.size());
+    for (uint32_t i = 0; i < sorted.size(); i++) {
+        REQUIRE(sorted[i] == i);
+    }
+    auto node_box = [&](const LinearBVHNode& n) {
+        return BoundingBox(Point(n.min[0], n.min[1], n.min[2]), Point(n.max[0], n.max[1], n.max[2]));
+        };
+    std::function<void(uint32_t)> check = [&](uint32_t i) {
+        const LinearBVHNode& node = bvh.nodes[i];
+        if (node.is_leaf()) {
+            REQUIRE(node.count <= options.max_leaf_size);
+            for (uint32_t p = node.offset; p < node.offset + node.count; p++) {
+                REQUIRE(node_box(node).contains_bb(bounds[bvh.indices[p]]));
+            }
+            return;
+        }
+        REQUIRE(node_box(node).contains_bb(node_box(bvh.nodes[i + 1])));
+        REQUIRE(node_box(node).contains_bb(node_box(bvh.nodes[node.offset])));
+        check(i + 1);
+        check(node.offset);
+        };
+    check(0);
+
+    // The sort is stable, so threads don't change the tree
+    LinearBVH parallel = LinearBVH::build_parallel(bounds, 4, options);
+    REQUIRE(parallel.indices == bvh.indices);
+    REQUIRE(parallel.nodes.size() == bvh.nodes.size());
+    for (size_t i = 0; i < bvh.nodes.size(); i++) {
+        REQUIRE(std::memcmp(&parallel.nodes[i], &bvh.nodes[i], sizeof(LinearBVHNode)) == 0);
+    }
+
+    // Closest boxes along random rays match the SAH tree's
+    LinearBVH sah = LinearBVH::build(bounds);
+    auto closest = [&](const LinearBVH& tree, const Ray& r) {
+        double best = INFINITY;
+        tree.traverse(r, [&](const uint32_t* prims, uint32_t count, double tmax) {
+            for (uint32_t i = 0; i < count; i++) {
+                if (auto t = bounds[prims[i]].slab(r)) {
+                    best = std::min<double>(best, t->first);
+                }
+            }
+            return std::min(tmax, best);
+            });
+        return best;
+        };
+    for (int i = 0; i < 200; i++) {
+        Point from(coord(rng), coord(rng), -50);
+        Point to(coord(rng), coord(rng), coord(rng) * .1);
+        Ray r = Ray(from, Vector(to - from).normalized()).clipped(0, INFINITY);
+        REQUIRE(closest(bvh, r) == closest(sah, r));
+    }
+}
+
+TEST_CASE("The slab test reports where a ray enters and leaves a box", "[accel][bounding_box]") {
+    BoundingBox box(Point(-1, -1, -1), Point(1, 1, 1));
+
+    auto hit = box.slab(Ray(Point(5, .5, 0), Vector(-1, 0, 0)));
+    REQUIRE(hit.has_value());
+    REQUIRE(hit->first == 4);
+    REQUIRE(hit->second == 6);
+
+    // Clipped to the ray's interval
+    hit = box.slab(Ray(Point(5, .5, 0), Vector(-1, 0, 0), 0, 5));
+    REQUIRE(hit->second == 5);
+    REQUIRE(!box.slab(Ray(Point(5, .5, 0), Vector(-1, 0, 0), 7, INFINITY)));
+    REQUIRE(!box.slab(Ray(Point(5, .5, 0), Vector(1, 0, 0), 0, INFINITY)));
+    REQUIRE(!box.intersects(Ray(Point(5, .5, 0), Vector(-1, 0, 0), 0, 3)));
+
+    // Parallel ray starting on a face's plane
+    hit = box.slab(Ray(Point(1, 0, -5), Vector(0, 0, 1)));
+    REQUIRE(hit.has_value());
+    REQUIRE(hit->first == 4);
+    REQUIRE(hit->second == 6);
+
+    // Starting inside, along a diagonal
+    hit = box.slab(Ray(Point(0, 0, 0), Vector(1, 1, 1)));
+    REQUIRE(hit->first == -1);
+    REQUIRE(hit->second == 1);
+}
+
+namespace {
+    std::vector<BoundingBox> random_boxes(size_t count, std::mt19937& rng) {
+        std::uniform_real_distribution<double> coord(-10, 10);
+        std::uniform_real_distribution<double> size(.1, 2);
+        std::vector<BoundingBox> bounds;
+        for (size_t i = 0; i < count; i++) {
+            Point p(coord(rng), coord(rng), coord(rng));
+            bounds.emplace_back(p, p + Vector(size(rng), size(rng), size(rng)));
+        }
+        return bounds;
+    }
+}
+
+TEST_CASE("Collapsing a linear BVH into a wide one", "[accel][bvh][wide_bvh]") {
+    std::mt19937 rng(5);
+    auto bounds = random_boxes(300, rng);
+    LinearBVH binary = LinearBVH::build(bounds);
+    size_t binary_depth = binary.depth();
+    WideBVH wide = WideBVH::collapse(LinearBVH(binary));
+    REQUIRE(wide.indices == binary.indices);
+    REQUIRE(wide.depth() < binary_depth);
+    REQUIRE(wide.nodes.size() < binary.nodes.size() / 2);
+
+    // Every primitive is in exactly one leaf slot, inside the slot's bounds,
+    // and interior slots contain their child node's slots
+    std::vector<int> seen(bounds.size());
+    auto slot_box = [](const WideBVHNode& n, int i) {
+        return BoundingBox(Point(n.min[0][i], n.min[1][i], n.min[2][i]),
+            Point(n.max[0][i], n.max[1][i], n.max[2][i]));
+        };
+    for (const auto& node : wide.nodes) {
+        for (int i = 0; i < WideBVHNode::WIDTH; i++) {
+            if (node.count[i] > 0) {
+                for (uint32_t p = node.child[i]; p < node.child[i] + node.count[i]; p++) {
+                    seen[wide.indices[p]]++;
+                    REQUIRE(slot_box(node, i).contains_bb(bounds[wide.indices[p]]));
+                }
+            }
+            else if (node.child[i] != 0) {
+                const auto& child = wide.nodes[node.child[i]];
+                for (int j = 0; j < WideBVHNode::WIDTH; j++) {
+                    if (child.count[j] > 0 || child.child[j] != 0) {
+                        REQUIRE(slot_box(node, i).contains_bb(slot_box(child, j)));
+                    }
+                }
+            }
+        }
+    }
+    for (int count : seen) {
+        REQUIRE(count == 1);
+    }
+}
+
+TEST_CASE("Wide BVH traversal reaches the same leaves as the linear one", "[accel][bvh][wide_bvh]") {
+    std::mt19937 rng(9);
+    auto bounds = random_boxes(500, rng);
+    LinearBVH binary = LinearBVH::build(bounds);
+    WideBVH wide = WideBVH::collapse(LinearBVH(binary));
+    std::uniform_real_distribution<double> unit(-1, 1);
+
+    for (int n = 0; n < 200; n++) {
+        Ray r(Point(unit(rng) * 15, unit(rng) * 15, unit(rng) * 15), Vector(unit(rng), unit(rng), unit(rng)));
+        std::vector<uint32_t> expected;
+        binary.traverse(r.clipped(0, INFINITY), [&](const uint32_t* prims, uint32_t count, double tmax) {
+            expected.insert(expected.end(), prims, prims + count);
+            return tmax;
+            });
+        std::vector<uint32_t> visited;
+        wide.traverse(r.clipped(0, INFINITY), [&](const uint32_t* prims, uint32_t count, double tmax) {
+            visited.insert(visited.end(), prims, prims + count);
+            return tmax;
+            });
+        std::sort(expected.begin(), expected.end());
+        std::sort(visited.begin(), visited.end());
+        REQUIRE(visited == expected);
+    }
+
+    // A row of unit boxes along z comes back in order, and pruning at the
+    // first hit leaves only that one
+    std::vector<BoundingBox> row;
+    for (int i = 0; i < 32; i++) {
+        row.emplace_back(Point(0, 0, i * 2), Point(1, 1, i * 2 + 1));
+    }
+    SAHOptions options;
+    options.max_leaf_size = 1;
+    WideBVH row_bvh = WideBVH::collapse(LinearBVH::build(row, options));
+    Ray r(Point(.5, .5, -5), Vector(0, 0, 1));
+    std::vector<uint32_t> visited;
+    row_bvh.traverse(r.clipped(0, INFINITY), [&](const uint32_t* prims, uint32_t, double tmax) {
+        visited.push_back(prims[0]);
+        return tmax;
+        });
+    REQUIRE(visited.size() == 32);
+    for (uint32_t i = 0; i < visited.size(); i++) {
+        REQUIRE(visited[i] == i);
+    }
+    visited.clear();
+    row_bvh.traverse(r.clipped(0, INFINITY), [&](const uint32_t* prims, uint32_t, double tmax) {
+        visited.push_back(prims[0]);
+        return std::min(tmax, row[prims[0]].min.z - r.origin.z);
+        });
+    REQUIRE(visited == std::vector<uint32_t>{ 0 });
+}
+
+TEST_CASE("Every SIMD level tests wide BVH nodes alike", "[accel][bvh][wide_bvh]") {
+    std::mt19937 rng(13);
+    std::uniform_real_distribution<double> unit(-1, 1);
+    for (int n = 0; n < 2000; n++) {
+        WideBVHNode node;
+        for (int i = 0; i < WideBVHNode::WIDTH; i++) {
+            bool used = i <= n % WideBVHNode::WIDTH;
+            for (int axis = 0; axis < 3; axis++) {
+                float lo = unit(rng) * 4;
+                node.min[axis][i] = used ? lo : INFINITY;
+                node.max[axis][i] = used ? lo + (unit(rng) + 1) : -INFINITY;
+            }
+            node.child[i] = node.count[i] = 0;
+        }
+        double origin[3] = { unit(rng) * 6, unit(rng) * 6, unit(rng) * 6 };
+        double dir[3] = { unit(rng), unit(rng), n % 5 == 0 ? 0 : unit(rng) };
+        if (n % 9 == 0) {
+            origin[2] = node.min[2][0]; // on a slab plane
+        }
+        double inv_dir[3] = { 1 / dir[0], 1 / dir[1], 1 / dir[2] };
+        double tmax = n % 3 == 0 ? 2 : INFINITY;
+
+        double expected[4];
+        unsigned expected_mask = wide_node_intersector(SimdLevel::Scalar)(node, origin, inv_dir, 0, tmax, expected);
+        for (SimdLevel level : { SimdLevel::SSE2, SimdLevel::AVX2 }) {
+            if (!simd_level_supported(level)) {
+                continue;
+            }
+            double t_enter[4];
+            unsigned mask = wide_node_intersector(level)(node, origin, inv_dir, 0, tmax, t_enter);
+            REQUIRE(mask == expected_mask);
+            for (int i = 0; i < WideBVHNode::WIDTH; i++) {
+                if (mask & (1u << i)) {
+                    REQUIRE(t_enter[i] == expected[i]);
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("Intersecting a group through its BVH", "[accel][bvh][wide_bvh]") {
+    auto make_group = []() {
+        auto g_u = std::make_unique<Group>();
+        for (int x = 0; x < 5; x++) {
+            auto row_u = std::make_unique<Group>();
+            for (int y = 0; y < 5; y++) {
+                auto s_u = std::make_unique<Sphere>();
+                s_u.get()->transform = Transform::translation(x * 2.5, y * 2.5, x % 2);
+                row_u.get()->add_child(std::move(s_u));
+            }
+            g_u.get()->add_child(std::move(row_u));
+        }
+        auto moved_u = std::make_unique<Group>();
+        moved_u.get()->transform = Transform::translation(5, 5, 4) * Transform::scaling(3, 3, 3);
+        moved_u.get()->add_child(std::make_unique<Cube>());
+        g_u.get()->add_child(std::move(moved_u));
+        return g_u;
+        };
+    auto plain = make_group();
+    auto accelerated = make_group();
+    accelerated.get()->build_bvh();
+    auto morton = make_group();
+    SAHOptions lbvh;
+    lbvh.method = BVHMethod::Morton;
+    morton.get()->build_bvh(lbvh);
+    REQUIRE_FALSE(accelerated.get()->wide_bvh().empty());
+    // 25 spheres flattened out of the rows, the transformed group kept whole
+    REQUIRE(accelerated.get()->wide_bvh().indices.size() == 26);
+
+    for (int i = 0; i < 40; i++) {
+        Ray r(Point(i * .3 - 1.05, i * .27 - .5, -10), Vector(0, .01 * (i % 3), 1).normalized());
+        auto expected = plain.get()->intersect(r);
+        for (const auto& g : { accelerated.get(), morton.get() }) {
+            auto xs = g->intersect(r);
+            REQUIRE(xs.count == expected.count);
+            for (size_t j = 0; j < xs.count; j++) {
+                REQUIRE(double_equal(xs.intersections[j].t, expected.intersections[j].t));
+            }
+        }
+    }
+
+    accelerated.get()->add_child(std::make_unique<Sphere>());
+    REQUIRE(accelerated.get()->wide_bvh().empty());
+}
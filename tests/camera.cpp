@@ -63,4 +63,22 @@ TEST_CASE("Rendering a world with a camera", "[scene][camera][world]") {
 
     Canvas image = c.render(&w);
     REQUIRE(image.pixel_at(5, 5) == Color(0.38066, 0.47583, 0.2855));
-}
\ No newline at end of file
+}
+
+TEST_CASE("Rendering in parallel matches the serial render",
+    "[scene][camera][world]") {
+    const auto [w, s1, s2] = World::default_world();
+    Camera c(23, 17, M_PI / 2);
+    c.transform = Transform::view_transform(Point(0, 0, -5), Point(0, 0, 0),
+        Vector(0, 1, 0));
+
+    Canvas serial = c.render(&w);
+    Canvas parallel = c.render_parallel(&w, 4, 5);
+    for (size_t y = 0; y < c.vsize; y++) {
+        for (size_t x = 0; x < c.hsize; x++) {
+            Color a = serial.pixel_at(x, y);
+            Color b = parallel.pixel_at(x, y);
+            REQUIRE((a.r == b.r && a.g == b.g && a.b == b.b));
+        }
+    }
+}
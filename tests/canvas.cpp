@@ -3,6 +3,7 @@
 #include <catch2/catch_approx.hpp>
 #include <catch2/catch_test_macros.hpp>
 #include <cstdint>
+#include <cstdio>
 #include <iostream>
 
 #include "../src/math/tuples.hpp"
@@ -89,4 +90,59 @@ TEST_CASE("Splitting long lines in PPM files", "[canvas]") {
 TEST_CASE("PPM files are terminated by a newline character", "[canvas]") {
     Canvas c(5, 3);
     REQUIRE(c.to_ppm().back() == '\n');
-}
\ No newline at end of file
+}
+
+namespace {
+    std::string write_to_string(const Canvas& c, PPMFormat format) {
+        FILE* f = std::tmpfile();
+        REQUIRE(c.write_ppm(fileno(f), format));
+        std::rewind(f);
+        std::string contents;
+        char buffer[4096];
+        size_t n;
+        while ((n = std::fread(buffer, 1, sizeof(buffer), f)) > 0) {
+            contents.append(buffer, n);
+        }
+        std::fclose(f);
+        return contents;
+    }
+}
+
+TEST_CASE("Streaming a P3 PPM matches to_ppm", "[canvas][ppm]") {
+    Canvas c(10, 2, Color(1, 0.8, 0.6));
+    c.write_pixel(3, 1, Color(-0.5, 0.5, 1.5));
+    REQUIRE(write_to_string(c, PPMFormat::P3) == c.to_ppm());
+}
+
+TEST_CASE("Streaming a binary P6 PPM", "[canvas][ppm]") {
+    Canvas c(5, 3);
+    c.write_pixel(0, 0, Color(1.5, 0, 0));
+    c.write_pixel(2, 1, Color(0, 0.5, 0));
+    c.write_pixel(4, 2, Color(-0.5, 0, 1));
+
+    std::string ppm = write_to_string(c, PPMFormat::P6);
+    std::string header = "P6\n5 3\n255\n";
+    REQUIRE(ppm.size() == header.size() + 5 * 3 * 3);
+    REQUIRE(ppm.substr(0, header.size()) == header);
+
+    auto byte = [&](size_t x, size_t y, size_t channel) {
+        return static_cast<uint8_t>(ppm[header.size() + 3 * (y * 5 + x) + channel]);
+        };
+    REQUIRE(byte(0, 0, 0) == 255);
+    REQUIRE(byte(2, 1, 1) == 127);
+    REQUIRE(byte(4, 2, 0) == 0);
+    REQUIRE(byte(4, 2, 2) == 255);
+    REQUIRE(byte(1, 1, 1) == 0);
+}
+
+TEST_CASE("Converting colors to 8-bit clamps every channel", "[canvas][ppm]") {
+    Color colors[] = { Color(-1, 0.2, 2), Color(NAN, 1, 0.999) };
+    uint8_t out[6];
+    Canvas::to_rgb8(colors, 2, out);
+    REQUIRE(out[0] == 0);
+    REQUIRE(out[1] == 51);
+    REQUIRE(out[2] == 255);
+    REQUIRE(out[3] == 0);
+    REQUIRE(out[4] == 255);
+    REQUIRE(out[5] == 254);
+}
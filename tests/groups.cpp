@@ -1,7 +1,9 @@
 #include "../src/geometry/shapes/all_shapes.hpp"
 
+#include <algorithm>
 #include <catch2/catch_approx.hpp>
 #include <catch2/catch_test_macros.hpp>
+#include <random>
 
 TEST_CASE("Creating a new group", "[shapes][groups]") {
     Group g;
@@ -120,4 +122,275 @@ TEST_CASE("Finding the normal on a child object", "[shapes][groups]") {
 
     Vector n = s->normal_at(Point(1.7321, 1.1547, -5.5774));
     REQUIRE(n == Vector(0.2857, 0.4286, -0.8571));
-}
\ No newline at end of file
+}
+
+TEST_CASE("Editing a flattened subgroup drops its ancestors' BVHs", "[shapes][groups]") {
+    Group root;
+    auto sub_u = std::make_unique<Group>();
+    Group* sub = sub_u.get();
+    sub->add_child(std::make_unique<Sphere>());
+    root.add_child(std::move(sub_u));
+    root.build_bvh();
+    REQUIRE(!root.wide_bvh().empty());
+
+    auto far_u = std::make_unique<Sphere>();
+    const Shape* far = far_u.get();
+    far_u->transform = Transform::translation(0, 0, 10);
+    sub->add_child(std::move(far_u));
+    REQUIRE(root.wide_bvh().empty());
+    Ray r(Point(0, 0, -5), Vector(0, 0, 1));
+    REQUIRE(root.intersect(r).count == 4);
+
+    root.build_bvh();
+    auto removed = sub->remove_child(far);
+    REQUIRE(removed.get() == far);
+    REQUIRE(!removed->parent.has_value());
+    REQUIRE(root.wide_bvh().empty());
+    REQUIRE(root.intersect(r).count == 2);
+    REQUIRE(root.bounds_of().max.z == 1);
+    REQUIRE(sub->remove_child(far) == nullptr);
+}
+
+TEST_CASE("A subgroup with a near-identity transform keeps it in the BVH", "[shapes][groups]") {
+    auto make = [] {
+        auto root = std::make_unique<Group>();
+        auto sub = std::make_unique<Group>();
+        sub->transform = Transform::translation(5e-5, 0, 0); // within EPSILON of identity
+        sub->add_child(std::make_unique<Triangle>(Point(0, 0, 0), Point(0, 1, 0), Point(0, 0, 1)));
+        root->add_child(std::move(sub));
+        return root;
+        };
+    auto reference = make();
+    auto built = make();
+    built->build_bvh();
+    REQUIRE(!built->wide_bvh().empty());
+
+    Ray r(Point(-5, .2, .2), Vector(1, 0, 0));
+    auto expected = reference->intersect_closest(r);
+    auto actual = built->intersect_closest(r);
+    REQUIRE(expected.has_value());
+    REQUIRE(actual.has_value());
+    REQUIRE(actual->t == expected->t);
+    REQUIRE(actual->t != 5);
+}
+
+TEST_CASE("A child's world transform follows changes to its ancestors", "[shapes][groups]") {
+    Group g1;
+    g1.transform = Transform::rotation_y(M_PI / 2);
+
+    auto g2_u = std::make_unique<Group>();
+    Group* g2 = g2_u.get();
+    g2->transform = Transform::scaling(2, 2, 2);
+    g1.add_child(std::move(g2_u));
+
+    auto s_u = std::make_unique<Sphere>();
+    Sphere* s = s_u.get();
+    s->transform = Transform::translation(5, 0, 0);
+    g2->add_child(std::move(s_u));
+    REQUIRE(s->world_to_object(Point(-2, 0, -10)) == Point(0, 0, -1));
+
+    // Replacing the outermost transform reaches the grandchild
+    g1.transform = Transform();
+    REQUIRE(s->world_to_object(Point(10, 0, 0)) == Point(0, 0, 0));
+    REQUIRE(s->normal_to_world(Vector(0, 0, 1)) == Vector(0, 0, 1));
+
+    // As does moving the sphere's parent under another group
+    Group g3;
+    g3.transform = Transform::translation(0, 4, 0);
+    g3.add_child(g1.remove_child(g2));
+    REQUIRE(g1.shapes.empty());
+    REQUIRE(s->world_to_object(Point(10, 4, 0)) == Point(0, 0, 0));
+
+    // The cached matrix is the whole chain in one
+    REQUIRE(s->world_to_object_matrix() == Matrix4(s->transform.inverse_matrix()
+        * g2->transform.inverse_matrix() * g3.transform.inverse_matrix()));
+}
+
+TEST_CASE("The closest hit in a group culls farther children", "[shapes][groups][closest_hit]") {
+    Group g;
+    std::vector<Shape*> children;
+    for (int i = 0; i < 12; i++) {
+        auto s_u = std::make_unique<Sphere>();
+        s_u.get()->transform = Transform::translation(i % 3, 0, i * 3);
+        children.push_back(s_u.get());
+        g.add_child(std::move(s_u));
+    }
+    auto cube_u = std::make_unique<Cube>();
+    cube_u.get()->transform = Transform::translation(0, 0, 20) * Transform::scaling(5, 5, .5);
+    g.add_child(std::move(cube_u));
+    g.transform = Transform::rotation_y(M_PI / 2);
+
+    auto check = [&g]() {
+        for (int i = 0; i < 30; i++) {
+            Ray r(Point(-10, 0, i * .11 - .2), Vector(1, 0, 0));
+            auto expected = g.intersect(r).hit();
+            auto closest = g.intersect_closest(r);
+            REQUIRE(closest.has_value() == expected.has_value());
+            if (expected.has_value()) {
+                REQUIRE(closest.value() == expected.value());
+            }
+        }
+        };
+    check();
+    g.build_bvh();
+    check();
+
+    Ray r(Point(-10, 0, 0), Vector(1, 0, 0));
+    REQUIRE(g.intersect_closest(r).value().object == children[0]);
+    REQUIRE_FALSE(g.intersect_closest(r, 8).has_value());
+}
+
+namespace {
+    // Triangles and a sphere under two levels of transformed groups, the
+    // inner one mirrored
+    std::unique_ptr<Group> transformed_hierarchy() {
+        auto outer = std::make_unique<Group>();
+        outer->transform = Transform::translation(1, 0, 0) * Transform::rotation_y(.7);
+        auto inner = std::make_unique<Group>();
+        inner->transform = Transform::scaling(-1, 2, .5) * Transform::rotation_x(.3);
+        auto flat = std::make_unique<Triangle>(Point(0, 1, 0), Point(-1, 0, 0), Point(1, 0, 0));
+        flat->transform = Transform::translation(0, 0, 1);
+        auto smooth = std::make_unique<SmoothTriangle>(Point(0, 1, 0), Point(-1, 0, 0), Point(1, 0, 0),
+            Vector(0, 1, 0), Vector(-1, 0, 0), Vector(1, 0, 0));
+        smooth->transform = Transform::rotation_z(.4);
+        auto sphere = std::make_unique<Sphere>();
+        sphere->transform = Transform::translation(0, -2, 0) * Transform::scaling(.5, .5, .5);
+        inner->add_children(std::move(flat), std::move(smooth), std::move(sphere));
+        outer->add_child(std::move(inner));
+        outer->add_child(std::make_unique<Triangle>(Point(2, 0, 0), Point(3, 0, 0), Point(2, 1, 0)));
+        return outer;
+    }
+}
+
+TEST_CASE("Baking a group's transforms leaves the same hits and normals", "[shapes][groups][bake]") {
+    auto reference = transformed_hierarchy();
+    auto baked = transformed_hierarchy();
+    baked->bake_transform();
+
+    Group* inner = dynamic_cast<Group*>(baked->shapes[0].get());
+    REQUIRE(baked->transform.is_identity());
+    REQUIRE(inner->transform.is_identity());
+    REQUIRE(inner->shapes[0]->transform.is_identity());
+    REQUIRE(inner->shapes[1]->transform.is_identity());
+    REQUIRE(!inner->shapes[2]->transform.is_identity()); // spheres keep theirs
+    REQUIRE(baked->shapes[1]->transform.is_identity());
+
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> coord(-3, 3);
+    int hits = 0;
+    for (int i = 0; i < 2000; i++) {
+        Point from(coord(rng), coord(rng), -6);
+        Point to(coord(rng), coord(rng), coord(rng));
+        Ray r(from, Vector(to - from).normalized());
+        auto expected = reference->intersect(r);
+        auto actual = baked->intersect(r);
+        REQUIRE(actual.count == expected.count);
+        auto expected_hit = reference->intersect_closest(r);
+        auto actual_hit = baked->intersect_closest(r);
+        REQUIRE(actual_hit.has_value() == expected_hit.has_value());
+        if (expected_hit) {
+            hits++;
+            REQUIRE(double_equal(actual_hit->t, expected_hit->t));
+            Point p = r.position(expected_hit->t);
+            REQUIRE(actual_hit->object->normal_at(p, *actual_hit)
+                == expected_hit->object->normal_at(p, *expected_hit));
+        }
+    }
+    REQUIRE(hits > 100);
+}
+
+TEST_CASE("Baking keeps a group's BVH, now over every leaf", "[shapes][groups][bake]") {
+    auto g = transformed_hierarchy();
+    g->build_bvh();
+    size_t before = g->wide_bvh().indices.size();
+    g->bake_child_transforms();
+    REQUIRE(!g->transform.is_identity());
+    REQUIRE(!g->wide_bvh().empty());
+    // The inner group no longer has a transform, so its children join
+    REQUIRE(g->wide_bvh().indices.size() > before);
+}
+
+TEST_CASE("An instance hits and shades like a transformed copy of its prototype", "[shapes][instances]") {
+    Transform placement = Transform::translation(0, 1, 0) * Transform::rotation_z(.5) * Transform::scaling(1, 2, 1);
+    Group copy;
+    copy.transform = placement;
+    copy.add_child(transformed_hierarchy());
+    std::shared_ptr<Group> prototype = transformed_hierarchy();
+    prototype->build_bvh();
+    Instance instance(prototype, placement);
+
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<double> coord(-3, 3);
+    int hits = 0;
+    for (int i = 0; i < 2000; i++) {
+        Point from(coord(rng), coord(rng), -6);
+        Point to(coord(rng), coord(rng), coord(rng));
+        Ray r(from, Vector(to - from).normalized());
+        REQUIRE(instance.intersect(r).count == copy.intersect(r).count);
+        REQUIRE(instance.occluded(r, 8) == copy.occluded(r, 8));
+        auto expected = copy.intersect_closest(r);
+        auto actual = instance.intersect_closest(r);
+        REQUIRE(actual.has_value() == expected.has_value());
+        if (expected) {
+            hits++;
+            REQUIRE(double_equal(actual->t, expected->t));
+            REQUIRE(actual->object == &instance);
+            Point p = r.position(expected->t);
+            REQUIRE(instance.normal_at(p, *actual) == expected->object->normal_at(p, *expected));
+        }
+    }
+    REQUIRE(hits > 100);
+}
+
+TEST_CASE("Instances share their prototype and may override its material", "[shapes][instances]") {
+    auto sphere = std::make_shared<Sphere>();
+    sphere->material.color = Color(1, 0, 0);
+    Material blue;
+    blue.color = Color(0, 0, 1);
+    Instance a(sphere, Transform::translation(-2, 0, 0));
+    Instance b(sphere, Transform::translation(2, 0, 0), blue);
+    REQUIRE(a.prototype.get() == b.prototype.get());
+    REQUIRE(sphere.use_count() == 3);
+
+    auto hit = b.intersect_closest(Ray(Point(2, 0, -5), Vector(0, 0, 1)));
+    REQUIRE(hit.has_value());
+    REQUIRE(hit->object == &b);
+    REQUIRE(hit->leaf == sphere.get());
+    REQUIRE(hit->object->material_at(*hit).color == Color(0, 0, 1));
+    REQUIRE(!a.intersect_closest(Ray(Point(2, 0, -5), Vector(0, 0, 1))).has_value());
+
+    hit = a.intersect_closest(Ray(Point(-2, 0, -5), Vector(0, 0, 1)));
+    REQUIRE(hit.has_value());
+    REQUIRE(hit->object->material_at(*hit).color == Color(1, 0, 0));
+}
+
+TEST_CASE("An instance of a group shades and refracts with each leaf's material", "[shapes][instances][refraction]") {
+    auto prototype = std::make_shared<Group>();
+    auto outer = std::make_unique<GlassSphere>();
+    outer->transform = Transform::scaling(2, 2, 2);
+    outer->material.color = Color(1, 0, 0);
+    auto inner = std::make_unique<GlassSphere>();
+    inner->material.refractive_index = 2;
+    inner->material.color = Color(0, 1, 0);
+    const Shape* outer_leaf = outer.get();
+    const Shape* inner_leaf = inner.get();
+    prototype->add_children(std::move(outer), std::move(inner));
+    prototype->build_bvh();
+    Instance instance(prototype, Transform::translation(0, 0, 1));
+
+    Ray r(Point(0, 0, -5), Vector(0, 0, 1));
+    auto xs = instance.intersect(r);
+    REQUIRE(xs.count == 4);
+    std::sort(xs.intersections.begin(), xs.intersections.end(),
+        [](const Intersection& a, const Intersection& b) { return a.t < b.t; });
+    std::vector<const Shape*> leaves = { outer_leaf, inner_leaf, inner_leaf, outer_leaf };
+    std::vector<double> n1 = { 1, 1.5, 2, 1.5 };
+    std::vector<double> n2 = { 1.5, 2, 1.5, 1 };
+    for (size_t i = 0; i < xs.count; i++) {
+        REQUIRE(xs.intersections[i].leaf == leaves[i]);
+        auto comps = PrecomputedIntersection::prepare_computations(xs.intersections[i], r, &xs);
+        REQUIRE(comps.material == &leaves[i]->material);
+        REQUIRE(double_equal(comps.n1, n1[i]));
+        REQUIRE(double_equal(comps.n2, n2[i]));
+    }
+}
@@ -225,4 +225,71 @@ TEST_CASE("Multiplying a product by its inverse", "[matrices]") {
     Matrix C = A * B;
 
     REQUIRE(C * B.inverse() == A);
-}
\ No newline at end of file
+}
+
+TEST_CASE("A fixed-size 4x4 matrix matches the general matrix product", "[matrices][matrix4]") {
+    Matrix A(4, 4);
+    A = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 8, 7, 6, 5, 4, 3, 2 };
+    Matrix B(4, 4);
+    B = { -2, 1, 2, 3, 3, 2, 1, -1, 4, 3, 6, 5, 1, 2, 7, 8 };
+
+    Matrix4 A4(A);
+    Matrix4 B4(B);
+    REQUIRE(A4 * B4 == A * B);
+    REQUIRE(Matrix(A4 * B4) == A * B);
+}
+
+TEST_CASE("A fixed-size 4x4 matrix multiplied by a tuple", "[matrices][matrix4]") {
+    Matrix4 A;
+    A = { 1, 2, 3, 4, 2, 4, 4, 2, 8, 6, 4, 1, 0, 0, 0, 1 };
+    Tuple b = Tuple(1, 2, 3, 1);
+
+    REQUIRE(A * b == Tuple(18, 24, 33, 1));
+    REQUIRE(A.transpose_multiply(b) == A.transpose() * b);
+}
+
+TEST_CASE("The fixed-size identity matrix", "[matrices][matrix4]") {
+    Matrix4 A;
+    A = { 0, 1, 2, 4, 1, 2, 4, 8, 2, 4, 8, 16, 4, 8, 16, 32 };
+
+    REQUIRE(Matrix4::identity() == identity_matrix4);
+    REQUIRE(A * Matrix4::identity() == A);
+    REQUIRE(Matrix4::identity().transpose() == Matrix4::identity());
+}
+
+TEST_CASE("Calculating the inverse of a fixed-size 4x4 matrix", "[matrices][matrix4]") {
+    Matrix4 A;
+    A = { 8, -5, 9, 2, 7, 5, 6, 1, -6, 0, 9, 6, -3, 0, -9, -4 };
+    Matrix A_inverse(4, 4);
+    A_inverse = { -0.15385, -0.15385, -0.28205, -0.53846, -0.07692, 0.12308,
+                 0.02564,  0.03077,  0.35897,  0.35897,  0.43590,  0.92308,
+                 -0.69231, -0.69231, -0.76923, -1.92308 };
+    REQUIRE(A.inverse() == A_inverse);
+    REQUIRE(A * A.inverse() == Matrix4::identity());
+}
+
+TEST_CASE("Calculating the determinant of a fixed-size 4x4 matrix", "[matrices][matrix4]") {
+    Matrix4 A;
+    A = { -2, -8, 3, 5, -3, 1, 7, 3, 1, 2, -9, 6, -6, 7, 7, -9 };
+    REQUIRE(A.determinant() == -4071);
+    REQUIRE(A.determinant() == Matrix(A).determinant());
+}
+
+TEST_CASE("A singular fixed-size 4x4 matrix has no inverse", "[matrices][matrix4]") {
+    Matrix4 A;
+    A = { -4, 2, -2, -3, 9, 6, 2, 6, 0, -5, 1, -5, 0, 0, 0, 0 };
+    REQUIRE(!A.is_invertible());
+    REQUIRE(!A.try_inverse().has_value());
+}
+
+TEST_CASE("The affine inverse matches the cofactor inverse", "[matrices][matrix4]") {
+    Matrix4 A;
+    A = { 3, -9, 7, 3, 3, -8, 2, -9, -4, 4, 4, 1, 0, 0, 0, 1 };
+    REQUIRE(A.is_affine());
+    REQUIRE(A.inverse() == Matrix(A).inverse());
+
+    Matrix4 B;
+    B = { 9, 3, 0, 9, -5, -2, -6, -3, -4, 9, 6, 4, -7, 6, 6, 2 };
+    REQUIRE(!B.is_affine());
+    REQUIRE(B.inverse() == Matrix(B).inverse());
+}
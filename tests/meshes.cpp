@@ -0,0 +1,329 @@
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+#include "../src/geometry/shapes/all_shapes.hpp"
+#include "../src/geometry/shapes/mesh_cache.hpp"
+#include "../src/geometry/shapes/obj_parser.hpp"
+#include "../src/rendering/thread_pool.hpp"
+
+namespace {
+    // The book's smooth triangle next to a flat one, sharing p1
+    std::shared_ptr<MeshBuffers> two_face_buffers() {
+        auto buffers = std::make_shared<MeshBuffers>();
+        buffers->vertices = { Point(0, 1, 0), Point(-1, 0, 0), Point(1, 0, 0),
+            Point(0, 1, 5), Point(-1, 0, 5), Point(1, 0, 5) };
+        buffers->normals = { Vector(0, 1, 0), Vector(-1, 0, 0), Vector(1, 0, 0) };
+        return buffers;
+    }
+}
+
+TEST_CASE("Constructing a triangle mesh", "[triangles][meshes]") {
+    TriangleMesh mesh(two_face_buffers(), { 0, 1, 2, 3, 4, 5 });
+    REQUIRE(mesh.face_count() == 2);
+    REQUIRE(mesh.bounds_of().min == Point(-1, 0, 0));
+    REQUIRE(mesh.bounds_of().max == Point(1, 1, 5));
+    REQUIRE(!mesh.wide_bvh().empty());
+}
+
+TEST_CASE("A mesh intersection records the face and its u/v", "[triangles][meshes]") {
+    TriangleMesh mesh(two_face_buffers(), { 0, 1, 2, 3, 4, 5 });
+    Ray r(Point(-.2, .3, -2), Vector(0, 0, 1));
+    auto xs = mesh.intersect(r);
+    REQUIRE(xs.count == 2);
+    REQUIRE(double_equal(xs.intersections[0].t, 2));
+    REQUIRE(xs.intersections[0].face == 0);
+    REQUIRE(double_equal(xs.intersections[0].u, 0.45));
+    REQUIRE(double_equal(xs.intersections[0].v, 0.25));
+    REQUIRE(double_equal(xs.intersections[1].t, 7));
+    REQUIRE(xs.intersections[1].face == 1);
+
+    auto closest = mesh.intersect_closest(r);
+    REQUIRE(closest.has_value());
+    REQUIRE(closest->face == 0);
+    REQUIRE(mesh.occluded(r, 7.5));
+    REQUIRE(!mesh.occluded(r, 1.5));
+    REQUIRE(mesh.intersect_closest(Ray(Point(0, 0.5, 1), Vector(0, 0, 1)))->face == 1);
+    REQUIRE(!mesh.intersect_closest(Ray(Point(2, 0.5, -2), Vector(0, 0, 1))).has_value());
+}
+
+TEST_CASE("A mesh face with normals interpolates them like a smooth triangle", "[triangles][meshes]") {
+    TriangleMesh mesh(two_face_buffers(), { 0, 1, 2, 3, 4, 5 },
+        { 0, 1, 2, TriangleMesh::NO_NORMAL, TriangleMesh::NO_NORMAL, TriangleMesh::NO_NORMAL });
+    REQUIRE(mesh.normal_at(Point(0, 0, 0), Intersection(1, &mesh, .45, .25, 0)) ==
+        Vector(-0.5547, 0.83205, 0));
+    // Flat face: the same normal as a Triangle
+    Triangle t(Point(0, 1, 5), Point(-1, 0, 5), Point(1, 0, 5));
+    REQUIRE(mesh.normal_at(Point(0, 0, 5), Intersection(1, &mesh, .45, .25, 1)) ==
+        t.normal_at(Point(0, 0, 5)));
+}
+
+TEST_CASE("Every SIMD level intersects triangle packets like intersect_triangle", "[triangles][meshes]") {
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<double> coord(-2, 2);
+    auto random_point = [&] { return Point(coord(rng), coord(rng), coord(rng)); };
+
+    for (int n = 0; n < 2000; n++) {
+        TrianglePacket packet;
+        Point p[4][3];
+        int lanes = n % 4 + 1; // the rest stay empty
+        for (int lane = 0; lane < lanes; lane++) {
+            for (auto& vertex : p[lane]) {
+                vertex = random_point();
+            }
+            // Some degenerate and edge-on cases
+            if (n % 7 == 0) {
+                p[lane][2] = p[lane][1];
+            }
+            packet.set(lane, p[lane][0], p[lane][1], p[lane][2]);
+        }
+        Ray r(random_point(), Vector(coord(rng), coord(rng), coord(rng)));
+        if (n % 11 == 0) {
+            r = Ray(p[0][0], p[0][1] - p[0][0]);
+        }
+
+        unsigned expected_mask = 0;
+        double expected[4][3];
+        for (int lane = 0; lane < lanes; lane++) {
+            double t, u, v;
+            if (intersect_triangle(r, p[lane][0], p[lane][1] - p[lane][0], p[lane][2] - p[lane][0], t, u, v)) {
+                expected_mask |= 1u << lane;
+                expected[lane][0] = t;
+                expected[lane][1] = u;
+                expected[lane][2] = v;
+            }
+        }
+
+        for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2 }) {
+            if (!simd_level_supported(level)) {
+                continue;
+            }
+            double t[4], u[4], v[4];
+            unsigned mask = packet_intersector(level)(packet, r, t, u, v);
+            REQUIRE(mask == expected_mask);
+            for (int lane = 0; lane < lanes; lane++) {
+                if (mask & (1u << lane)) {
+                    REQUIRE(t[lane] == expected[lane][0]);
+                    REQUIRE(u[lane] == expected[lane][1]);
+                    REQUIRE(v[lane] == expected[lane][2]);
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("Large meshes build on the threads their options give", "[triangles][meshes][bvh]") {
+    // Enough faces for a parallel build
+    std::mt19937 rng(9);
+    std::uniform_real_distribution<double> coord(-50, 50);
+    auto buffers = std::make_shared<MeshBuffers>();
+    std::vector<uint32_t> indices;
+    for (uint32_t face = 0; face < 20'000; face++) {
+        Point p(coord(rng), coord(rng), coord(rng));
+        buffers->vertices.insert(buffers->vertices.end(), { p, p + Vector(1, 0, 0), p + Vector(0, 1, 0) });
+        indices.insert(indices.end(), { 3 * face, 3 * face + 1, 3 * face + 2 });
+    }
+    TriangleMesh reference(buffers, indices);
+
+    // As from inside another pool's work: each build stays on its task's thread
+    SAHOptions options;
+    options.num_threads = 1;
+    std::vector<std::unique_ptr<TriangleMesh>> meshes(2);
+    ThreadPool pool(2);
+    for_each_chunk(&pool, meshes.size(), [&](size_t i) {
+        meshes[i] = std::make_unique<TriangleMesh>(buffers, indices, std::vector<uint32_t>(), options);
+        });
+    for (const auto& mesh : meshes) {
+        REQUIRE(mesh->wide_bvh().indices == reference.wide_bvh().indices);
+        REQUIRE(mesh->wide_bvh().nodes.size() == reference.wide_bvh().nodes.size());
+    }
+}
+
+TEST_CASE("Converting OBJ data to meshes", "[triangles][meshes][obj_files]") {
+    auto model = ObjParser::mesh_from_obj_data(ObjParser::parse_obj_data(
+        "v -1 1 0\nv -1 0 0\nv 1 0 0\nv 1 1 0\n"
+        "g FirstGroup\nf 1 2 3\ng SecondGroup\nf 1 3 4\ng FirstGroup\nf 2 3 4\n"));
+    // Nothing is in DefaultGroup, so it gets no mesh
+    REQUIRE(model->shapes.size() == 2);
+    auto first = dynamic_cast<TriangleMesh*>(model->shapes[0].get());
+    auto second = dynamic_cast<TriangleMesh*>(model->shapes[1].get());
+    REQUIRE(first->face_count() == 2);
+    REQUIRE(second->face_count() == 1);
+    REQUIRE(first->buffers == second->buffers);
+    REQUIRE(first->normal_indices.empty());
+    REQUIRE(first->buffers->vertices[second->indices[2]] == Point(1, 1, 0));
+}
+
+TEST_CASE("A mesh gives the same hits as the OBJ's triangles", "[triangles][meshes][obj_files]") {
+    const char* file = "../tests/test_files/teapot.obj";
+    auto triangles = ObjParser::parse_obj_file_mapped(file).obj_to_group();
+    triangles->build_bvh();
+    auto meshes = ObjParser::parse_obj_mesh(file);
+    BoundingBox bb = meshes->bounds_of();
+    REQUIRE(bb.min == triangles->bounds_of().min);
+    REQUIRE(bb.max == triangles->bounds_of().max);
+
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> unit(-1, 1);
+    Point center = bb.centroid();
+    for (int i = 0; i < 500; i++) {
+        Point target = center + Vector(unit(rng) * 10, unit(rng) * 10, unit(rng) * 10);
+        Point origin(unit(rng) * 60, unit(rng) * 60, -50);
+        Ray r(origin, target - origin);
+
+        auto expected = triangles->intersect_closest(r);
+        auto hit = meshes->intersect_closest(r);
+        REQUIRE(hit.has_value() == expected.has_value());
+        REQUIRE(meshes->intersect(r).count == triangles->intersect(r).count);
+        if (hit) {
+            REQUIRE(double_equal(hit->t, expected->t));
+            Point p = r.position(hit->t);
+            REQUIRE(hit->object->normal_at(p, *hit) == expected->object->normal_at(p, *expected));
+        }
+    }
+}
+
+TEST_CASE("Meshes round trip through the mesh cache", "[triangles][meshes][obj_files]") {
+    auto model = ObjParser::mesh_from_obj_data(ObjParser::parse_obj_data(
+        "v 0 1 0\nv -1 0 0\nv 1 0 0\nv 1 1 0\nvn -1 0 0\nvn 1 0 0\nvn 0 1 0\n"
+        "g smooth\nf 1//3 2//1 3//2\nf 1 3 4\ng flat\nf 2 3 4\n"));
+    std::string path = (std::filesystem::temp_directory_path() / "meshes_test.rtmesh").string();
+    MeshCacheKey key{ 1234, 5678 };
+    REQUIRE(MeshCache::save(path, *model, key));
+
+    auto loaded = MeshCache::load(path, key);
+    REQUIRE(loaded);
+    REQUIRE(loaded->shapes.size() == model->shapes.size());
+    for (size_t m = 0; m < model->shapes.size(); m++) {
+        auto mesh = dynamic_cast<TriangleMesh*>(model->shapes[m].get());
+        auto copy = dynamic_cast<TriangleMesh*>(loaded->shapes[m].get());
+        REQUIRE(copy->indices == mesh->indices);
+        REQUIRE(copy->normal_indices == mesh->normal_indices);
+        REQUIRE(copy->bounds_of().min == mesh->bounds_of().min);
+        REQUIRE(copy->bounds_of().max == mesh->bounds_of().max);
+        REQUIRE(copy->wide_bvh().indices == mesh->wide_bvh().indices);
+        REQUIRE(copy->wide_bvh().nodes.size() == mesh->wide_bvh().nodes.size());
+        REQUIRE(copy->buffers->vertices.size() == mesh->buffers->vertices.size());
+        for (size_t i = 1; i < mesh->buffers->vertices.size(); i++) {
+            REQUIRE(copy->buffers->vertices[i] == mesh->buffers->vertices[i]);
+        }
+    }
+    auto first = dynamic_cast<TriangleMesh*>(loaded->shapes[0].get());
+    REQUIRE(first->buffers == dynamic_cast<TriangleMesh*>(loaded->shapes[1].get())->buffers);
+    Ray r(Point(-.2, .3, -2), Vector(0, 0, 1));
+    auto hit = loaded->intersect_closest(r);
+    REQUIRE(hit.has_value());
+    REQUIRE(hit->object->normal_at(r.position(hit->t), *hit) ==
+        model->shapes[0]->normal_at(r.position(hit->t), *model->shapes[0]->intersect_closest(r)));
+
+    // Stale key
+    REQUIRE(!MeshCache::load(path, MeshCacheKey{ 1234, 5679 }));
+    REQUIRE(!MeshCache::load(path + ".missing", key));
+
+    // An unused node slot whose box a ray could enter
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        WideBVHNode root = dynamic_cast<TriangleMesh*>(model->shapes[0].get())->wide_bvh().nodes[0];
+        size_t offset = bytes.find(std::string(reinterpret_cast<const char*>(&root), sizeof(root)));
+        REQUIRE(offset != std::string::npos);
+        int slot = WideBVHNode::WIDTH - 1;
+        REQUIRE((root.count[slot] == 0 && root.child[slot] == 0));
+        for (int axis = 0; axis < 3; axis++) {
+            root.min[axis][slot] = -1;
+            root.max[axis][slot] = 1;
+        }
+        file.clear();
+        file.seekp(offset);
+        file.write(reinterpret_cast<const char*>(&root), sizeof(root));
+    }
+    REQUIRE_THROWS_AS(MeshCache::load(path, key), std::runtime_error);
+    REQUIRE(MeshCache::save(path, *model, key));
+
+    // Truncated file
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 8);
+    REQUIRE_THROWS_AS(MeshCache::load(path, key), std::runtime_error);
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("A mesh cache whose nodes share a child is rejected", "[triangles][meshes][obj_files]") {
+    // Enough faces for a root with several inner children
+    std::mt19937 rng(13);
+    std::uniform_real_distribution<double> coord(-50, 50);
+    auto buffers = std::make_shared<MeshBuffers>();
+    std::vector<uint32_t> indices;
+    for (uint32_t face = 0; face < 500; face++) {
+        Point p(coord(rng), coord(rng), coord(rng));
+        buffers->vertices.insert(buffers->vertices.end(), { p, p + Vector(1, 0, 0), p + Vector(0, 1, 0) });
+        indices.insert(indices.end(), { 3 * face, 3 * face + 1, 3 * face + 2 });
+    }
+    auto model = std::make_unique<Group>();
+    model->add_child(std::make_unique<TriangleMesh>(buffers, indices));
+    std::string path = (std::filesystem::temp_directory_path() / "meshes_shared_node.rtmesh").string();
+    MeshCacheKey key{ 1234, 5678 };
+    REQUIRE(MeshCache::save(path, *model, key));
+    REQUIRE(MeshCache::load(path, key));
+
+    // Point the root's second inner child at its first, so a depth check
+    // that only keeps the last parent's depth would pass
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        WideBVHNode root = dynamic_cast<TriangleMesh*>(model->shapes[0].get())->wide_bvh().nodes[0];
+        size_t offset = bytes.find(std::string(reinterpret_cast<const char*>(&root), sizeof(root)));
+        REQUIRE(offset != std::string::npos);
+        std::vector<int> inner;
+        for (int slot = 0; slot < WideBVHNode::WIDTH; slot++) {
+            if (root.count[slot] == 0 && root.child[slot] != 0) {
+                inner.push_back(slot);
+            }
+        }
+        REQUIRE(inner.size() >= 2);
+        root.child[inner[1]] = root.child[inner[0]];
+        file.clear();
+        file.seekp(offset);
+        file.write(reinterpret_cast<const char*>(&root), sizeof(root));
+    }
+    REQUIRE_THROWS_AS(MeshCache::load(path, key), std::runtime_error);
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Loading an OBJ through the mesh cache", "[triangles][meshes][obj_files]") {
+    auto dir = std::filesystem::temp_directory_path();
+    std::string obj = (dir / "meshes_test.obj").string();
+    std::string cache = (dir / "meshes_test_obj.rtmesh").string();
+    std::filesystem::remove(cache);
+    {
+        std::ofstream out(obj);
+        out << "v -1 1 0\nv -1 0 0\nv 1 0 0\nv 1 1 0\nf 1 2 3 4\n";
+    }
+
+    auto parsed = ObjParser::load_obj_mesh(obj.c_str(), cache);
+    REQUIRE(std::filesystem::exists(cache));
+    auto cached = MeshCache::load(cache, MeshCacheKey::of(obj.c_str()));
+    REQUIRE(cached);
+    REQUIRE(dynamic_cast<TriangleMesh*>(cached->shapes[0].get())->face_count() == 2);
+
+    // Editing the OBJ invalidates the cache, which is rewritten
+    {
+        std::ofstream out(obj, std::ios::app);
+        out << "v 0 2 0\nf 1 4 5\n";
+    }
+    auto reparsed = ObjParser::load_obj_mesh(obj.c_str(), cache);
+    REQUIRE(dynamic_cast<TriangleMesh*>(reparsed->shapes[0].get())->face_count() == 3);
+    REQUIRE(MeshCache::load(cache, MeshCacheKey::of(obj.c_str())));
+
+    // A corrupt cache is rebuilt rather than trusted
+    {
+        std::fstream out(cache, std::ios::in | std::ios::out | std::ios::binary);
+        out.seekp(-8, std::ios::end); // the last BVH index, before the padding
+        out.write("\xff\xff\xff\xff", 4);
+    }
+    auto rebuilt = ObjParser::load_obj_mesh(obj.c_str(), cache);
+    REQUIRE(dynamic_cast<TriangleMesh*>(rebuilt->shapes[0].get())->face_count() == 3);
+    REQUIRE(MeshCache::load(cache, MeshCacheKey::of(obj.c_str())));
+
+    std::filesystem::remove(obj);
+    std::filesystem::remove(cache);
+}
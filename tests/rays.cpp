@@ -1,6 +1,8 @@
 #include <catch2/catch_approx.hpp>
 #include <catch2/catch_test_macros.hpp>
 
+#include <thread>
+
 #include "../src/geometry/intersection.hpp"
 #include "../src/geometry/ray.hpp"
 #include "../src/geometry/shapes/shapes.hpp"
@@ -72,6 +74,18 @@ TEST_CASE("A sphere is behind a ray", "[rays]") {
     REQUIRE(double_equal(xs.intersections[1].t, -4));
 }
 
+TEST_CASE("A distant ray hits a flattened sphere at both faces", "[rays]") {
+    // The textbook b^2 - 4ac cancels badly here: both terms are ~1e18
+    Ray r(Point(0, 0, -1e6), Vector(0, 0, 1));
+    auto s = std::make_unique<Sphere>();
+    s.get()->transform = Transform::scaling(200, 200, .01);
+    IntersectionRecord xs = s.get()->intersect(r);
+
+    REQUIRE(xs.count == 2);
+    REQUIRE(double_equal(xs.intersections[0].t, 1e6 - .01));
+    REQUIRE(double_equal(xs.intersections[1].t, 1e6 + .01));
+}
+
 TEST_CASE("An intersection encapsulates t and object", "[rays]") {
     auto s = std::make_unique<Sphere>();
     Intersection i(3.5, s.get());
@@ -150,6 +164,32 @@ TEST_CASE("Scaling a ray", "[rays]") {
     REQUIRE(r2.dir == Vector(0, 3, 0));
 }
 
+TEST_CASE("A ray precomputes its inverse direction and sign bits", "[rays]") {
+    Ray r(Point(0, 0, 0), Vector(2, -4, 0));
+    REQUIRE(r.inv_dir.x == .5);
+    REQUIRE(r.inv_dir.y == -.25);
+    REQUIRE(r.inv_dir.z == INFINITY);
+    REQUIRE(r.sign[0] == 0);
+    REQUIRE(r.sign[1] == 1);
+    REQUIRE(r.sign[2] == 0);
+    REQUIRE(r.tmin == -INFINITY);
+    REQUIRE(r.tmax == INFINITY);
+
+    Ray negative_zero(Point(0, 0, 0), Vector(1, 1, -0.0));
+    REQUIRE(negative_zero.inv_dir.z == -INFINITY);
+    REQUIRE(negative_zero.sign[2] == 1);
+}
+
+TEST_CASE("Transforming a ray keeps its interval and updates its inverse direction", "[rays]") {
+    Ray r = Ray(Point(1, 2, 3), Vector(0, 1, -1)).clipped(0, 10);
+    Ray r2 = r.transform(Transform::scaling(2, 4, 4));
+    REQUIRE(r2.tmin == 0);
+    REQUIRE(r2.tmax == 10);
+    REQUIRE(r2.inv_dir.y == .25);
+    REQUIRE(r2.inv_dir.z == -.25);
+    REQUIRE(r2.sign[2] == 1);
+}
+
 TEST_CASE("A sphere's default transformation", "[rays][objects]") {
     Sphere s;
     REQUIRE(s.transform == identity_matrix4);
@@ -182,4 +222,95 @@ TEST_CASE("Intersecting a translated sphere with a ray", "[rays]") {
     IntersectionRecord xs = s->intersect(r);
 
     REQUIRE(xs.count == 0);
-}
\ No newline at end of file
+}
+
+TEST_CASE("Intersection records keep small lists inline", "[rays][intersection_buffer]") {
+    Sphere s;
+    IntersectionRecord xs;
+    for (int i = 0; i < 8; i++) {
+        xs.append_record(Intersection(i, &s));
+    }
+    REQUIRE(xs.count == 8);
+    REQUIRE(xs.intersections.is_inline());
+
+    xs.append_record(Intersection(8, &s));
+    REQUIRE(xs.count == 9);
+    REQUIRE_FALSE(xs.intersections.is_inline());
+    for (size_t i = 0; i < xs.count; i++) {
+        REQUIRE(xs.intersections[i].t == i);
+    }
+}
+
+TEST_CASE("Merging intersection records", "[rays][intersection_buffer]") {
+    Sphere s;
+    IntersectionRecord big;
+    for (int i = 0; i < 20; i++) {
+        big.append_record(Intersection(i, &s));
+    }
+    const Intersection* storage = big.intersections.data();
+
+    // Moving into an empty record takes over the spilled storage
+    IntersectionRecord xs;
+    xs.append_record(std::move(big));
+    REQUIRE(xs.count == 20);
+    REQUIRE(xs.intersections.data() == storage);
+    REQUIRE(big.count == 0);
+    REQUIRE(big.intersections.empty());
+
+    // Otherwise the hits are appended
+    IntersectionRecord ys(Intersection(-1, &s), Intersection(-2, &s));
+    ys.append_record(std::move(xs));
+    REQUIRE(ys.count == 22);
+    REQUIRE(ys.intersections.size() == 22);
+    REQUIRE(ys.intersections[1].t == -2);
+    REQUIRE(ys.intersections[21].t == 19);
+
+    IntersectionRecord copy = ys;
+    REQUIRE(copy.intersections.size() == 22);
+    REQUIRE(copy.intersections.data() != ys.intersections.data());
+    REQUIRE(copy.intersections[21] == ys.intersections[21]);
+}
+
+TEST_CASE("Spilled buffers are recycled", "[rays][intersection_buffer]") {
+    Sphere s;
+    const Intersection* first;
+    {
+        IntersectionBuffer buffer;
+        for (int i = 0; i < 12; i++) {
+            buffer.push_back(Intersection(i, &s));
+        }
+        first = buffer.data();
+    }
+    IntersectionBuffer buffer;
+    for (int i = 0; i < 12; i++) {
+        buffer.push_back(Intersection(i, &s));
+    }
+    REQUIRE(buffer.data() == first);
+    REQUIRE(buffer.capacity() == 16);
+}
+
+namespace {
+    // Built before the thread's arena, so destroyed after it
+    struct SpillsOnExit {
+        bool* spilled;
+        ~SpillsOnExit() {
+            IntersectionBuffer buffer;
+            for (int i = 0; i < 12; i++) {
+                buffer.push_back(Intersection(i, nullptr));
+            }
+            *spilled = buffer.size() == 12;
+        }
+    };
+}
+
+TEST_CASE("Buffers can spill after their thread's arena is gone", "[rays][intersection_buffer]") {
+    bool spilled = false;
+    std::thread([&] {
+        thread_local SpillsOnExit late{ &spilled };
+        IntersectionBuffer buffer;
+        for (int i = 0; i < 12; i++) {
+            buffer.push_back(Intersection(i, nullptr));
+        }
+        }).join();
+    REQUIRE(spilled);
+}
@@ -36,7 +36,7 @@ TEST_CASE("The reflected color for a reflective material", "[reflections][world]
     Plane* shape = shape_u.get();
     shape->material.reflective = .5;
     shape->transform = Transform::translation(0, -1, 0);
-    w.objects.emplace(shape, std::move(shape_u));
+    w.add_object(std::move(shape_u));
 
     Ray r(Point(0, 0, -3), Vector(0, -sqrt(2) / 2, sqrt(2) / 2));
     Intersection i(sqrt(2), shape);
@@ -52,7 +52,7 @@ TEST_CASE("shade_hit() with a reflective material", "[reflections][world]") {
     Plane* shape = shape_u.get();
     shape->material.reflective = .5;
     shape->transform = Transform::translation(0, -1, 0);
-    w.objects.emplace(shape, std::move(shape_u));
+    w.add_object(std::move(shape_u));
 
     Ray r(Point(0, 0, -3), Vector(0, -sqrt(2) / 2, sqrt(2) / 2));
     Intersection i(sqrt(2), shape);
@@ -69,13 +69,13 @@ TEST_CASE("color_at() with mutually reflective surfaces", "[reflections][world]"
     Plane* lower = lower_u.get();
     lower->material.reflective = 1;
     lower->transform = Transform::translation(0, -1, 0);
-    w.objects.emplace(lower, std::move(lower_u));
+    w.add_object(std::move(lower_u));
 
     auto upper_u = std::make_unique<Plane>();
     Plane* upper = upper_u.get();
     upper->material.reflective = 1;
     upper->transform = Transform::translation(0, 1, 0);
-    w.objects.emplace(upper, std::move(upper_u));
+    w.add_object(std::move(upper_u));
 
     Ray r(Point(0, 0, 0), Vector(0, 1, 0));
 
@@ -88,7 +88,7 @@ TEST_CASE("The reflected color at the maximum recursive depth", "[reflections][w
     Plane* shape = shape_u.get();
     shape->material.reflective = .5;
     shape->transform = Transform::translation(0, -1, 0);
-    w.objects.emplace(shape, std::move(shape_u));
+    w.add_object(std::move(shape_u));
 
     Ray r(Point(0, 0, -3), Vector(0, -sqrt(2) / 2, sqrt(2) / 2));
     Intersection i(sqrt(2), shape);
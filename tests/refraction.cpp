@@ -115,14 +115,14 @@ TEST_CASE("shade_hit() with a transparent material", "[refraction][world]") {
     floor->transform = Transform::translation(0, -1, 0);
     floor->material.transparency = .5;
     floor->material.refractive_index = 1.5;
-    w.objects.emplace(floor, std::move(floor_u));
+    w.add_object(std::move(floor_u));
 
     auto ball_u = std::make_unique<Sphere>();
     Sphere* ball = ball_u.get();
     ball->material.color = Color(1, 0, 0);
     ball->material.ambient = .5;
     ball->transform = Transform::translation(0, -3.5, -.5);
-    w.objects.emplace(ball, std::move(ball_u));
+    w.add_object(std::move(ball_u));
 
     Ray r(Point(0, 0, -3), Vector(0, -sqrt(2) / 2, sqrt(2) / 2));
     auto xs = IntersectionRecord(Intersection(sqrt(2), floor));
@@ -169,14 +169,14 @@ TEST_CASE("shade_hit() with a reflective, transparent material", "[refraction][s
     floor->material.reflective = .5;
     floor->material.transparency = .5;
     floor->material.refractive_index = 1.5;
-    w.objects.emplace(floor, std::move(floor_u));
+    w.add_object(std::move(floor_u));
 
     auto ball_u = std::make_unique<Sphere>();
     Sphere* ball = ball_u.get();
     ball->material.color = Color(1, 0, 0);
     ball->material.ambient = .5;
     ball->transform = Transform::translation(0, -3.5, -.5);
-    w.objects.emplace(ball, std::move(ball_u));
+    w.add_object(std::move(ball_u));
 
     auto xs = IntersectionRecord(Intersection(sqrt(2), floor));
     auto comps = PrecomputedIntersection::prepare_computations(xs.intersections[0], r, &xs);
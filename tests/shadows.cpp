@@ -46,8 +46,8 @@ TEST_CASE("shade_hit() is given an intersection in shadow",
 
     auto comps = PrecomputedIntersection::prepare_computations(i, r);
 
-    w.objects.emplace(s1_u.get(), std::move(s1_u));
-    w.objects.emplace(s2_u.get(), std::move(s2_u));
+    w.add_object(std::move(s1_u));
+    w.add_object(std::move(s2_u));
     Color c = w.shade_hit(comps);
     REQUIRE(c == Color(.1, .1, .1));
 }
@@ -62,3 +62,57 @@ TEST_CASE("The hit should offset the point", "[shadows][intersections]") {
     REQUIRE(comps.over_point.z < -EPSILON / 2);
     REQUIRE(comps.point.z > comps.over_point.z);
 }
+
+TEST_CASE("Occlusion only counts hits in front of tmax", "[shadows][occlusion]") {
+    Sphere s;
+    s.transform = Transform::translation(0, 0, 5);
+    Ray r(Point(0, 0, 0), Vector(0, 0, 1));
+    REQUIRE(s.occluded(r, INFINITY));
+    REQUIRE(s.occluded(r, 4.5));
+    REQUIRE_FALSE(s.occluded(r, 4));
+
+    // Hits behind the origin don't occlude
+    Ray away(Point(0, 0, 0), Vector(0, 0, -1));
+    REQUIRE_FALSE(s.occluded(away, INFINITY));
+
+    Triangle t(Point(0, 1, 2), Point(-1, 0, 2), Point(1, 0, 2));
+    REQUIRE(t.occluded(Ray(Point(0, .5, 0), Vector(0, 0, 1)), 3));
+    REQUIRE_FALSE(t.occluded(Ray(Point(0, .5, 0), Vector(0, 0, 1)), 1));
+
+    Plane p;
+    REQUIRE(p.occluded(Ray(Point(0, 1, 0), Vector(0, -1, 0)), 2));
+    REQUIRE_FALSE(p.occluded(Ray(Point(0, 1, 0), Vector(0, -1, 0)), 1));
+}
+
+TEST_CASE("Occlusion through a group matches its intersections", "[shadows][occlusion][groups]") {
+    Group g;
+    for (int i = 0; i < 20; i++) {
+        auto s_u = std::make_unique<Sphere>();
+        s_u.get()->transform = Transform::translation(i * 3, 0, 0) * Transform::scaling(.5, .5, .5);
+        g.add_child(std::move(s_u));
+    }
+    g.transform = Transform::scaling(2, 2, 2);
+
+    auto check = [&g]() {
+        for (int i = 0; i < 40; i++) {
+            Ray r(Point(i * 3 - 1.1, 5, 0), Vector(0, -1, 0));
+            for (double tmax : { 2.0, 4.0, 10.0 }) {
+                auto hit = g.intersect(r).hit();
+                bool expected = hit.has_value() && hit.value().t < tmax;
+                REQUIRE(g.occluded(r, tmax) == expected);
+            }
+        }
+        };
+    check();
+    g.build_bvh();
+    check();
+}
+
+TEST_CASE("World occlusion queries", "[shadows][occlusion][world]") {
+    auto const [w, s1, s2] = World::default_world();
+    Ray r(Point(0, 0, -5), Vector(0, 0, 1));
+    REQUIRE(w.occluded(r, INFINITY));
+    REQUIRE(w.occluded(r, 4.5));
+    REQUIRE_FALSE(w.occluded(r, 4));
+    REQUIRE_FALSE(w.occluded(Ray(Point(0, 5, -5), Vector(0, 0, 1)), INFINITY));
+}
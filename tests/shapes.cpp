@@ -47,6 +47,15 @@ TEST_CASE("Intersecting a translated shape with a ray", "[shapes]") {
     REQUIRE(s.saved_ray.value().dir == Vector(0, 0, 1));
 }
 
+TEST_CASE("A shape with a singular transform is never hit", "[shapes]") {
+    Ray r(Point(0, 0, -5), Vector(0, 0, 1));
+    Sphere s;
+    s.transform = Transform::translation(0, 0, 1) * Transform::scaling(1, 0, 1);
+    REQUIRE(s.intersect(r).count == 0);
+    REQUIRE(!s.intersect_closest(r).has_value());
+    REQUIRE(!s.occluded(r, 10));
+}
+
 TEST_CASE("Computing the normal on a translated shape", "[shapes]") {
     TestShape s;
     s.transform = Transform::translation(0, 1, 0);
@@ -380,6 +389,10 @@ TEST_CASE("Intersecting a cone with a ray parallel to one of its halves", "[shap
     auto xs = shape.intersect(r);
     REQUIRE(xs.count == 1);
     REQUIRE(double_equal(xs.intersections[0].t, .35355));
+
+    // The hit is at y = .25, outside a truncated cone
+    shape.maximum = .2;
+    REQUIRE(shape.intersect(r).count == 0);
 }
 
 TEST_CASE("Intersecting a cone's end caps", "[shapes][cones]") {
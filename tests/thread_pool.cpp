@@ -0,0 +1,34 @@
+#include "../src/rendering/thread_pool.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+TEST_CASE("A thread pool runs every submitted task", "[threads]") {
+    ThreadPool pool(4);
+    REQUIRE(pool.size() == 4);
+
+    std::atomic<int> count(0);
+    for (int i = 0; i < 1000; i++) {
+        pool.submit([&] { count++; });
+    }
+    pool.wait_idle();
+    REQUIRE(count == 1000);
+}
+
+TEST_CASE("Tasks can submit more tasks to their pool", "[threads]") {
+    ThreadPool pool(3);
+    std::atomic<int> count(0);
+    for (int i = 0; i < 10; i++) {
+        pool.submit([&] {
+            for (int j = 0; j < 10; j++) {
+                pool.submit([&] { count++; });
+            }
+            });
+    }
+    pool.wait_idle();
+    REQUIRE(count == 100);
+}
+
+TEST_CASE("A thread pool defaults to the hardware concurrency", "[threads]") {
+    ThreadPool pool;
+    REQUIRE(pool.size() == ThreadPool::default_thread_count());
+}
@@ -183,4 +183,33 @@ TEST_CASE("An arbitrary view transformation", "[scene][transformations]") {
                        -0.35857, 0.59761, -0.71714, 0.00000,
                        0.00000,  0.00000, 0.00000,  1.00000};
     REQUIRE(t == targetTransform);
-}
\ No newline at end of file
+}
+
+TEST_CASE("A transformation caches its inverse and inverse transpose",
+          "[transformations]") {
+    Transform t = Transform::shearing(1, 0, 0, 0, 0, 1);
+    Matrix4 expected_inverse = Matrix4(Matrix(t).inverse());
+    REQUIRE(t.inverse_matrix() == expected_inverse);
+    REQUIRE(t.inverse_transpose_matrix() == expected_inverse.transpose());
+    REQUIRE(t.inverse().inverse_matrix() == t);
+}
+
+TEST_CASE("Chained transformations compose their cached inverses",
+          "[transformations]") {
+    Transform A = Transform::rotation_x(M_PI / 2);
+    Transform B = Transform::scaling(5, 5, 5);
+    Transform C = Transform::translation(10, 5, 7);
+    Transform T = C * B * A;
+
+    REQUIRE(T.inverse_matrix() == Matrix4(Matrix(T).inverse()));
+    REQUIRE(T * T.inverse() == identity_matrix4);
+}
+
+TEST_CASE("A product with a singular factor is singular", "[transformations]") {
+    Transform flat = Transform::scaling(1, 0, 1);
+    Transform T = Transform::translation(1, 2, 3) * flat * Transform::rotation_y(.5);
+    REQUIRE(!flat.is_invertible());
+    REQUIRE(!T.is_invertible());
+    REQUIRE_THROWS(T.inverse_matrix());
+    REQUIRE((Transform::translation(1, 2, 3) * Transform::rotation_y(.5)).is_invertible());
+}
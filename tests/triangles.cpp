@@ -1,5 +1,7 @@
 #include <catch2/catch_approx.hpp>
 #include <catch2/catch_test_macros.hpp>
+#include <charconv>
+#include <cstring>
 
 #include "../src/geometry/shapes/all_shapes.hpp"
 #include "../src/geometry/shapes/obj_parser.hpp"
@@ -211,4 +213,150 @@ TEST_CASE("Faces with normals", "[triangles][obj_files]") {
     REQUIRE(t2->n2 == parser.normals[1]);
     REQUIRE(t2->n3 == parser.normals[2]);
     // REQUIRE(t1 == t2); // TODO: should triangles with identical values be considered equivalent?
-}
\ No newline at end of file
+}
+
+namespace {
+    // Both parsers have to build the same triangles in the same groups
+    void require_same_parse(const char* filename) {
+        ObjParser expected = ObjParser::parse_obj_file(filename);
+        ObjParser parser = ObjParser::parse_obj_file_mapped(filename);
+        REQUIRE(parser.ignored_lines == expected.ignored_lines);
+        REQUIRE(parser.vertices.size() == expected.vertices.size());
+        for (size_t i = 1; i < parser.vertices.size(); i++) {
+            REQUIRE(parser.vertices[i] == expected.vertices[i]);
+        }
+        REQUIRE(parser.normals.size() == expected.normals.size());
+        for (size_t i = 1; i < parser.normals.size(); i++) {
+            REQUIRE(parser.normals[i] == expected.normals[i]);
+        }
+
+        auto group = std::move(parser).obj_to_group();
+        auto expected_group = std::move(expected).obj_to_group();
+        REQUIRE(group.get()->shapes.size() == expected_group.get()->shapes.size());
+        for (size_t g = 0; g < group.get()->shapes.size(); g++) {
+            auto mesh = dynamic_cast<Group*>(group.get()->shapes[g].get());
+            auto expected_mesh = dynamic_cast<Group*>(expected_group.get()->shapes[g].get());
+            REQUIRE(mesh->shapes.size() == expected_mesh->shapes.size());
+            for (size_t i = 0; i < mesh->shapes.size(); i++) {
+                auto t = dynamic_cast<Triangle*>(mesh->shapes[i].get());
+                auto expected_t = dynamic_cast<Triangle*>(expected_mesh->shapes[i].get());
+                REQUIRE(t->p1 == expected_t->p1);
+                REQUIRE(t->p2 == expected_t->p2);
+                REQUIRE(t->p3 == expected_t->p3);
+                REQUIRE((dynamic_cast<SmoothTriangle*>(t) != nullptr) ==
+                    (dynamic_cast<SmoothTriangle*>(expected_t) != nullptr));
+            }
+        }
+    }
+}
+
+TEST_CASE("The mapped OBJ parser matches the line-based one", "[triangles][obj_files]") {
+    for (const char* file : { "../tests/test_files/giberrish.obj", "../tests/test_files/test9.obj",
+        "../tests/test_files/test10.obj", "../tests/test_files/test11.obj",
+        "../tests/test_files/test12.obj", "../tests/test_files/test19.obj",
+        "../tests/test_files/test20.obj", "../tests/test_files/teapot.obj" }) {
+        require_same_parse(file);
+    }
+}
+
+TEST_CASE("Parsing OBJ text in place", "[triangles][obj_files]") {
+    ObjData data = ObjParser::parse_obj_data(
+        "# comment\r\n"
+        "v 0 1 0\r\n"
+        "v -1 0 0\n"
+        "v +1 0 0\n"
+        "v 1 1e0 0\n"
+        "vn 0 0 1\n"
+        "vt 0.5 0.5\n"
+        "g quad\n"
+        "f 1/1/1 2/1/1 3/1/1 4/1/1\n"
+        "g other\n"
+        "f -4 -3 -2\n"
+        "g quad\n"
+        "f 1/2 3/2 4/2");
+
+    REQUIRE(data.ignored_lines == 1);
+    REQUIRE(data.vertices.size() == 5);
+    REQUIRE(data.vertices[3] == Point(1, 0, 0));
+    REQUIRE(data.vertices[4] == Point(1, 1, 0));
+    REQUIRE(data.normals.size() == 2);
+    REQUIRE(data.group_names == std::vector<std::string>{ "DefaultGroup", "quad", "other" });
+
+    REQUIRE(data.faces.size() == 4);
+    // Quad fanned into two smooth triangles
+    REQUIRE(data.faces[0].v[0] == 1);
+    REQUIRE(data.faces[0].v[2] == 3);
+    REQUIRE(data.faces[1].v[0] == 1);
+    REQUIRE(data.faces[1].v[1] == 3);
+    REQUIRE(data.faces[1].v[2] == 4);
+    REQUIRE(data.faces[1].vn[2] == 1);
+    REQUIRE(data.faces[1].group == 1);
+    // Relative indices
+    REQUIRE(data.faces[2].v[0] == 1);
+    REQUIRE(data.faces[2].v[2] == 3);
+    REQUIRE(data.faces[2].vn[0] == 0);
+    REQUIRE(data.faces[2].group == 2);
+    // Repeated group names continue the group
+    REQUIRE(data.faces[3].group == 1);
+
+    REQUIRE_THROWS_AS(ObjParser::parse_obj_data("v 0 0 0\nf 1 2 3\n"), std::runtime_error);
+}
+
+TEST_CASE("Fast OBJ number parsing is exact", "[triangles][obj_files]") {
+    const char* numbers[] = { "0.1", "-2.345678", "123456.789012", "0.000001", "-0",
+        "1.5e3", "0.12345678901234567", "7", ".5", "-5." };
+    std::string text;
+    for (const char* n : numbers) {
+        text += std::string("v ") + n + " 0 0\n";
+    }
+    ObjData data = ObjParser::parse_obj_data(text);
+    for (size_t i = 0; i < std::size(numbers); i++) {
+        double expected;
+        std::from_chars(numbers[i], numbers[i] + std::strlen(numbers[i]), expected);
+        REQUIRE(data.vertices[i + 1].x == expected);
+    }
+    // A decimal point needs a digit on at least one side
+    for (const char* n : { ".", "-.", "+." }) {
+        REQUIRE_THROWS_AS(ObjParser::parse_obj_data(std::string("v ") + n + " 0 0\n"), std::runtime_error);
+    }
+}
+
+TEST_CASE("Parsing OBJ text in chunks matches the serial parse", "[triangles][obj_files]") {
+    // Big enough to be split into several chunks. Groups change every 1000
+    // rows and names repeat, so groups span chunk boundaries; faces use
+    // both absolute and relative indices
+    std::string text = "v 0 0 0\nvn 0 0 1\n";
+    for (int i = 0; i < 30000; i++) {
+        if (i % 1000 == 0) {
+            text += "g part" + std::to_string(i / 1000 % 7) + "\n";
+        }
+        text += "v " + std::to_string(i) + ".25 1.5 -" + std::to_string(i) + "\n";
+        text += "v " + std::to_string(i) + ".75 -2.125 0.5\n";
+        text += "vn 0 1 0\n";
+        text += "f " + std::to_string(2 * i + 1) + "//1 -1//-1 " + std::to_string(2 * i + 3) + "//" +
+            std::to_string(i + 2) + "\n";
+        text += "f -3 -2 -1 1\n";
+        text += "# comment\n";
+    }
+    REQUIRE(text.size() > (3 << 20));
+
+    ObjData expected = ObjParser::parse_obj_data(text, 1);
+    ObjData data = ObjParser::parse_obj_data(text, 4);
+    REQUIRE(data.ignored_lines == expected.ignored_lines);
+    REQUIRE(data.vertices.size() == expected.vertices.size());
+    for (size_t i = 1; i < data.vertices.size(); i++) {
+        REQUIRE(data.vertices[i] == expected.vertices[i]);
+    }
+    REQUIRE(data.normals.size() == expected.normals.size());
+    for (size_t i = 1; i < data.normals.size(); i++) {
+        REQUIRE(data.normals[i] == expected.normals[i]);
+    }
+    REQUIRE(data.group_names == expected.group_names);
+    REQUIRE(data.faces.size() == expected.faces.size());
+    for (size_t i = 0; i < data.faces.size(); i++) {
+        REQUIRE(std::memcmp(&data.faces[i], &expected.faces[i], sizeof(ObjData::Face)) == 0);
+    }
+
+    // Errors in any chunk still surface
+    REQUIRE_THROWS_AS(ObjParser::parse_obj_data(text + "f 1 2 999999\n", 4), std::runtime_error);
+}
@@ -2,12 +2,14 @@
 
 #include <catch2/catch_approx.hpp>
 #include <catch2/catch_test_macros.hpp>
+#include <random>
+#include <typeinfo>
 
 #include "../src/geometry/ray.hpp"
 
 TEST_CASE("Creating a world", "[world][scene]") {
     World w;
-    REQUIRE(w.objects.empty());
+    REQUIRE(w.all_objects().empty());
     REQUIRE(w.light == nullptr);
     // REQUIRE(w.lights.empty());
 }
@@ -29,8 +31,8 @@ TEST_CASE("Creating a world", "[world][scene]") {
 //     s2.get()->transform = Transform::scaling(0.5, 0.5, 0.5);
 
 //     REQUIRE(w.lights.contains(light));
-//     REQUIRE(w.objects.contains(s1));
-//     REQUIRE(w.objects.contains(s2));
+//     REQUIRE(w.all_objects().contains(s1));
+//     REQUIRE(w.all_objects().contains(s2));
 // }
 
 TEST_CASE("Intersect a world with a ray", "[world][scene]") {
@@ -86,7 +88,7 @@ TEST_CASE("The hit, when an intersection occurs on the inside",
 TEST_CASE("Shading an intersection", "[scene][world]") {
     const auto [w, s1, s2] = World::default_world();
     Ray r(Point(0, 0, -5), Vector(0, 0, 1));
-    // auto shape = w.objects.begin()->get();
+    // auto shape = w.all_objects().begin()->get();
     Intersection i = Intersection(4, s1);
     auto comps = PrecomputedIntersection::prepare_computations(i, r);
     Color c = w.shade_hit(comps);
@@ -131,3 +133,231 @@ TEST_CASE("The color with an intersection behind the ray", "[world][scene]") {
     Color c = w.color_at(r);
     REQUIRE(c == inner->material.color);
 }
+
+TEST_CASE("The closest hit in a world matches the hit of the full list", "[world][scene][closest_hit]") {
+    auto const [w, s1, s2] = World::default_world();
+    Ray r(Point(0, 0, -5), Vector(0, 0, 1));
+    auto hit = w.intersect_closest(r);
+    REQUIRE(hit.has_value());
+    REQUIRE(hit.value() == w.intersect_world(r).hit().value());
+    REQUIRE(hit.value().object == s1);
+
+    // From inside the outer sphere the inner one is closest
+    Ray inside(Point(0, 0, -.75), Vector(0, 0, 1));
+    REQUIRE(w.intersect_closest(inside).value().object == s2);
+    REQUIRE(double_equal(w.intersect_closest(inside).value().t, .25));
+
+    REQUIRE_FALSE(w.intersect_closest(r, 4).has_value());
+    REQUIRE_FALSE(w.intersect_closest(Ray(Point(0, 5, -5), Vector(0, 0, 1))).has_value());
+}
+
+namespace {
+    // One of every primitive, some nested in transformed groups, plus a mesh
+    World compiled_test_world() {
+        World w;
+        auto add = [&](std::unique_ptr<Shape> shape) {
+            w.add_object(std::move(shape));
+            };
+
+        auto floor = std::make_unique<Plane>();
+        floor->transform = Transform::translation(0, -3, 0);
+        add(std::move(floor));
+        add(std::make_unique<Sphere>());
+
+        auto outer = std::make_unique<Group>();
+        outer->transform = Transform::translation(3, 0, 1) * Transform::rotation_y(.5);
+        auto inner = std::make_unique<Group>();
+        inner->transform = Transform::scaling(.5, 2, .5);
+        auto cube = std::make_unique<Cube>();
+        cube->transform = Transform::rotation_x(.3);
+        auto cylinder = std::make_unique<Cylinder>();
+        cylinder->minimum = -1;
+        cylinder->maximum = 1;
+        cylinder->closed = true;
+        cylinder->transform = Transform::translation(0, 0, 3);
+        inner->add_children(std::move(cube), std::move(cylinder));
+        auto cone = std::make_unique<Cone>();
+        cone->minimum = -1;
+        cone->maximum = 0;
+        cone->closed = true;
+        cone->transform = Transform::translation(-2, 1, 0);
+        outer->add_children(std::move(inner), std::move(cone),
+            std::make_unique<Triangle>(Point(-1, 3, 0), Point(1, 3, 0), Point(0, 4, 1)));
+        add(std::move(outer));
+
+        auto buffers = std::make_shared<MeshBuffers>();
+        buffers->vertices = { Point(-1, 0, 0), Point(1, 0, 0), Point(0, 1, 0), Point(0, 0, 1) };
+        auto mesh = std::make_unique<TriangleMesh>(buffers,
+            std::vector<uint32_t>{ 0, 1, 2, 0, 1, 3, 0, 2, 3, 1, 2, 3 });
+        mesh->transform = Transform::translation(-3, 0, 0) * Transform::scaling(2, 2, 2);
+        add(std::move(mesh));
+
+        // Unbounded, so never in the BVH
+        auto pillar = std::make_unique<Cylinder>();
+        pillar->transform = Transform::translation(5, 0, -5);
+        add(std::move(pillar));
+        return w;
+    }
+}
+
+TEST_CASE("Compiling a world sorts its primitives by type", "[world][scene][compiled]") {
+    World w = compiled_test_world();
+    std::vector<const Shape*> objects;
+    for (auto& object : w.all_objects()) {
+        objects.push_back(object.get());
+    }
+    auto scene = CompiledScene::build(objects);
+    REQUIRE(scene.spheres.size() == 1);
+    REQUIRE(scene.planes.size() == 1);
+    REQUIRE(scene.cubes.size() == 1);
+    REQUIRE(scene.cylinders.size() == 2);
+    REQUIRE(scene.cones.size() == 1);
+    REQUIRE(scene.triangles.size() == 1);
+    REQUIRE(scene.others.size() == 1); // the mesh
+    REQUIRE(scene.primitive_count() == 8);
+    REQUIRE(!scene.wide_bvh().empty());
+
+    // The identity sphere keeps slot 0 rather than getting a matrix of its own
+    REQUIRE(scene.spheres[0].transform == 0);
+    REQUIRE(scene.cubes[0].transform != 0);
+}
+
+TEST_CASE("A compiled world answers queries like the shapes it came from", "[world][scene][compiled]") {
+    World reference = compiled_test_world();
+    World w = compiled_test_world();
+    w.prepare();
+    REQUIRE(w.is_compiled());
+
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<double> coord(-6, 6);
+    int hits = 0;
+    for (int i = 0; i < 2000; i++) {
+        Point from(coord(rng), coord(rng), coord(rng));
+        Point to(coord(rng) * .5, coord(rng) * .5, coord(rng) * .5);
+        Vector dir = Vector(to - from).normalized();
+        Ray r(from, dir);
+
+        auto expected = reference.intersect_world(r);
+        auto actual = w.intersect_world(r);
+        REQUIRE(actual.count == expected.count);
+        for (size_t j = 0; j < expected.count; j++) {
+            REQUIRE(double_equal(actual.intersections[j].t, expected.intersections[j].t));
+        }
+
+        auto expected_hit = reference.intersect_closest(r);
+        auto actual_hit = w.intersect_closest(r);
+        REQUIRE(actual_hit.has_value() == expected_hit.has_value());
+        if (expected_hit) {
+            hits++;
+            REQUIRE(double_equal(actual_hit->t, expected_hit->t));
+            // Objects are owned per world, so compare by type (and u/v, which
+            // only triangles set)
+            REQUIRE(typeid(*actual_hit->object) == typeid(*expected_hit->object));
+            if (dynamic_cast<const Triangle*>(expected_hit->object)) {
+                REQUIRE(double_equal(actual_hit->u, expected_hit->u));
+                REQUIRE(double_equal(actual_hit->v, expected_hit->v));
+            }
+            REQUIRE(w.occluded(r, expected_hit->t + EPSILON));
+            REQUIRE(!w.occluded(r, expected_hit->t - EPSILON));
+        }
+        REQUIRE(w.occluded(r, 20) == reference.occluded(r, 20));
+    }
+    REQUIRE(hits > 200);
+}
+
+TEST_CASE("A slot map handle goes stale once its entry is erased", "[world][scene][slot_map]") {
+    SlotMap<int> map;
+    auto a = map.insert(1);
+    auto b = map.insert(2);
+    auto c = map.insert(3);
+    REQUIRE(map.size() == 3);
+    REQUIRE(*map.get(b) == 2);
+
+    REQUIRE(map.erase(a).value() == 1);
+    REQUIRE(!map.contains(a));
+    REQUIRE(!map.erase(a).has_value());
+    // The last value fills the hole, and its handle still finds it
+    REQUIRE(std::vector<int>(map.begin(), map.end()) == std::vector<int>{ 3, 2 });
+    REQUIRE(*map.get(c) == 3);
+
+    // The freed slot is reused under a new generation
+    auto d = map.insert(4);
+    REQUIRE(d.index == a.index);
+    REQUIRE(d != a);
+    REQUIRE(map.get(a) == nullptr);
+    REQUIRE(*map.get(d) == 4);
+
+    map.clear();
+    REQUIRE(map.empty());
+    REQUIRE(!map.contains(b));
+}
+
+TEST_CASE("Adding and removing world objects by handle", "[world][scene]") {
+    auto [w, s1, s2] = World::default_world();
+    auto floor = std::make_unique<Plane>();
+    floor->transform = Transform::translation(0, -1, 0);
+    Plane* floor_ptr = floor.get();
+    auto handle = w.add_object(std::move(floor));
+    REQUIRE(w.all_objects().size() == 3);
+    REQUIRE(w.get_object(handle) == floor_ptr);
+
+    Ray down(Point(0, 5, 3), Vector(0, -1, 0));
+    REQUIRE(w.intersect_closest(down).value().object == floor_ptr);
+    w.prepare();
+    REQUIRE(w.is_compiled());
+
+    w.edit_object(handle)->transform = Transform::translation(0, -2, 0);
+    REQUIRE(!w.is_compiled());
+    REQUIRE(double_equal(w.intersect_closest(down).value().t, 7));
+    REQUIRE(w.compiled_scene().planes.size() == 1);
+    REQUIRE(w.is_compiled());
+    REQUIRE(double_equal(w.intersect_closest(down).value().t, 7));
+
+    auto removed = w.remove_object(handle);
+    REQUIRE(removed.get() == floor_ptr);
+    REQUIRE(!w.is_compiled());
+    REQUIRE(w.all_objects().size() == 2);
+    REQUIRE(w.get_object(handle) == nullptr);
+    REQUIRE(w.remove_object(handle) == nullptr);
+    REQUIRE(!w.intersect_closest(down).has_value());
+    REQUIRE(!w.occluded(down, 10));
+}
+
+TEST_CASE("World queries through the top-level BVH match a scan of every object", "[world][scene]") {
+    World w;
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<double> coord(-10, 10);
+    for (int i = 0; i < 200; i++) {
+        auto sphere = std::make_unique<Sphere>();
+        sphere->transform = Transform::translation(coord(rng), coord(rng), coord(rng))
+            * Transform::scaling(.5, .5, .5);
+        w.add_object(std::move(sphere));
+    }
+    auto floor = std::make_unique<Plane>();
+    floor->transform = Transform::translation(0, -11, 0);
+    w.add_object(std::move(floor));
+
+    for (int i = 0; i < 500; i++) {
+        Point from(coord(rng), 12, coord(rng));
+        Point to(coord(rng), -12, coord(rng));
+        Ray r(from, Vector(to - from).normalized());
+
+        std::optional<Intersection> expected;
+        IntersectionRecord all;
+        for (auto& object : w.all_objects()) {
+            all.append_record(object->intersect(r));
+            auto hit = object->intersect_closest(r);
+            if (hit && (!expected || hit->t < expected->t)) {
+                expected = hit;
+            }
+        }
+        REQUIRE(w.intersect_world(r).count == all.count);
+        auto actual = w.intersect_closest(r);
+        REQUIRE(actual.has_value() == expected.has_value());
+        if (expected) {
+            REQUIRE(actual->object == expected->object);
+            REQUIRE(w.occluded(r, expected->t + EPSILON));
+            REQUIRE(!w.occluded(r, expected->t - EPSILON));
+        }
+    }
+}